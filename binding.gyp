@@ -10,17 +10,25 @@
         'src/addon.cpp',
         'src/types.cpp',
         'src/common.cpp',
+        'src/bindingstats.cpp',
         'src/commandqueue.cpp',
         'src/context.cpp',
+        'src/convert.cpp',
         'src/device.cpp',
         'src/event.cpp',
+        'src/filemap.cpp',
+        'src/histogram.cpp',
+        'src/hostmem.cpp',
         'src/kernel.cpp',
         'src/memobj.cpp',
         'src/pipe.cpp',
         'src/platform.cpp',
         'src/program.cpp',
+        'src/recorder.cpp',
         'src/sampler.cpp',
-        'src/svm.cpp'
+        'src/staging.cpp',
+        'src/svm.cpp',
+        'src/tracing.cpp'
       ],
       'include_dirs' : [
         "<!(node -e \"require('nan')\")",
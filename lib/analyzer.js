@@ -0,0 +1,177 @@
+"use strict";
+
+// Critical path and idle time of a pipeline of commands, from the records of
+// cl.getRecords() of one or more queues.
+//
+// A command depends on the recorded commands in its wait list, matched by
+// record id, and on an in-order queue on the previous command of its queue. Walking back
+// from the command which ends last, each step goes to the dependency which
+// ended last: the one that held the command back. The time between that end
+// and the start of the command is launch latency, or a host round trip when
+// the command was only queued after its dependency had ended.
+//
+// Timestamps of queues on different devices only compare through a clock
+// correlator (cl.createClockCorrelator) given for each of them.
+
+module.exports = function (cl) {
+
+  function commandName(r) {
+    return r.name || cl.commandName(r.command);
+  }
+
+  // Total length of the union of [start, end] intervals sorted by start
+  function busyTime(nodes) {
+    var busy = 0, start = -Infinity, end = -Infinity;
+    nodes.forEach(function (n) {
+      if (n.start > end) {
+        busy += end - start > 0 ? end - start : 0;
+        start = n.start;
+        end = n.end;
+      } else if (n.end > end) {
+        end = n.end;
+      }
+    });
+    return busy + (end - start > 0 ? end - start : 0);
+  }
+
+  function describe(n) {
+    return { queue: n.queue, name: commandName(n.record), record: n.record };
+  }
+
+  // streams: [{ name, device, records, clock, outOfOrder }]; device groups the
+  // queues sharing a device (default: one per queue), clock converts their
+  // timestamps to host time.
+  // options: { minGap (ns, default 1000), top (default 10) }
+  cl.analyzePipeline = function (streams, options) {
+    options = options || {};
+    var minGap = options.minGap !== undefined ? options.minGap : 1000;
+    var top = options.top || 10;
+
+    // commands in enqueue order, with their dependencies
+    var nodes = [];
+    streams.forEach(function (s, i) {
+      var toTime = s.clock ? function (t) { return s.clock.toHost(t); } : function (t) { return t; };
+      s.records.forEach(function (r) {
+        nodes.push({
+          record: r,
+          queue: s.name || "queue " + i,
+          device: s.device !== undefined ? s.device : s.name || i,
+          inOrder: !s.outOfOrder,
+          queued: toTime(r.queued),
+          start: toTime(r.start),
+          end: toTime(r.end),
+          deps: []
+        });
+      });
+    });
+    nodes.sort(function (a, b) { return a.queued - b.queued; });
+
+    // ids are unique in the process, waitFor only holds those of commands
+    // recorded before
+    var byId = {};
+    nodes.forEach(function (n) {
+      if (n.record.id !== undefined) {
+        byId[n.record.id] = n;
+      }
+    });
+    var lastByQueue = {};
+    nodes.forEach(function (n) {
+      (n.record.waitFor || []).forEach(function (id) {
+        if (byId[id] && byId[id] !== n) {
+          n.deps.push(byId[id]);
+        }
+      });
+      var previous = lastByQueue[n.queue];
+      if (n.inOrder && previous && n.deps.indexOf(previous) < 0) {
+        n.deps.push(previous);
+      }
+      lastByQueue[n.queue] = n;
+    });
+
+    // host round trips: dependent commands queued after their dependency ended
+    var roundTrips = [];
+    var roundTripTime = 0;
+    nodes.forEach(function (n) {
+      n.deps.forEach(function (d) {
+        if (n.queued > d.end) {
+          roundTrips.push({ from: describe(d), to: describe(n), duration: n.queued - d.end });
+          roundTripTime += n.queued - d.end;
+        }
+      });
+    });
+    roundTrips.sort(function (a, b) { return b.duration - a.duration; });
+
+    // critical path, back from the last command to end
+    var path = [];
+    var last = nodes.reduce(function (l, n) { return !l || n.end > l.end ? n : l; }, null);
+    var first = last;
+    for (var n = last; n;) {
+      var gate = n.deps.reduce(function (g, d) { return !g || d.end > g.end ? d : g; }, null);
+      var ready = gate ? Math.max(gate.end, n.queued) : n.queued;
+      var step = describe(n);
+      step.execution = n.end - n.start;
+      step.launch = n.start - ready;
+      step.hostRoundTrip = gate && n.queued > gate.end ? n.queued - gate.end : 0;
+      path.unshift(step);
+      first = n;
+      n = gate;
+    }
+
+    // device idle gaps, between the busy intervals of each device
+    var devices = {};
+    nodes.forEach(function (n) {
+      (devices[n.device] = devices[n.device] || []).push(n);
+    });
+    var gaps = [];
+    var deviceStats = Object.keys(devices).map(function (key) {
+      var list = devices[key].slice().sort(function (a, b) { return a.start - b.start; });
+      var busyUntil = null;
+      list.forEach(function (n) {
+        if (busyUntil && n.start - busyUntil.end >= minGap) {
+          gaps.push({
+            device: key,
+            start: busyUntil.end,
+            end: n.start,
+            duration: n.start - busyUntil.end,
+            before: describe(busyUntil),
+            after: describe(n),
+            // nothing was submitted: the host was late
+            cause: n.queued > busyUntil.end ? "host" : "dependency"
+          });
+        }
+        if (!busyUntil || n.end > busyUntil.end) {
+          busyUntil = n;
+        }
+      });
+      var begin = Math.min.apply(null, list.map(function (n) { return n.queued; }));
+      var end = Math.max.apply(null, list.map(function (n) { return n.end; }));
+      var busy = busyTime(list);
+      return { device: key, commands: list.length, busy: busy, span: end - begin, utilization: end > begin ? busy / (end - begin) : 0 };
+    });
+    gaps.sort(function (a, b) { return b.duration - a.duration; });
+
+    var queueStats = streams.map(function (s, i) {
+      var name = s.name || "queue " + i;
+      var list = nodes.filter(function (n) { return n.queue === name; })
+        .sort(function (a, b) { return a.start - b.start; });
+      return { queue: name, commands: list.length, busy: busyTime(list) };
+    });
+
+    // busiest device against the average: 1 when balanced
+    var meanBusy = deviceStats.reduce(function (sum, d) { return sum + d.busy; }, 0) / (deviceStats.length || 1);
+    var maxBusy = deviceStats.reduce(function (max, d) { return Math.max(max, d.busy); }, 0);
+
+    return {
+      criticalPath: path,
+      criticalPathTime: last ? last.end - first.queued : 0,
+      idleGaps: gaps.slice(0, top),
+      idleTime: gaps.reduce(function (sum, g) { return sum + g.duration; }, 0),
+      hostRoundTrips: roundTrips.slice(0, top),
+      hostRoundTripTime: roundTripTime,
+      devices: deviceStats,
+      queues: queueStats,
+      imbalance: meanBusy > 0 ? maxBusy / meanBusy : 1
+    };
+  };
+
+};
@@ -0,0 +1,143 @@
+"use strict";
+
+// Conversion of device profiling timestamps to the host clock of
+// process.hrtime(), which is also the time base of Node's trace_events.
+//
+// A correlator samples both clocks, keeps the last samples and fits
+// host = offset + slope * device over them by least squares. The slope
+// absorbs the drift between the two oscillators, so sampling every few
+// seconds is enough. Samples come from clGetDeviceAndHostTimer (OpenCL 2.1),
+// the OpenCL host clock being mapped to hrtime with clGetHostTimer calls
+// bracketed by hrtime reads. Otherwise, given a profiling queue, the QUEUED
+// timestamp of a marker is bracketed by hrtime reads around its enqueue.
+
+module.exports = function (cl) {
+
+  function hrtimeNs() {
+    var t = process.hrtime();
+    return t[0] * 1e9 + t[1];
+  }
+
+  // options: { queue, interval (ms, default 1000), window (samples, default 16) }
+  function ClockCorrelator(device, options) {
+    options = options || {};
+    this.device = device;
+    this.queue = options.queue || null;
+    this.interval = options.interval || 1000;
+    this.window = options.window || 16;
+    this.samples = [];
+    this.offset = 0;
+    this.slope = 1;
+    this._timer = null;
+    this._useTimers = !!cl.getDeviceAndHostTimer;
+    if (!this._useTimers && !this.queue) {
+      throw new Error("A profiling queue is needed without clGetDeviceAndHostTimer");
+    }
+  }
+
+  ClockCorrelator.prototype._timerSample = function () {
+    var pair = cl.getDeviceAndHostTimer(this.device);
+    var t0 = hrtimeNs();
+    var host = cl.getHostTimer(this.device);
+    var t1 = hrtimeNs();
+    return { device: pair[0], host: pair[1] + (t0 + t1) / 2 - host, error: (t1 - t0) / 2 };
+  };
+
+  ClockCorrelator.prototype._markerSample = function () {
+    var t0 = hrtimeNs();
+    var event = cl.enqueueMarkerWithWaitList ?
+      cl.enqueueMarkerWithWaitList(this.queue, [], true) :
+      cl.enqueueMarker(this.queue, true);
+    var t1 = hrtimeNs();
+    cl.waitForEvents([event]);
+    var times = new Float64Array(4);
+    cl.getEventsProfiling([event], times);
+    cl.releaseEvent(event);
+    return { device: times[0], host: (t0 + t1) / 2, error: (t1 - t0) / 2 };
+  };
+
+  // Takes one sample of both clocks and refits. Returns the sample.
+  ClockCorrelator.prototype.sample = function () {
+    var s;
+    if (this._useTimers) {
+      try {
+        s = this._timerSample();
+      } catch (e) {
+        // the device has no timer (CL_INVALID_OPERATION)
+        if (!this.queue) {
+          throw e;
+        }
+        this._useTimers = false;
+      }
+    }
+    if (!s) {
+      s = this._markerSample();
+    }
+    this.samples.push(s);
+    if (this.samples.length > this.window) {
+      this.samples.shift();
+    }
+    this._fit();
+    return s;
+  };
+
+  ClockCorrelator.prototype._fit = function () {
+    // samples taken while the thread was preempted are off by the preemption
+    var minError = Infinity;
+    this.samples.forEach(function (s) { minError = Math.min(minError, s.error); });
+    var good = this.samples.filter(function (s) { return s.error <= 2 * minError + 1000; });
+
+    // relative to the first sample to keep the sums exact in doubles
+    var d0 = good[0].device, h0 = good[0].host;
+    var n = good.length, sd = 0, sh = 0, sdd = 0, sdh = 0;
+    good.forEach(function (s) {
+      var d = s.device - d0, h = s.host - h0;
+      sd += d; sh += h; sdd += d * d; sdh += d * h;
+    });
+    var den = n * sdd - sd * sd;
+    this.slope = n > 1 && den > 0 ? (n * sdh - sd * sh) / den : 1;
+    this.offset = h0 + (sh - this.slope * sd) / n - this.slope * d0;
+  };
+
+  // Host time (process.hrtime nanoseconds) of a device timestamp
+  ClockCorrelator.prototype.toHost = function (deviceNs) {
+    if (!this.samples.length) {
+      this.sample();
+    }
+    return this.offset + this.slope * Number(deviceNs);
+  };
+
+  // Relative drift of the device clock, e.g. 1e-5 for 10 ppm
+  Object.defineProperty(ClockCorrelator.prototype, "drift", {
+    get: function () { return this.slope - 1; }
+  });
+
+  // Samples every interval ms in the background. The timer does not keep the
+  // process alive.
+  ClockCorrelator.prototype.start = function () {
+    var self = this;
+    if (!this._timer) {
+      this.sample();
+      this._timer = setInterval(function () { self.sample(); }, this.interval);
+      if (this._timer.unref) {
+        this._timer.unref();
+      }
+    }
+    return this;
+  };
+
+  ClockCorrelator.prototype.stop = function () {
+    if (this._timer) {
+      clearInterval(this._timer);
+      this._timer = null;
+    }
+    return this;
+  };
+
+  cl.ClockCorrelator = ClockCorrelator;
+
+  cl.createClockCorrelator = function (device, options) {
+    return new ClockCorrelator(device, options);
+  };
+
+};
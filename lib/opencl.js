@@ -14,15 +14,71 @@ global.WebCLProgram=cl.WebCLProgram=function (_) { this._ = _; };
 global.WebCLKernel=cl.WebCLKernel=function (_) { this._ = _; };
 global.WebCLSampler=cl.WebCLSampler=function (_) { this._ = _; };
 
+// Non-blocking map that resolves with the mapped ArrayBuffer once the map
+// command has completed, i.e. once its content is valid. The ArrayBuffer is
+// detached by cl.enqueueUnmapMemObject.
+cl.mapAsync = function (cq, buffer, flags, offset, size, waitList) {
+  return new Promise(function (resolve, reject) {
+    var mapped = cl.enqueueMapBuffer(cq, buffer, false, flags, offset, size, waitList || [], true);
+    var event = mapped.event;
+    delete mapped.event;
+
+    cl.setEventCallback(event, cl.COMPLETE, function (_, status) {
+      cl.releaseEvent(event);
+      if (status < 0) {
+        cl.enqueueUnmapMemObject(cq, buffer, mapped);
+        reject(new Error("Map command failed with status " + status));
+        return;
+      }
+      resolve(mapped);
+    }, {});
+  });
+};
+
+// Index of the first of events which is complete (or failed), -1 if none
+// is, with a single native call for all of them.
+var statuses = new Int32Array(16);
+cl.firstCompleted = function (events) {
+  if (statuses.length < events.length) {
+    statuses = new Int32Array(Math.max(events.length, 2 * statuses.length));
+  }
+  if (!cl.getEventStatuses(events, statuses)) {
+    return -1;
+  }
+  for (var i = 0; i < events.length; i++) {
+    if (statuses[i] <= cl.COMPLETE) {
+      return i;
+    }
+  }
+  return -1;
+};
+
+require('./persistent')(cl);
+require('./staging')(cl);
+require('./streams')(cl);
+require('./tiled')(cl);
+require('./tensor')(cl);
+require('./recorder')(cl);
+require('./clock')(cl);
+require('./analyzer')(cl);
+require('./roofline')(cl);
+
 process.on('SIGINT', function() {
   console.log( "\nGracefully shutting down from SIGINT (Ctrl-C)" );
   // some other closing procedures go here
   process.exit();
 });
 
+var isMainThread = true;
+try { isMainThread = require('worker_threads').isMainThread; } catch (e) { /* node < 10.5 */ }
+
 process.on('exit', function() {
   // this releases all allocated OpenCL objects
   // global.gc();
+  // staging pools are shared by all threads, workers leave them alone
+  if (isMainThread) {
+    cl.releaseStagingPools();
+  }
   cl.releaseAll();
 });
 
@@ -52,6 +108,14 @@ process.on('exit', function() {
 //   cl.ReleaseDevice(device);
 // }
 
+// if(cl.CL_VERSION_2_1) {
+//   cl.GetDeviceAndHostTimer(device,
+//                           as_bigint);
+
+//   cl.GetHostTimer(device,
+//                  as_bigint);
+// }
+
 // /* Context APIs  */
 // cl.CreateContext(properties,
 //                 devices,
@@ -82,12 +146,24 @@ process.on('exit', function() {
 // cl.GetCommandQueueInfo(command_queue,
 //                       param_name);
 
+// /* Host memory */
+// // ArrayBuffer over aligned host memory, used in place (USE_HOST_PTR) by
+// // CreateBuffer. options: { align, hugePages, numaNode }
+// cl.allocHostBuffer(size,
+//                   options);
+
 // /* Memory Object APIs */
 // cl.CreateBuffer(context,
 //                flags,
 //                size,
 //                host_ptr);
 
+// // Buffer initialized from the content of a file, used in place
+// // (USE_HOST_PTR on a private mapping) by CPU-only contexts
+// cl.createBufferFromFile(context,
+//                        path,
+//                        flags);
+
 // cl.CreateSubBuffer(buffer,
 //                   flags,
 //                   buffer_create_type,
@@ -218,6 +294,13 @@ process.on('exit', function() {
 // cl.GetEventInfo(event,
 //                param_name);
 
+// // Int32Array of the execution statuses, one native call for all events
+// cl.GetEventStatuses(events,
+//                    out_int32Array);
+
+// // index of the first complete (or failed) event, -1 if none
+// cl.firstCompleted(events);
+
 // cl.CreateUserEvent(context);
 
 // cl.RetainEvent(event);
@@ -232,9 +315,19 @@ process.on('exit', function() {
 //                     callback,
 //                     user_data);
 
+// // "callback" (driver callbacks, the default) or "poll": the loop polls the
+// // status of the events for twice their usual completion time, up to
+// // spin_us, then falls back to callbacks
+// cl.setCompletionMode(mode,
+//                     spin_us);
+
 // /* Profiling APIs */
 // cl.GetEventProfilingInfo(event,
-//                         param_name);
+//                         param_name,
+//                         as_bigint);
+
+// cl.GetEventsProfiling(events,
+//                      out_bigUint64Array_or_float64Array);
 
 // /* Flush and Finish APIs */
 // cl.Flush(command_queue);
@@ -249,7 +342,94 @@ process.on('exit', function() {
 //                     size,
 //                     ptr,
 //                     event_wait_list,
-//                     event);
+//                     event,
+//                     element_type); // when ptr is a JS Array, e.g. "float4",
+//                                    // always blocking then
+
+// // Strided N-D views of buffer and host memory, see lib/tensor.js.
+// // options: { elementSize, bufferOffset, bufferStrides, hostOffset,
+// //            hostStrides, blocking, waitList, event, maxTransfers }
+// cl.readTensor(command_queue,
+//              buffer,
+//              ptr,
+//              shape,
+//              options);
+
+// cl.writeTensor(command_queue,
+//               buffer,
+//               ptr,
+//               shape,
+//               options);
+
+// // options: { elementSize, srcOffset, srcStrides, dstOffset, dstStrides,
+// //            waitList, event }
+// cl.copyTensor(command_queue,
+//              src_buffer,
+//              dst_buffer,
+//              shape,
+//              options);
+
+// // Convert elements between the host type (deduced from a typed array when
+// // null) and the device type, e.g. "double" -> "float", "float" -> "half",
+// // packed "float3" -> 16-byte device "float3"
+// cl.enqueueWriteBufferConverted(command_queue,
+//                               buffer,
+//                               blocking_write,
+//                               offset,
+//                               ptr,
+//                               host_type,
+//                               device_type,
+//                               event_wait_list,
+//                               event);
+
+// cl.enqueueReadBufferConverted(command_queue,
+//                              buffer,
+//                              blocking_read,
+//                              offset,
+//                              ptr,
+//                              host_type,
+//                              device_type,
+//                              event_wait_list,
+//                              event);
+
+// // Scatter/gather: regions holds (device offset, host offset, length)
+// // triples (typed array or Array). Adjacent regions are merged and strided
+// // runs go through a single rect transfer. Returns one event for all.
+// cl.enqueueReadBufferRegions(command_queue,
+//                            buffer,
+//                            blocking_read,
+//                            regions,
+//                            ptr,
+//                            event_wait_list,
+//                            event);
+
+// cl.enqueueWriteBufferRegions(command_queue,
+//                             buffer,
+//                             blocking_write,
+//                             regions,
+//                             ptr,
+//                             event_wait_list,
+//                             event);
+
+// // Non-blocking transfers straight from/to a mapping of the file. size
+// // defaults to the rest of the file (write) or of the buffer (read).
+// cl.enqueueWriteBufferFromFile(command_queue,
+//                              buffer,
+//                              path,
+//                              file_offset,
+//                              size,
+//                              buffer_offset,
+//                              event_wait_list,
+//                              event);
+
+// cl.enqueueReadBufferToFile(command_queue,
+//                           buffer,
+//                           path,
+//                           file_offset,
+//                           size,
+//                           buffer_offset,
+//                           event_wait_list,
+//                           event);
 
 // cl.EnqueueReadBufferRect(command_queue,
 //                         buffer,
@@ -272,7 +452,70 @@ process.on('exit', function() {
 //                      size,
 //                      ptr,
 //                      event_wait_list,
-//                      event);
+//                      event,
+//                      element_type); // when ptr is a JS Array, e.g. "float4"
+
+// // Blocking and non-blocking EnqueueReadBuffer/EnqueueWriteBuffer of at least
+// // size bytes go through a pool of pinned staging buffers (0 disables it).
+// // The event of a staged transfer is a marker, its profiling info spanning
+// // the transfer from QUEUED to END.
+// cl.setStagingThreshold(size);
+// cl.getStagingThreshold();
+// cl.releaseStagingPools();
+
+// // Records the timestamps of every Nth command enqueued on a profiling
+// // queue (CL_QUEUE_PROFILING_ENABLE), collected as they complete.
+// cl.createProfilingQueue(context, device);
+// cl.startRecording(command_queue, every, capacity);
+// cl.stopRecording(command_queue);
+// // { records: [{ id, waitFor, command, name, bytes, queued, submit, start, end }], dropped, pending }
+// cl.getRecords(command_queue);
+// // Chrome Trace Event / Perfetto JSON, see lib/recorder.js
+// cl.toChromeTrace(records, { pid, tid, queueName, origin, clock });
+// // Critical path, device idle gaps, host round trips and imbalance of the
+// // records of several queues, see lib/analyzer.js
+// cl.analyzePipeline([{ name, device, records, clock, outOfOrder }], { minGap, top });
+
+// // Calls of every binding function, counted always. Once timing is on,
+// // their time in ns split between the driver and marshaling.
+// cl.setBindingTiming(enabled);
+// // { name: { calls, time, driverTime, marshalingTime } }
+// cl.getBindingStats(reset);
+
+// // Roofline report per kernel, see lib/roofline.js
+// cl.setKernelCost(kernel_or_name, { bytes, flops });   // estimated from its buffers when omitted
+// cl.getDevicePeaks(context, device, { lanesPerComputeUnit, gflops, bandwidth });
+// cl.measureBandwidth(context, device, { size, iterations });
+// cl.kernelReport(cl.getStats(command_queue), peaks);
+
+// // Latency histograms of the commands of a profiling queue, per kernel name
+// // or command type: queueToStart, execution and endToCallback, in ns.
+// cl.enableStats(command_queue, enabled);
+// // [{ command, name, queueToStart: { count, min, max, mean, p50, ... }, ... }]
+// cl.getStats(command_queue_or_null, percentiles, reset);
+// cl.toTraceEvents(records, options);
+
+// // Worker threads: the handle of a context, program, buffer... is a string
+// // which can be posted to another thread, where importHandle() wraps the
+// // same OpenCL object. Each export retains it once, for one import.
+// cl.exportHandle(object);
+// cl.importHandle(handle);
+
+// // ArrayBuffer over pinned host memory
+// cl.allocPinnedBuffer(context,
+//                     command_queue,
+//                     size);
+// cl.releasePinnedBuffer(buffer);
+
+// // Writable stream filling buffer, see lib/streams.js
+// cl.createWriteStream(command_queue,
+//                     buffer,
+//                     { offset, chunkSize, depth });
+
+// // Readable stream over buffer, see lib/streams.js
+// cl.createReadStream(command_queue,
+//                    buffer,
+//                    { offset, length, chunkSize, depth });
 
 // cl.EnqueueWriteBufferRect(command_queue,
 //                          buffer,
@@ -404,6 +647,23 @@ process.on('exit', function() {
 //                         event_wait_list,
 //                         event);
 
+// // Promise of the mapped ArrayBuffer, resolved when the map has completed
+// cl.mapAsync(command_queue,
+//            buffer,
+//            map_flags,
+//            offset,
+//            size,
+//            event_wait_list);
+
+// // Long-lived host view of a buffer, see lib/persistent.js
+// var mapping = cl.createPersistentMapping(command_queue,
+//                                         buffer,
+//                                         { offset, size, coherent });
+// mapping.buffer;
+// mapping.flushToDevice();
+// mapping.invalidateFromDevice(event_wait_list);
+// mapping.release();
+
 // if(cl.CL_VERSION_1_2) {
 //   cl.EnqueueMigrateMemObjects(command_queue,
 //                            mem_objects,
@@ -421,6 +681,15 @@ process.on('exit', function() {
 //                        event_wait_list,
 //                        event);
 
+// // Promise of { tiles, tileSize }, runs kernel tile by tile over data larger
+// // than device memory, see lib/tiled.js.
+// // options: { source, sink, elementSize, outputElementSize, tileSize, halo,
+// //            memoryBudget, localSize, setArgs }
+// cl.runTiled(context,
+//            device,
+//            kernel,
+//            options);
+
 // cl.EnqueueTask(command_queue,
 //               kernel,
 //               event_wait_list,
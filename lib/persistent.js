@@ -0,0 +1,82 @@
+"use strict";
+
+// Persistent mappings keep a host view of a buffer alive across frames.
+//
+// On devices sharing memory with the host (CPU and integrated devices, for
+// buffers allocated with MEM_ALLOC_HOST_PTR or MEM_USE_HOST_PTR) the buffer
+// is mapped once, host updates are plain memory writes and the fences only
+// order the host against the queue. Elsewhere the fences fall back to
+// map/unmap, so the same code runs unchanged on discrete devices.
+
+module.exports = function (cl) {
+
+  var isCoherent = function (cq, buffer) {
+    var flags = cl.getMemObjectInfo(buffer, cl.MEM_FLAGS);
+    if (!(flags & (cl.MEM_ALLOC_HOST_PTR | cl.MEM_USE_HOST_PTR))) {
+      return false;
+    }
+    var device = cl.getCommandQueueInfo(cq, cl.QUEUE_DEVICE);
+    var type = cl.getDeviceInfo(device, cl.DEVICE_TYPE);
+    return !!(type & cl.DEVICE_TYPE_CPU) ||
+      !!cl.getDeviceInfo(device, cl.DEVICE_HOST_UNIFIED_MEMORY);
+  };
+
+  function PersistentMapping(cq, buffer, options) {
+    options = options || {};
+    this.cq = cq;
+    this.mem = buffer;
+    this.offset = options.offset || 0;
+    this.size = options.size || (cl.getMemObjectInfo(buffer, cl.MEM_SIZE) - this.offset);
+    this.coherent = ("coherent" in options) ? !!options.coherent : isCoherent(cq, buffer);
+    this.buffer = null;
+    this._map([]);
+  }
+
+  PersistentMapping.prototype._map = function (waitList) {
+    this.buffer = cl.enqueueMapBuffer(this.cq, this.mem, true,
+      cl.MAP_READ | cl.MAP_WRITE, this.offset, this.size, waitList, false);
+  };
+
+  PersistentMapping.prototype._unmap = function () {
+    var event = cl.enqueueUnmapMemObject(this.cq, this.mem, this.buffer, [], true);
+    this.buffer = null;
+    return event;
+  };
+
+  // Makes host writes visible to commands enqueued afterwards on the queue.
+  // Returns the unmap event when the device needed one, null otherwise.
+  PersistentMapping.prototype.flushToDevice = function () {
+    if (this.coherent || !this.buffer) {
+      return null;
+    }
+    return this._unmap();
+  };
+
+  // Waits for the events in waitList (or for the whole queue) and makes the
+  // device results visible through this.buffer.
+  PersistentMapping.prototype.invalidateFromDevice = function (waitList) {
+    waitList = waitList || [];
+    if (!this.coherent) {
+      if (this.buffer) {
+        cl.releaseEvent(this._unmap());
+      }
+      this._map(waitList);
+    } else if (waitList.length) {
+      cl.waitForEvents(waitList);
+    } else {
+      cl.finish(this.cq);
+    }
+    return this.buffer;
+  };
+
+  PersistentMapping.prototype.release = function () {
+    if (this.buffer) {
+      cl.releaseEvent(this._unmap());
+      cl.finish(this.cq);
+    }
+  };
+
+  cl.createPersistentMapping = function (cq, buffer, options) {
+    return new PersistentMapping(cq, buffer, options);
+  };
+};
@@ -0,0 +1,94 @@
+"use strict";
+
+// Timelines of the commands sampled by cl.startRecording, as Chrome Trace
+// Event JSON (chrome://tracing, Perfetto, speedscope...).
+//
+// Each command becomes a complete ("X") event spanning START to END on the
+// track of its queue, named after its kernel or its command type. The time
+// spent waiting in the queue (QUEUED to START) goes into its arguments.
+
+module.exports = function (cl) {
+
+  // cl.COMMAND_* values to names, e.g. cl.COMMAND_READ_BUFFER -> "READ_BUFFER"
+  var commandNames = {};
+  Object.keys(cl).forEach(function (key) {
+    if (key.indexOf("COMMAND_") === 0 && key.indexOf("COMMAND_QUEUE") !== 0 &&
+        typeof cl[key] === "number") {
+      commandNames[cl[key]] = key.substr(8);
+    }
+  });
+
+  // In-order queue with CL_QUEUE_PROFILING_ENABLE, as recording, stats and
+  // clock correlation need
+  cl.createProfilingQueue = function (ctx, device) {
+    return cl.createCommandQueueWithProperties ?
+      cl.createCommandQueueWithProperties(ctx, device, [cl.QUEUE_PROPERTIES, cl.QUEUE_PROFILING_ENABLE]) :
+      cl.createCommandQueue(ctx, device, cl.QUEUE_PROFILING_ENABLE);
+  };
+
+  cl.commandName = function (command) {
+    return commandNames[command] || ("COMMAND_" + command);
+  };
+
+  // options: { pid (default: this process), tid, queueName, origin, clock }.
+  // Timestamps are device nanoseconds, made relative to origin (default: the
+  // earliest QUEUED).
+  // With a clock correlator (cl.createClockCorrelator), they are converted to
+  // host time instead, the time base of Node's own trace_events.
+  // Returns an array of trace events, to concatenate across queues.
+  cl.toTraceEvents = function (records, options) {
+    options = options || {};
+    var pid = options.pid || process.pid;
+    var tid = options.tid || 1;
+    var clock = options.clock;
+    var origin = options.origin;
+    if (clock) {
+      origin = 0;
+    } else if (origin === undefined) {
+      origin = records.reduce(function (min, r) { return Math.min(min, r.queued); }, Infinity);
+      if (!isFinite(origin)) {
+        origin = 0;
+      }
+    }
+
+    var events = [];
+    if (options.queueName) {
+      events.push({ name: "thread_name", ph: "M", pid: pid, tid: tid, args: { name: options.queueName } });
+    }
+    records.forEach(function (r) {
+      var start = clock ? clock.toHost(r.start) : r.start;
+      var end = clock ? clock.toHost(r.end) : r.end;
+      var args = {
+        command: cl.commandName(r.command),
+        queuedUs: (r.start - r.queued) / 1000,
+        submitUs: (r.start - r.submit) / 1000
+      };
+      if (r.bytes) {
+        args.bytes = r.bytes;
+        if (r.end > r.start) {
+          args.gbPerS = r.bytes / (r.end - r.start);
+        }
+      }
+      events.push({
+        name: r.name || args.command,
+        cat: r.name ? "kernel" : r.bytes ? "transfer" : "command",
+        ph: "X",
+        pid: pid,
+        tid: tid,
+        ts: (start - origin) / 1000,
+        dur: (end - start) / 1000,
+        args: args
+      });
+    });
+    return events;
+  };
+
+  // Trace Event JSON object of the records of one queue
+  cl.toChromeTrace = function (records, options) {
+    return {
+      traceEvents: cl.toTraceEvents(records, options),
+      displayTimeUnit: "ns"
+    };
+  };
+
+};
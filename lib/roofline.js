@@ -0,0 +1,162 @@
+"use strict";
+
+// Roofline report of kernels: achieved bandwidth and compute throughput,
+// against the peaks of the device.
+//
+// The cost of a launch (bytes moved, floating point operations) comes from
+// cl.setKernelCost, either given or estimated from the sizes of the buffers
+// bound to the kernel, each counted as moved once. Execution times come from
+// the latency statistics of cl.getStats. Peak compute is derived from the
+// device info, peak bandwidth is measured with buffer copies.
+
+module.exports = function (cl) {
+
+  // kernel -> values of its arguments, for estimates
+  var kernelArgs = new WeakMap();
+  // kernel name -> { bytes, flops, estimated }
+  var kernelCosts = {};
+
+  var setKernelArg = cl.setKernelArg;
+  cl.setKernelArg = function (kernel, index, type, value) {
+    var ret = setKernelArg.apply(this, arguments);
+    // memory objects only, the values of the other types have no size to track
+    if (value !== null && typeof value === "object" && !ArrayBuffer.isView(value) && !(value instanceof ArrayBuffer)) {
+      var args = kernelArgs.get(kernel);
+      if (!args) {
+        kernelArgs.set(kernel, args = []);
+      }
+      args[index] = value;
+    }
+    return ret;
+  };
+
+  function toNumber(value) {
+    // cl_ulong infos come as [hi, lo]
+    return Array.isArray(value) ? value[0] * 4294967296 + value[1] : value;
+  }
+
+  function kernelName(kernel) {
+    return typeof kernel === "string" ? kernel : cl.getKernelInfo(kernel, cl.KERNEL_FUNCTION_NAME);
+  }
+
+  // Bytes moved by a launch: the sizes of the buffers bound to the kernel
+  cl.estimateKernelCost = function (kernel) {
+    var bytes = 0;
+    (kernelArgs.get(kernel) || []).forEach(function (v) {
+      try {
+        bytes += cl.getMemObjectInfo(v, cl.MEM_SIZE);
+      } catch (e) {
+        // not a memory object (sampler...), or released
+      }
+    });
+    return { bytes: bytes, flops: 0, estimated: true };
+  };
+
+  // cost: { bytes, flops } per launch, estimated from the bound buffers when
+  // omitted. kernel is a kernel, or a kernel name when cost is given.
+  cl.setKernelCost = function (kernel, cost) {
+    kernelCosts[kernelName(kernel)] = cost ?
+      { bytes: cost.bytes || 0, flops: cost.flops || 0, estimated: false } :
+      cl.estimateKernelCost(kernel);
+  };
+
+  cl.getKernelCost = function (kernel) {
+    return kernelCosts[kernelName(kernel)];
+  };
+
+  // Device memory bandwidth in GB/s, from the fastest of a few copies between
+  // two buffers (each byte read and written). options: { size, iterations }
+  cl.measureBandwidth = function (ctx, device, options) {
+    options = options || {};
+    var size = options.size ||
+      Math.min(64 << 20, Math.floor(toNumber(cl.getDeviceInfo(device, cl.DEVICE_MAX_MEM_ALLOC_SIZE)) / 4));
+    var iterations = options.iterations || 5;
+
+    var cq = cl.createProfilingQueue(ctx, device);
+    var src = cl.createBuffer(ctx, cl.MEM_READ_WRITE, size, null);
+    var dst = cl.createBuffer(ctx, cl.MEM_READ_WRITE, size, null);
+    var times = new Float64Array(4);
+    var best = Infinity;
+    try {
+      // first touch, not timed
+      cl.enqueueCopyBuffer(cq, src, dst, 0, 0, size);
+      for (var i = 0; i < iterations; i++) {
+        var event = cl.enqueueCopyBuffer(cq, src, dst, 0, 0, size, [], true);
+        cl.waitForEvents([event]);
+        cl.getEventsProfiling([event], times);
+        cl.releaseEvent(event);
+        best = Math.min(best, times[3] - times[2]);
+      }
+    } finally {
+      cl.releaseMemObject(src);
+      cl.releaseMemObject(dst);
+      cl.releaseCommandQueue(cq);
+    }
+    return best > 0 ? 2 * size / best : 0;
+  };
+
+  // Peak figures of a device. GFLOP/s are computeUnits * clock * lanes * 2
+  // (a fused multiply-add per lane and cycle), with 64 lanes per compute unit
+  // on GPUs and twice the native float vector width on CPUs unless given.
+  // options: { lanesPerComputeUnit, gflops, bandwidth, size, iterations }
+  cl.getDevicePeaks = function (ctx, device, options) {
+    options = options || {};
+    var computeUnits = cl.getDeviceInfo(device, cl.DEVICE_MAX_COMPUTE_UNITS);
+    var clockMHz = cl.getDeviceInfo(device, cl.DEVICE_MAX_CLOCK_FREQUENCY);
+    var isGPU = (cl.getDeviceInfo(device, cl.DEVICE_TYPE) & cl.DEVICE_TYPE_GPU) !== 0;
+    var lanes = options.lanesPerComputeUnit ||
+      (isGPU ? 64 : 2 * cl.getDeviceInfo(device, cl.DEVICE_NATIVE_VECTOR_WIDTH_FLOAT));
+    return {
+      name: cl.getDeviceInfo(device, cl.DEVICE_NAME),
+      computeUnits: computeUnits,
+      clockMHz: clockMHz,
+      lanesPerComputeUnit: lanes,
+      globalMemCacheSize: toNumber(cl.getDeviceInfo(device, cl.DEVICE_GLOBAL_MEM_CACHE_SIZE)),
+      gflops: options.gflops || computeUnits * clockMHz * lanes * 2 / 1000,
+      bandwidth: options.bandwidth || cl.measureBandwidth(ctx, device, options)
+    };
+  };
+
+  // One row per kernel of stats (cl.getStats) with a cost:
+  // { name, launches, time (mean ns), bytes, flops, gbPerS, gflopPerS,
+  //   intensity, bound, bandwidthPct, computePct, efficiency, cacheResident,
+  //   estimated }, most time consuming first. efficiency is the share of the
+  // roofline attainable at the intensity of the kernel.
+  cl.kernelReport = function (stats, peaks) {
+    var ridge = peaks.gflops / peaks.bandwidth;
+    var rows = [];
+    stats.forEach(function (s) {
+      var cost = s.name && kernelCosts[s.name];
+      if (!cost || !s.execution.count) {
+        return;
+      }
+      var time = s.execution.mean;
+      var gbPerS = time > 0 ? cost.bytes / time : 0;
+      var gflopPerS = time > 0 ? cost.flops / time : 0;
+      var intensity = cost.bytes > 0 ? cost.flops / cost.bytes : Infinity;
+      var attainable = Math.min(peaks.gflops, intensity * peaks.bandwidth);
+      var bound = intensity < ridge ? "memory" : "compute";
+      rows.push({
+        name: s.name,
+        launches: s.execution.count,
+        time: time,
+        bytes: cost.bytes,
+        flops: cost.flops,
+        gbPerS: gbPerS,
+        gflopPerS: gflopPerS,
+        intensity: intensity,
+        bound: bound,
+        bandwidthPct: 100 * gbPerS / peaks.bandwidth,
+        computePct: 100 * gflopPerS / peaks.gflops,
+        // without flops, only the bandwidth tells
+        efficiency: cost.flops ? 100 * gflopPerS / attainable : 100 * gbPerS / peaks.bandwidth,
+        // data smaller than the cache may beat the memory bandwidth
+        cacheResident: cost.bytes <= peaks.globalMemCacheSize,
+        estimated: cost.estimated
+      });
+    });
+    rows.sort(function (a, b) { return b.time * b.launches - a.time * a.launches; });
+    return rows;
+  };
+
+};
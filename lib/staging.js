@@ -0,0 +1,37 @@
+"use strict";
+
+// Host memory backed by pinned (driver allocated) buffers.
+//
+// Transfers from such ArrayBuffers skip the staging pool used by
+// enqueueReadBuffer/enqueueWriteBuffer above cl.setStagingThreshold(), and
+// reach the device at full DMA speed.
+
+module.exports = function (cl) {
+
+  var pinned = new WeakMap();
+
+  cl.allocPinnedBuffer = function (ctx, cq, size) {
+    var mem = cl.createBuffer(ctx, cl.MEM_READ_WRITE | cl.MEM_ALLOC_HOST_PTR, size, null);
+    var buffer;
+    try {
+      buffer = cl.enqueueMapBuffer(cq, mem, true, cl.MAP_READ | cl.MAP_WRITE, 0, size, [], false);
+    } catch (e) {
+      cl.releaseMemObject(mem);
+      throw e;
+    }
+    pinned.set(buffer, { cq: cq, mem: mem });
+    return buffer;
+  };
+
+  // Gives the memory back to OpenCL, buffer is detached.
+  cl.releasePinnedBuffer = function (buffer) {
+    var entry = pinned.get(buffer);
+    if (!entry) {
+      throw new TypeError("Not a pinned buffer");
+    }
+    pinned.delete(buffer);
+    cl.enqueueUnmapMemObject(entry.cq, entry.mem, buffer);
+    cl.finish(entry.cq);
+    cl.releaseMemObject(entry.mem);
+  };
+};
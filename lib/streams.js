@@ -0,0 +1,209 @@
+"use strict";
+
+// Node streams over OpenCL buffers.
+//
+// Data goes through a ring of `depth` host chunks of `chunkSize` bytes, each
+// transferred with a non-blocking read or write. Host I/O on one chunk
+// overlaps the device transfer of the others, and host memory stays bounded
+// by the ring whatever the size of the buffer.
+
+var stream = require('stream');
+var util = require('util');
+
+var DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+var DEFAULT_DEPTH = 3;
+
+module.exports = function (cl) {
+
+  var makeSlots = function (options) {
+    var slots = [];
+    var depth = options.depth || DEFAULT_DEPTH;
+    var chunkSize = options.chunkSize || DEFAULT_CHUNK_SIZE;
+    for (var i = 0; i < depth; i++) {
+      slots.push({ data: Buffer.allocUnsafeSlow(chunkSize), length: 0, event: null });
+    }
+    return slots;
+  };
+
+  // Calls done(err) once the transfer of slot has completed
+  var whenDone = function (slot, done) {
+    var event = slot.event;
+    cl.setEventCallback(event, cl.COMPLETE, function (_, status) {
+      cl.releaseEvent(event);
+      slot.event = null;
+      done(status < 0 ? new Error("Transfer failed with status " + status) : null);
+    }, {});
+  };
+
+  /**
+   * createWriteStream(command_queue, buffer, { offset, chunkSize, depth })
+   *
+   * Writable filling buffer from offset. Writes are delayed while every
+   * chunk of the ring is in flight. Once the stream is ended, `event` is a
+   * marker completing with the last transfer (to be released by the caller),
+   * and 'finish' is emitted when it has completed.
+   */
+  function CLWriteStream(cq, buffer, options) {
+    options = options || {};
+    stream.Writable.call(this);
+    this.cq = cq;
+    this.mem = buffer;
+    this.position = options.offset || 0;
+    this.chunkSize = options.chunkSize || DEFAULT_CHUNK_SIZE;
+    this.slots = makeSlots(options);
+    this.current = 0;
+    this.event = null;
+  }
+  util.inherits(CLWriteStream, stream.Writable);
+
+  CLWriteStream.prototype._write = function (chunk, encoding, callback) {
+    this._fill(chunk, 0, callback);
+  };
+
+  CLWriteStream.prototype._fill = function (chunk, start, callback) {
+    var self = this;
+    while (start < chunk.length) {
+      var slot = this.slots[this.current];
+      if (slot.event) {
+        // the whole ring is in flight: resume once the oldest chunk is written
+        return whenDone(slot, function (err) {
+          if (err) {
+            return callback(err);
+          }
+          self._fill(chunk, start, callback);
+        });
+      }
+      var n = Math.min(chunk.length - start, this.chunkSize - slot.length);
+      chunk.copy(slot.data, slot.length, start, start + n);
+      slot.length += n;
+      start += n;
+      if (slot.length === this.chunkSize) {
+        try {
+          this._submit(slot);
+        } catch (e) {
+          return callback(e);
+        }
+      }
+    }
+    callback();
+  };
+
+  CLWriteStream.prototype._submit = function (slot) {
+    slot.event = cl.enqueueWriteBuffer(this.cq, this.mem, false, this.position,
+      slot.length, slot.data, [], true);
+    cl.flush(this.cq);
+    this.position += slot.length;
+    slot.length = 0;
+    this.current = (this.current + 1) % this.slots.length;
+  };
+
+  CLWriteStream.prototype._final = function (callback) {
+    var self = this;
+    try {
+      var slot = this.slots[this.current];
+      if (slot.length) {
+        this._submit(slot);
+      }
+      var pending = this.slots.filter(function (s) { return s.event; })
+        .map(function (s) { return s.event; });
+      this.event = cl.enqueueMarkerWithWaitList ?
+        cl.enqueueMarkerWithWaitList(this.cq, pending, true) :
+        cl.enqueueMarker(this.cq, true);
+      cl.flush(this.cq);
+    } catch (e) {
+      return callback(e);
+    }
+
+    cl.setEventCallback(this.event, cl.COMPLETE, function (_, status) {
+      self.slots.forEach(function (s) {
+        if (s.event) {
+          cl.releaseEvent(s.event);
+          s.event = null;
+        }
+      });
+      callback(status < 0 ? new Error("Transfer failed with status " + status) : null);
+    }, {});
+  };
+
+  /**
+   * createReadStream(command_queue, buffer, { offset, length, chunkSize, depth })
+   *
+   * Readable emitting the content of buffer from offset, length bytes (up to
+   * the end of the buffer by default). Up to `depth` reads are in flight; no
+   * new read is issued while the consumer applies backpressure. Emitted
+   * chunks are copies, the ring itself is reused for the following reads.
+   */
+  function CLReadStream(cq, buffer, options) {
+    options = options || {};
+    stream.Readable.call(this);
+    this.cq = cq;
+    this.mem = buffer;
+    this.position = options.offset || 0;
+    this.limit = options.length !== undefined ? this.position + options.length :
+      cl.getMemObjectInfo(buffer, cl.MEM_SIZE);
+    this.chunkSize = options.chunkSize || DEFAULT_CHUNK_SIZE;
+    this.free = makeSlots(options);
+    this.pending = [];
+    this.waiting = false;
+  }
+  util.inherits(CLReadStream, stream.Readable);
+
+  CLReadStream.prototype._read = function () {
+    try {
+      this._pump();
+    } catch (e) {
+      this.emit('error', e);
+    }
+  };
+
+  CLReadStream.prototype._pump = function () {
+    var self = this;
+    var issued = false;
+    while (this.free.length && this.position < this.limit) {
+      var slot = this.free.shift();
+      slot.length = Math.min(this.chunkSize, this.limit - this.position);
+      slot.event = cl.enqueueReadBuffer(this.cq, this.mem, false, this.position,
+        slot.length, slot.data, [], true);
+      this.position += slot.length;
+      this.pending.push(slot);
+      issued = true;
+    }
+    if (issued) {
+      cl.flush(this.cq);
+    }
+
+    if (!this.pending.length) {
+      this.push(null);
+      return;
+    }
+    if (this.waiting) {
+      return;
+    }
+
+    // chunks are emitted in order, so only the oldest read is waited for
+    this.waiting = true;
+    var oldest = this.pending[0];
+    whenDone(oldest, function (err) {
+      self.waiting = false;
+      self.pending.shift();
+      if (err) {
+        self.emit('error', err);
+        return;
+      }
+      var copy = Buffer.allocUnsafe(oldest.length);
+      oldest.data.copy(copy, 0, 0, oldest.length);
+      self.free.push(oldest);
+      if (self.push(copy)) {
+        self._read();
+      }
+    });
+  };
+
+  cl.createWriteStream = function (cq, buffer, options) {
+    return new CLWriteStream(cq, buffer, options);
+  };
+
+  cl.createReadStream = function (cq, buffer, options) {
+    return new CLReadStream(cq, buffer, options);
+  };
+};
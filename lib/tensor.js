@@ -0,0 +1,352 @@
+"use strict";
+
+// Strided N-D tensor transfers.
+//
+// A tensor view is a shape plus, on each side of the transfer, an offset and
+// strides counted in elements (C-contiguous by default). Both views are
+// reduced to the fewest dimensions, the innermost ones are mapped onto the
+// three dimensions of a rect transfer and the outer ones left over are looped
+// over. When that takes too many commands (e.g. transpositions, where only
+// single elements are contiguous on both sides), a strided copy kernel
+// gathers or scatters the elements on the device instead.
+
+var MAX_TRANSFERS = 16;
+
+var COPY_KERNEL = [
+  "#define PARAM(j) ((ulong) params[2 * (j)] | ((ulong) params[2 * (j) + 1] << 32))",
+  "",
+  "// params: src offset, dst offset, shape, src strides, dst strides (bytes,",
+  "// as (lo, hi) pairs)",
+  "__kernel void strided_copy(__global const uchar *src, __global uchar *dst,",
+  "                           __constant uint *params, uint ndim, uint element_size)",
+  "{",
+  "  ulong i = get_global_id(0);",
+  "  ulong s = PARAM(0), d = PARAM(1);",
+  "  for (int k = (int) ndim - 1; k >= 0; k--) {",
+  "    ulong n = PARAM(2 + k);",
+  "    ulong idx = i % n;",
+  "    i /= n;",
+  "    s += idx * PARAM(2 + ndim + k);",
+  "    d += idx * PARAM(2 + 2 * ndim + k);",
+  "  }",
+  "  for (uint b = 0; b < element_size; b++)",
+  "    dst[d + b] = src[s + b];",
+  "}"
+].join("\n");
+
+module.exports = function (cl) {
+
+  // Copy kernels, by command queue
+  var kernels = new WeakMap();
+
+  var contiguous = function (shape) {
+    var strides = new Array(shape.length);
+    var s = 1;
+    for (var i = shape.length - 1; i >= 0; i--) {
+      strides[i] = s;
+      s *= shape[i];
+    }
+    return strides;
+  };
+
+  var product = function (shape) {
+    return shape.reduce(function (a, b) { return a * b; }, 1);
+  };
+
+  // One side of a transfer in bytes, from an offset and strides in elements
+  var side = function (shape, offset, strides, es) {
+    strides = strides || contiguous(shape);
+    if (strides.length !== shape.length) {
+      throw new RangeError("Strides must have one entry per dimension");
+    }
+    return {
+      offset: (offset || 0) * es,
+      strides: strides.map(function (s) {
+        if (s < 0 || s !== Math.floor(s)) {
+          throw new RangeError("Strides must be non-negative integers");
+        }
+        return s * es;
+      })
+    };
+  };
+
+  // Dimensions from the largest stride to the smallest
+  var strideOrder = function (strides) {
+    var order = strides.map(function (_, i) { return i; });
+    return order.sort(function (i, j) { return strides[j] - strides[i] || i - j; });
+  };
+
+  var permute = function (order, values) {
+    return order.map(function (i) { return values[i]; });
+  };
+
+  // Dense layout of shape with its dimensions in the given order, outermost
+  // first
+  var denseIn = function (shape, order, es) {
+    var strides = new Array(shape.length);
+    var s = es;
+    for (var k = order.length - 1; k >= 0; k--) {
+      strides[order[k]] = s;
+      s *= shape[order[k]];
+    }
+    return { offset: 0, strides: strides };
+  };
+
+  // Drops dimensions of size 1 and merges the dimensions that are contiguous
+  // with their inner neighbour on both sides.
+  var normalize = function (shape, a, b) {
+    var v = { shape: [], a: { offset: a.offset, strides: [] }, b: { offset: b.offset, strides: [] } };
+    for (var i = 0; i < shape.length; i++) {
+      if (shape[i] === 1) {
+        continue;
+      }
+      var n = v.shape.length - 1;
+      if (n >= 0 && v.a.strides[n] === shape[i] * a.strides[i] &&
+          v.b.strides[n] === shape[i] * b.strides[i]) {
+        v.shape[n] *= shape[i];
+        v.a.strides[n] = a.strides[i];
+        v.b.strides[n] = b.strides[i];
+      } else {
+        v.shape.push(shape[i]);
+        v.a.strides.push(a.strides[i]);
+        v.b.strides.push(b.strides[i]);
+      }
+    }
+    return v;
+  };
+
+  // Maps a normalized view onto rect transfers. region[0] is a run of bytes
+  // contiguous on both sides, region[1] and region[2] take the innermost
+  // dimensions whose pitches meet the rect constraints on both sides.
+  var planRects = function (v, es) {
+    var k = v.shape.length;
+    var x = es;
+    if (k && v.a.strides[k - 1] === es && v.b.strides[k - 1] === es) {
+      k--;
+      x = v.shape[k] * es;
+    }
+    var plan = { region: [x, 1, 1], pitchA: [0, 0], pitchB: [0, 0] };
+    for (var n = 0; n < 2 && k > 0; n++) {
+      var sa = v.a.strides[k - 1];
+      var sb = v.b.strides[k - 1];
+      var ok = n === 0 ?
+        sa >= x && sb >= x :
+        sa >= plan.region[1] * plan.pitchA[0] && sa % plan.pitchA[0] === 0 &&
+        sb >= plan.region[1] * plan.pitchB[0] && sb % plan.pitchB[0] === 0;
+      if (!ok) {
+        break;
+      }
+      k--;
+      plan.region[n + 1] = v.shape[k];
+      plan.pitchA[n] = sa;
+      plan.pitchB[n] = sb;
+    }
+    plan.outer = v.shape.slice(0, k);
+    plan.outerA = v.a.strides.slice(0, k);
+    plan.outerB = v.b.strides.slice(0, k);
+    plan.count = product(plan.outer);
+    return plan;
+  };
+
+  var origin = function (offset, rowPitch) {
+    return rowPitch ? [offset % rowPitch, Math.floor(offset / rowPitch), 0] : [offset, 0, 0];
+  };
+
+  // Calls enqueue(originA, originB) for every rect of the plan, returns the
+  // events.
+  var runRects = function (v, plan, enqueue) {
+    var events = [];
+    var index = plan.outer.map(function () { return 0; });
+    for (var r = 0; r < plan.count; r++) {
+      var offA = v.a.offset;
+      var offB = v.b.offset;
+      for (var d = 0; d < index.length; d++) {
+        offA += index[d] * plan.outerA[d];
+        offB += index[d] * plan.outerB[d];
+      }
+      events.push(enqueue(origin(offA, plan.pitchA[0]), origin(offB, plan.pitchB[0])));
+      for (d = index.length - 1; d >= 0 && ++index[d] === plan.outer[d]; d--) {
+        index[d] = 0;
+      }
+    }
+    return events;
+  };
+
+  var copyKernel = function (cq) {
+    var kernel = kernels.get(cq);
+    if (!kernel) {
+      var ctx = cl.getCommandQueueInfo(cq, cl.QUEUE_CONTEXT);
+      var prg = cl.createProgramWithSource(ctx, COPY_KERNEL);
+      cl.buildProgram(prg);
+      kernel = cl.createKernel(prg, "strided_copy");
+      kernels.set(cq, kernel);
+    }
+    return kernel;
+  };
+
+  // Enqueues the strided copy kernel from view a of src to view b of dst.
+  // The returned event owns the temporary parameter buffer.
+  var runKernel = function (cq, src, dst, v, es, waitList) {
+    var ctx = cl.getCommandQueueInfo(cq, cl.QUEUE_CONTEXT);
+    var values = [v.a.offset, v.b.offset].concat(v.shape, v.a.strides, v.b.strides);
+    var words = new Uint32Array(2 * values.length);
+    values.forEach(function (value, j) {
+      words[2 * j] = value % 0x100000000;
+      words[2 * j + 1] = Math.floor(value / 0x100000000);
+    });
+    var params = cl.createBuffer(ctx, cl.MEM_READ_ONLY | cl.MEM_COPY_HOST_PTR, words.byteLength, words);
+
+    var kernel = copyKernel(cq);
+    cl.setKernelArg(kernel, 0, "uchar*", src);
+    cl.setKernelArg(kernel, 1, "uchar*", dst);
+    cl.setKernelArg(kernel, 2, "uint*", params);
+    cl.setKernelArg(kernel, 3, "uint", v.shape.length);
+    cl.setKernelArg(kernel, 4, "uint", es);
+    var event = cl.enqueueNDRangeKernel(cq, kernel, 1, null, [product(v.shape)], null, waitList, true);
+    releaseOnComplete([event], [params]);
+    return event;
+  };
+
+  // Releases mems once all of events have completed
+  var releaseOnComplete = function (events, mems) {
+    var pending = events.length;
+    events.forEach(function (event) {
+      cl.setEventCallback(event, cl.COMPLETE, function () {
+        if (--pending === 0) {
+          mems.forEach(function (mem) {
+            cl.releaseMemObject(mem);
+          });
+        }
+      }, {});
+    });
+  };
+
+  // Turns the events of a transfer into its result: waits for them when
+  // blocking, returns a single event when asked to.
+  var finish = function (cq, events, options) {
+    var event = null;
+    if (options.event) {
+      if (events.length === 1) {
+        event = events.pop();
+      } else if (cl.enqueueMarkerWithWaitList) {
+        event = cl.enqueueMarkerWithWaitList(cq, events, true);
+      } else {
+        event = cl.enqueueMarker(cq, true);
+      }
+    }
+    var all = event ? events.concat([event]) : events;
+    if (options.blocking !== false && all.length) {
+      cl.waitForEvents(all);
+    } else {
+      cl.flush(cq);
+    }
+    events.forEach(function (e) {
+      cl.releaseEvent(e);
+    });
+    return event || cl.SUCCESS;
+  };
+
+  // Transfers between a buffer (side a) and host memory (side b) with
+  // rects, or through a temporary buffer laid out like the host view and the
+  // copy kernel, which then does the whole permutation on the device.
+  var transfer = function (cq, buffer, ptr, shape, options, write) {
+    var es = options.elementSize || 4;
+    var waitList = options.waitList || [];
+    var a = side(shape, options.bufferOffset, options.bufferStrides, es);
+    var b = side(shape, options.hostOffset, options.hostStrides, es);
+    var maxTransfers = options.maxTransfers || MAX_TRANSFERS;
+
+    var rects = function (buf, v, deps) {
+      var plan = planRects(v, es);
+      return runRects(v, plan, function (originA, originB) {
+        return (write ? cl.enqueueWriteBufferRect : cl.enqueueReadBufferRect)(
+          cq, buf, false, originA, originB, plan.region,
+          plan.pitchA[0], plan.pitchA[1], plan.pitchB[0], plan.pitchB[1],
+          ptr, deps, true);
+      });
+    };
+
+    if (!product(shape)) {
+      return finish(cq, [], options);
+    }
+    var v = normalize(shape, a, b);
+    if (planRects(v, es).count <= maxTransfers) {
+      return finish(cq, rects(buffer, v, waitList), options);
+    }
+
+    // gather into (or scatter from) a dense copy of the view, in the
+    // dimension order of the host view: between the two, dimensions taken in
+    // that order merge, down to a single run when the host view is dense
+    var ctx = cl.getCommandQueueInfo(cq, cl.QUEUE_CONTEXT);
+    var order = strideOrder(b.strides);
+    var dense = denseIn(shape, order, es);
+    var hostView = normalize(permute(order, shape),
+      { offset: 0, strides: permute(order, dense.strides) },
+      { offset: b.offset, strides: permute(order, b.strides) });
+    var temp = cl.createBuffer(ctx, cl.MEM_READ_WRITE, product(shape) * es, null);
+    var events;
+    if (write) {
+      var uploads = rects(temp, hostView, waitList);
+      events = [runKernel(cq, temp, buffer, normalize(shape, dense, a), es, uploads)];
+      uploads.forEach(function (e) {
+        cl.releaseEvent(e);
+      });
+    } else {
+      var gather = runKernel(cq, buffer, temp, normalize(shape, a, dense), es, waitList);
+      events = rects(temp, hostView, [gather]);
+      cl.releaseEvent(gather);
+    }
+    releaseOnComplete(events, [temp]);
+    return finish(cq, events, options);
+  };
+
+  /**
+   * readTensor(command_queue, buffer, ptr, shape, options)
+   * writeTensor(command_queue, buffer, ptr, shape, options)
+   *
+   * Transfer the elements of shape between a view of buffer and a view of
+   * ptr. options:
+   * - elementSize: bytes per element (4)
+   * - bufferOffset, bufferStrides, hostOffset, hostStrides: views, in
+   *   elements (C-contiguous by default)
+   * - blocking: wait for the transfer (true)
+   * - waitList, event: as for the other enqueue functions, event asks for an
+   *   event covering the whole transfer
+   * - maxTransfers: rect commands above which the copy kernel is used (16)
+   */
+  cl.readTensor = function (cq, buffer, ptr, shape, options) {
+    return transfer(cq, buffer, ptr, shape, options || {}, false);
+  };
+
+  cl.writeTensor = function (cq, buffer, ptr, shape, options) {
+    return transfer(cq, buffer, ptr, shape, options || {}, true);
+  };
+
+  /**
+   * copyTensor(command_queue, src, dst, shape, options)
+   *
+   * Same as readTensor between two buffers, with srcOffset, srcStrides,
+   * dstOffset and dstStrides for the views. Non-blocking.
+   */
+  cl.copyTensor = function (cq, src, dst, shape, options) {
+    options = Object.assign({ blocking: false }, options);
+    var es = options.elementSize || 4;
+    var waitList = options.waitList || [];
+    var a = side(shape, options.srcOffset, options.srcStrides, es);
+    var b = side(shape, options.dstOffset, options.dstStrides, es);
+
+    if (!product(shape)) {
+      return finish(cq, [], options);
+    }
+    var v = normalize(shape, a, b);
+    var plan = planRects(v, es);
+    // no host round trip here, a single launch beats several rects
+    if (plan.count > 1) {
+      return finish(cq, [runKernel(cq, src, dst, v, es, waitList)], options);
+    }
+    return finish(cq, runRects(v, plan, function (originA, originB) {
+      return cl.enqueueCopyBufferRect(cq, src, dst, originA, originB, plan.region,
+        plan.pitchA[0], plan.pitchA[1], plan.pitchB[0], plan.pitchB[1], waitList, true);
+    }), options);
+  };
+};
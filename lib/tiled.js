@@ -0,0 +1,431 @@
+"use strict";
+
+// Out-of-core execution of a kernel over data larger than device memory.
+//
+// The data is cut into tiles going through three stages, each on its own
+// in-order queue: the upload of tile i+1, the compute of tile i and the
+// download of tile i-1 run concurrently, ordered by events. Three sets of
+// device buffers rotate between the stages.
+
+var fs = require('fs');
+
+var DEPTH = 3;
+
+module.exports = function (cl) {
+
+  var whenComplete = function (event) {
+    return new Promise(function (resolve, reject) {
+      cl.setEventCallback(event, cl.COMPLETE, function (_, status) {
+        if (status < 0) {
+          reject(new Error("Tile command failed with status " + status));
+          return;
+        }
+        resolve();
+      }, {});
+    });
+  };
+
+  // cl_ulong device info comes as [hi, lo]
+  var toNumber = function (value) {
+    return Array.isArray(value) ? value[0] * 0x100000000 + (value[1] >>> 0) : value;
+  };
+
+  var asBuffer = function (data) {
+    return data instanceof ArrayBuffer ? Buffer.from(data) :
+      Buffer.from(data.buffer, data.byteOffset, data.byteLength);
+  };
+
+  // Sources upload the bytes [start, end) of the input into a buffer, clipped
+  // at the end of the input. They resolve with the upload event and the
+  // number of bytes uploaded.
+
+  var arraySource = function (data) {
+    var bytes = asBuffer(data);
+    return {
+      size: bytes.length,
+      upload: function (cq, mem, start, end) {
+        end = Math.min(end, bytes.length);
+        var event = cl.enqueueWriteBuffer(cq, mem, false, 0, end - start,
+          bytes.slice(start, end), [], true);
+        return Promise.resolve({ event: event, length: end - start });
+      }
+    };
+  };
+
+  var fileSource = function (path) {
+    var size = fs.statSync(path).size;
+    return {
+      size: size,
+      upload: function (cq, mem, start, end) {
+        end = Math.min(end, size);
+        var event = cl.enqueueWriteBufferFromFile(cq, mem, path, start, end - start, 0, [], true);
+        return Promise.resolve({ event: event, length: end - start });
+      }
+    };
+  };
+
+  // Tiles only move forward, so a stream source keeps the bytes from the
+  // start of the last tile (i.e. the halo shared with the next one) on.
+  var streamSource = function (readable) {
+    var chunks = [];
+    var base = 0;
+    var length = 0;
+    var ended = false;
+    var error = null;
+    var wake = null;
+
+    var notify = function () {
+      if (wake) {
+        wake();
+      }
+    };
+    readable.on('data', function (chunk) {
+      chunks.push(chunk);
+      length += chunk.length;
+      notify();
+    });
+    readable.on('end', function () {
+      ended = true;
+      notify();
+    });
+    readable.on('error', function (err) {
+      error = err;
+      notify();
+    });
+    readable.pause();
+
+    var fill = function (end) {
+      return new Promise(function (resolve, reject) {
+        wake = function () {
+          if (error) {
+            wake = null;
+            reject(error);
+          } else if (ended || base + length >= end) {
+            wake = null;
+            readable.pause();
+            resolve();
+          }
+        };
+        readable.resume();
+        wake();
+      });
+    };
+
+    return {
+      size: Infinity,
+      upload: function (cq, mem, start, end) {
+        return fill(end).then(function () {
+          var all = Buffer.concat(chunks, length);
+          var data = all.slice(start - base, Math.min(end - base, length));
+          chunks = [all.slice(start - base)];
+          length -= start - base;
+          base = start;
+          if (!data.length) {
+            return { event: null, length: 0 };
+          }
+          var event = cl.enqueueWriteBuffer(cq, mem, false, 0, data.length, data, [], true);
+          return { event: event, length: data.length, hold: data };
+        });
+      }
+    };
+  };
+
+  // Sinks download length bytes of a buffer to offset in the output. The
+  // optional deliver() runs once the download has completed, in tile order.
+
+  var arraySink = function (data) {
+    var bytes = asBuffer(data);
+    return {
+      download: function (cq, mem, offset, length, waitList) {
+        if (offset + length > bytes.length) {
+          throw new RangeError("Tiled output exceeds the sink");
+        }
+        return {
+          event: cl.enqueueReadBuffer(cq, mem, false, 0, length,
+            bytes.slice(offset, offset + length), waitList, true)
+        };
+      }
+    };
+  };
+
+  var fileSink = function (path) {
+    return {
+      download: function (cq, mem, offset, length, waitList) {
+        return {
+          event: cl.enqueueReadBufferToFile(cq, mem, path, offset, length, 0, waitList, true)
+        };
+      }
+    };
+  };
+
+  var hostSink = function (consume) {
+    return {
+      download: function (cq, mem, offset, length, waitList) {
+        var host = Buffer.allocUnsafe(length);
+        return {
+          event: cl.enqueueReadBuffer(cq, mem, false, 0, length, host, waitList, true),
+          deliver: function () {
+            return consume(host, offset);
+          }
+        };
+      }
+    };
+  };
+
+  var streamSink = function (writable) {
+    return hostSink(function (chunk) {
+      return new Promise(function (resolve) {
+        if (writable.write(chunk)) {
+          resolve();
+        } else {
+          writable.once('drain', resolve);
+        }
+      });
+    });
+  };
+
+  var isStream = function (obj) {
+    return obj && typeof obj.on === 'function' && typeof obj.pause === 'function';
+  };
+
+  var makeSource = function (source) {
+    if (typeof source === 'string') {
+      return fileSource(source);
+    }
+    return isStream(source) ? streamSource(source) : arraySource(source);
+  };
+
+  var makeSink = function (sink) {
+    if (typeof sink === 'string') {
+      return fileSink(sink);
+    }
+    if (typeof sink === 'function') {
+      return hostSink(sink);
+    }
+    return sink && typeof sink.write === 'function' ? streamSink(sink) : arraySink(sink);
+  };
+
+  var setDefaultArgs = function (kernel, input, output, tile) {
+    cl.setKernelArg(kernel, 0, "uchar*", input);
+    cl.setKernelArg(kernel, 1, "uchar*", output);
+    cl.setKernelArg(kernel, 2, "uint", tile.length);
+    cl.setKernelArg(kernel, 3, "uint", tile.haloBefore);
+  };
+
+  var isOutOfMemory = function (e) {
+    return [cl.MEM_OBJECT_ALLOCATION_FAILURE, cl.OUT_OF_RESOURCES, cl.OUT_OF_HOST_MEMORY]
+      .some(function (err) { return err && e.message === err.message; });
+  };
+
+  // Largest tile (in elements) for which the three sets of buffers fit in the
+  // memory budget, by default half of the device global memory.
+  var fitTileSize = function (device, options) {
+    var globalMem = toNumber(cl.getDeviceInfo(device, cl.DEVICE_GLOBAL_MEM_SIZE));
+    var maxAlloc = toNumber(cl.getDeviceInfo(device, cl.DEVICE_MAX_MEM_ALLOC_SIZE));
+    var budget = Math.min(options.memoryBudget || globalMem / 2, globalMem);
+    var halo = options.haloBefore + options.haloAfter;
+
+    var fit = Math.floor((budget / DEPTH - halo * options.elementSize) /
+      (options.elementSize + options.outputElementSize));
+    fit = Math.min(fit,
+      Math.floor(maxAlloc / options.elementSize) - halo,
+      Math.floor(maxAlloc / options.outputElementSize));
+    return options.tileSize ? Math.min(options.tileSize, fit) : fit;
+  };
+
+  // Allocates the rotating buffers, shrinking the tiles as long as the
+  // device runs out of memory.
+  var allocSlots = function (ctx, options) {
+    for (;;) {
+      if (options.tileSize < 1) {
+        throw new Error("Not enough device memory for a single tile");
+      }
+      var slots = [];
+      try {
+        for (var i = 0; i < DEPTH; i++) {
+          var slot = { input: null, output: null, tile: null };
+          slots.push(slot);
+          slot.input = cl.createBuffer(ctx, cl.MEM_READ_ONLY,
+            (options.tileSize + options.haloBefore + options.haloAfter) * options.elementSize, null);
+          slot.output = cl.createBuffer(ctx, cl.MEM_WRITE_ONLY,
+            options.tileSize * options.outputElementSize, null);
+        }
+        return slots;
+      } catch (e) {
+        releaseSlots(slots);
+        if (!isOutOfMemory(e)) {
+          throw e;
+        }
+        options.tileSize = Math.floor(options.tileSize / 2);
+      }
+    }
+  };
+
+  var releaseSlots = function (slots) {
+    slots.forEach(function (slot) {
+      if (slot.input) {
+        cl.releaseMemObject(slot.input);
+      }
+      if (slot.output) {
+        cl.releaseMemObject(slot.output);
+      }
+    });
+  };
+
+  var createQueue = function (ctx, device) {
+    return cl.createCommandQueueWithProperties ?
+      cl.createCommandQueueWithProperties(ctx, device, []) :
+      cl.createCommandQueue(ctx, device, 0);
+  };
+
+  /**
+   * runTiled(context, device, kernel, options)
+   *
+   * Runs kernel over options.source (ArrayBuffer or view, file path or
+   * Readable), one tile at a time, into options.sink (ArrayBuffer or view,
+   * file path, Writable or function(chunk, offset)). Returns a Promise of
+   * { tiles, tileSize } resolved once every tile has reached the sink.
+   *
+   * options:
+   * - elementSize, outputElementSize: bytes per input and output element (4)
+   * - tileSize: elements per tile, shrunk to fit in device memory
+   * - halo: elements of context around each tile, a number or [before, after]
+   * - memoryBudget: device bytes available to the tiles
+   * - localSize: work-group size, the global size is rounded up to it
+   * - setArgs(kernel, input, output, tile): sets the kernel arguments of a
+   *   tile { index, offset, length, haloBefore, haloAfter }, by default
+   *   (input, output, uint length, uint haloBefore)
+   *
+   * The kernel runs over tile.length work-items and writes tile.length
+   * output elements, reading input elements [haloBefore, haloBefore + length)
+   * and their halo. Halos are clipped at the ends of the data.
+   */
+  cl.runTiled = function (ctx, device, kernel, options) {
+    options = Object.assign({}, options);
+    options.elementSize = options.elementSize || 4;
+    options.outputElementSize = options.outputElementSize || options.elementSize;
+    var halo = Array.isArray(options.halo) ? options.halo : [options.halo || 0, options.halo || 0];
+    options.haloBefore = halo[0];
+    options.haloAfter = halo[1];
+
+    var es = options.elementSize;
+    var os = options.outputElementSize;
+    var setArgs = options.setArgs || setDefaultArgs;
+    var localSize = options.localSize;
+
+    var source, sink, slots, queues = [];
+    try {
+      source = makeSource(options.source);
+      sink = makeSink(options.sink);
+      options.tileSize = fitTileSize(device, options);
+      slots = allocSlots(ctx, options);
+      for (var q = 0; q < DEPTH; q++) {
+        queues.push(createQueue(ctx, device));
+      }
+    } catch (e) {
+      if (slots) {
+        releaseSlots(slots);
+      }
+      queues.forEach(function (queue) {
+        cl.releaseCommandQueue(queue);
+      });
+      return Promise.reject(e);
+    }
+
+    var upQ = queues[0], computeQ = queues[1], downQ = queues[2];
+    var tileSize = options.tileSize;
+    var delivered = Promise.resolve();
+    var outstanding = [];
+    var count = 0;
+
+    var retire = function (slot) {
+      var tile = slot.tile;
+      slot.tile = null;
+      return tile ? tile.done : Promise.resolve();
+    };
+
+    var step = function (index, start) {
+      if (start * es >= source.size) {
+        return Promise.resolve();
+      }
+      var slot = slots[index % DEPTH];
+
+      // the slot is free once the tile it held three steps ago is out
+      return retire(slot).then(function () {
+        var from = Math.max(0, start - options.haloBefore);
+        return source.upload(upQ, slot.input, from * es, (start + tileSize + options.haloAfter) * es)
+          .then(function (up) {
+            var available = Math.floor(up.length / es);
+            var tile = {
+              index: index,
+              offset: start,
+              length: Math.min(tileSize, available - (start - from)),
+              haloBefore: start - from
+            };
+            if (tile.length <= 0) {
+              if (up.event) {
+                cl.releaseEvent(up.event);
+              }
+              return;
+            }
+            tile.haloAfter = available - tile.haloBefore - tile.length;
+
+            setArgs(kernel, slot.input, slot.output, tile);
+            var global = localSize ? Math.ceil(tile.length / localSize) * localSize : tile.length;
+            var computed = cl.enqueueNDRangeKernel(computeQ, kernel, 1, null, [global],
+              localSize ? [localSize] : null, [up.event], true);
+            var down = sink.download(downQ, slot.output, start * os, tile.length * os, [computed]);
+            queues.forEach(function (queue) {
+              cl.flush(queue);
+            });
+
+            var events = [up.event, computed, down.event];
+            outstanding.push(events);
+            delivered = Promise.all([delivered, whenComplete(down.event)]).then(function () {
+              return down.deliver ? down.deliver() : null;
+            });
+            var done = delivered.then(function () {
+              releaseEvents(events);
+            });
+            // failures are reported by the step waiting for the slot
+            done.catch(function () {});
+            slot.tile = { hold: up.hold, done: done };
+            count++;
+            return step(index + 1, start + tile.length);
+          });
+      });
+    };
+
+    var releaseEvents = function (events) {
+      events.forEach(function (event) {
+        cl.releaseEvent(event);
+      });
+      outstanding.splice(outstanding.indexOf(events), 1);
+    };
+
+    var cleanup = function () {
+      queues.forEach(function (queue) {
+        cl.finish(queue);
+      });
+      while (outstanding.length) {
+        releaseEvents(outstanding[0]);
+      }
+      releaseSlots(slots);
+      queues.forEach(function (queue) {
+        cl.releaseCommandQueue(queue);
+      });
+    };
+
+    return step(0, 0)
+      .then(function () {
+        return Promise.all(slots.map(retire));
+      })
+      .then(function () {
+        cleanup();
+        return { tiles: count, tileSize: tileSize };
+      }, function (err) {
+        cleanup();
+        throw err;
+      });
+  };
+};
@@ -1,16 +1,22 @@
 #include "common.h"
 #include "commandqueue.h"
 #include "context.h"
+#include "convert.h"
 #include "device.h"
 #include "event.h"
+#include "filemap.h"
+#include "hostmem.h"
 #include "kernel.h"
 #include "memobj.h"
 #include "platform.h"
 #include "program.h"
+#include "recorder.h"
 #include "sampler.h"
 #include "pipe.h"
 #include "types.h"
 #include "svm.h"
+#include "staging.h"
+#include "tracing.h"
 
 #define JS_CL_CONSTANT(name) Nan::Set(target, JS_STR( #name ), JS_INT(CL_ ## name))
 #define JS_CL_ERROR(name) Nan::Set(target, JS_STR( #name ), Nan::Error(JS_STR(opencl::getExceptionMessage(CL_ ## name))) )
@@ -90,19 +96,31 @@ NAN_MODULE_INIT(init)
 #else
   Nan::Set(target, JS_STR("CL_VERSION_2_0" ), Nan::False());
 #endif
+#ifdef CL_VERSION_2_1
+  Nan::Set(target, JS_STR("CL_VERSION_2_1" ), Nan::True());
+#else
+  Nan::Set(target, JS_STR("CL_VERSION_2_1" ), Nan::False());
+#endif
 
   // OpenCL methods
+  opencl::BindingStats::init(target);
   opencl::CommandQueue::init(target);
   opencl::Context::init(target);
+  opencl::Convert::init(target);
   opencl::Device::init(target);
   opencl::Event::init(target);
+  opencl::FileMap::init(target);
+  opencl::HostMem::init(target);
   opencl::Kernel::init(target);
   opencl::MemObj::init(target);
   opencl::Platform::init(target);
   opencl::Program::init(target);
+  opencl::Recorder::init(target);
   opencl::Sampler::init(target);
   opencl::Pipe::init(target);
   opencl::SVM::init(target);
+  opencl::Staging::init(target);
+  opencl::Tracing::init(target);
   opencl::Types::init(target);
 
   /**
@@ -779,5 +797,6 @@ NAN_MODULE_INIT(init)
 
 }
 
-NODE_MODULE(opencl, init)
+// context aware: can be loaded by worker threads as well
+NAN_MODULE_WORKER_ENABLED(opencl, init)
 }
@@ -0,0 +1,135 @@
+#include "bindingstats.h"
+#include "tracing.h"
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace opencl {
+
+std::atomic<bool> bindingTiming(false);
+thread_local uint64_t driverTime = 0;
+
+struct BindingCounter {
+  const char *name;
+  Nan::FunctionCallback fn;
+  bool traced;
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> time;
+  std::atomic<uint64_t> driver;
+};
+
+// One counter per name for the process, shared by the isolates of all the
+// threads loading the addon. Counters are never freed: the functions of each
+// isolate point to them.
+static std::mutex countersMutex;
+static std::map<std::string, BindingCounter*> counters;
+
+// Enqueues, builds and creations (buffer allocations...) get a span in the
+// node-opencl trace_events category
+static bool isTraced(const std::string &name) {
+  static const char *prefixes[] = { "enqueue", "build", "compile", "link", "create", "svmAlloc" };
+  for(const char *prefix : prefixes) {
+    if(!name.compare(0, strlen(prefix), prefix))
+      return true;
+  }
+  return false;
+}
+
+static void timedCall(BindingCounter *c, const Nan::FunctionCallbackInfo<v8::Value> &info) {
+  if(!bindingTiming.load(std::memory_order_relaxed)) {
+    c->fn(info);
+    return;
+  }
+
+  // calls made from callbacks of this one are accounted separately
+  uint64_t outerDriverTime = driverTime;
+  driverTime = 0;
+  uint64_t start = bindingClock();
+  c->fn(info);
+  c->time.fetch_add(bindingClock() - start, std::memory_order_relaxed);
+  c->driver.fetch_add(driverTime, std::memory_order_relaxed);
+  driverTime = outerDriverTime;
+}
+
+static NAN_METHOD(CountedCall) {
+  BindingCounter *c = static_cast<BindingCounter*>(info.Data().As<External>()->Value());
+  c->calls.fetch_add(1, std::memory_order_relaxed);
+  if(c->traced && tracingEnabled()) {
+    TraceScope span(c->name);
+    timedCall(c, info);
+  } else {
+    timedCall(c, info);
+  }
+}
+
+void setMethod(Local<Object> target, const char *name, Nan::FunctionCallback fn) {
+  BindingCounter *c;
+  {
+    std::lock_guard<std::mutex> lock(countersMutex);
+    auto it = counters.insert(std::make_pair(std::string(name), (BindingCounter*) nullptr)).first;
+    BindingCounter *&counter = it->second;
+    if(!counter) {
+      counter = new BindingCounter();
+      // map keys never move
+      counter->name = it->first.c_str();
+      counter->fn = fn;
+      counter->traced = isTraced(it->first);
+      counter->calls = 0;
+      counter->time = 0;
+      counter->driver = 0;
+    }
+    c = counter;
+  }
+
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(CountedCall, Nan::New<External>(c));
+  Local<Function> f = Nan::GetFunction(tpl).ToLocalChecked();
+  f->SetName(JS_STR(name));
+  Nan::Set(target, JS_STR(name), f);
+}
+
+// setBindingTiming(enabled)
+NAN_METHOD(SetBindingTiming) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  bindingTiming = Nan::To<bool>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+// getBindingStats(reset)
+// Returns { name: { calls, time, driverTime, marshalingTime } } for the
+// functions called so far, times in nanoseconds (0 while timing is off).
+NAN_METHOD(GetBindingStats) {
+  Nan::HandleScope scope;
+
+  bool reset = ARG_EXISTS(0) && Nan::To<bool>(info[0]).FromJust();
+
+  Local<Object> result = Nan::New<Object>();
+  std::lock_guard<std::mutex> lock(countersMutex);
+  for(auto &entry : counters) {
+    BindingCounter &c = *entry.second;
+    uint64_t calls = reset ? c.calls.exchange(0) : c.calls.load();
+    uint64_t time = reset ? c.time.exchange(0) : c.time.load();
+    uint64_t driver = reset ? c.driver.exchange(0) : c.driver.load();
+    if(!calls)
+      continue;
+    Local<Object> stats = Nan::New<Object>();
+    Nan::Set(stats, JS_STR("calls"), JS_SIZE(calls));
+    Nan::Set(stats, JS_STR("time"), JS_SIZE(time));
+    Nan::Set(stats, JS_STR("driverTime"), JS_SIZE(driver));
+    Nan::Set(stats, JS_STR("marshalingTime"), JS_SIZE(time > driver ? time - driver : 0));
+    Nan::Set(result, JS_STR(entry.first), stats);
+  }
+  info.GetReturnValue().Set(result);
+}
+
+namespace BindingStats {
+NAN_MODULE_INIT(init)
+{
+  Nan::SetMethod(target, "setBindingTiming", SetBindingTiming);
+  Nan::SetMethod(target, "getBindingStats", GetBindingStats);
+}
+} // namespace BindingStats
+
+} // namespace opencl
@@ -0,0 +1,69 @@
+#ifndef BINDINGSTATS_H_
+#define BINDINGSTATS_H_
+
+// Included at the end of common.h: every translation unit counts its binding
+// calls and times the OpenCL calls it wraps in NOCL_CL.
+#include "common.h"
+#include <atomic>
+#include <chrono>
+
+namespace opencl {
+
+// Call counters of the JS entry points are always on. Timing is off until
+// cl.setBindingTiming(true): then each call measures its total time and the
+// time spent in the OpenCL driver, the rest being marshaling.
+extern std::atomic<bool> bindingTiming;
+
+// Driver time of the binding call running on this thread, in nanoseconds
+extern thread_local uint64_t driverTime;
+
+inline uint64_t bindingClock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class DriverTimer {
+public:
+  DriverTimer() : start(bindingTiming.load(std::memory_order_relaxed) ? bindingClock() : 0) {}
+  ~DriverTimer() {
+    if(start)
+      driverTime += bindingClock() - start;
+  }
+private:
+  uint64_t start;
+};
+
+template<typename R, typename... Args>
+struct TimedDriverFunction {
+  R (CL_API_CALL *fn)(Args...);
+
+  R operator()(Args... args) const {
+    DriverTimer timer;
+    return fn(args...);
+  }
+};
+
+template<typename R, typename... Args>
+inline TimedDriverFunction<R, Args...> timedDriverFunction(R (CL_API_CALL *fn)(Args...)) {
+  return TimedDriverFunction<R, Args...>{ fn };
+}
+
+// Nan::SetMethod, with the function counted and timed under its name, and
+// traced for enqueues, builds and creations (see tracing.h)
+void setMethod(Local<Object> target, const char *name, Nan::FunctionCallback fn);
+
+namespace BindingStats {
+NAN_MODULE_INIT(init);
+} // namespace BindingStats
+
+} // namespace opencl
+
+#define NOCL_SET_METHOD(target, name, fn) opencl::setMethod(target, name, fn)
+
+// An OpenCL call of a binding, timed: NOCL_CL(clFinish)(q). Only used in
+// the bodies of NAN_METHODs. Helpers that also run on driver and staging
+// threads (completion callbacks...) call the driver directly: a driver may
+// run a callback within a call of a binding, which would then count twice.
+#define NOCL_CL(fn) opencl::timedDriverFunction(&::fn)
+
+#endif // BINDINGSTATS_H_
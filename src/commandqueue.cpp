@@ -1,7 +1,11 @@
 #include <algorithm>
 #include <memory>
-// #include <unordered_map>
+#include <mutex>
+#include <unordered_map>
 #include "commandqueue.h"
+#include "convert.h"
+#include "recorder.h"
+#include "staging.h"
 #include "types.h"
 #include "nanextension.h"
 #include "nan.h"
@@ -15,23 +19,127 @@ namespace opencl {
     NOCL_TO_ARRAY(cl_events, js_events, NoCLEvent);       \
   }
 
+// The event is also needed when the recorder of q samples the command
 #define GET_EVENT_FLAG(n)                                 \
   cl_event event = nullptr;                               \
+  bool returnEvent =                                      \
+    ARG_EXISTS(n) && Nan::To<bool>(info[n]).FromJust();   \
+  CommandRecord record(q->getRaw());                      \
   cl_event* eventPtr =                                    \
-    (ARG_EXISTS(n) && Nan::To<bool>(info[n]).FromJust()) \
-    ? &event : nullptr;
+    (returnEvent || record.sampled()) ? &event : nullptr;
 
+// The recorder keeps the wait list of the commands it samples, for the
+// dependencies between recorded commands
 #define GET_WAIT_LIST_AND_EVENT(n)                        \
   GET_WAIT_LIST(n)                                        \
-  GET_EVENT_FLAG(n+1)
+  GET_EVENT_FLAG(n+1)                                     \
+  if (record.recorded()) {                                \
+    for (NoCLEvent *e : cl_events)                        \
+      record.waitList.push_back(e->getRaw());             \
+  }
 
 #define RETURN_EVENT                                        \
-  if (eventPtr) {                                           \
+  record.finish(event, returnEvent);                        \
+  if (returnEvent) {                                        \
     info.GetReturnValue().Set(NOCL_WRAP(NoCLEvent, event)); \
   } else {                                                  \
     info.GetReturnValue().Set(JS_INT(CL_SUCCESS));          \
   }
 
+// ArrayBuffers handed out by enqueueMapBuffer/enqueueMapImage, keyed by the
+// mapped pointer. The same region can be mapped several times (the driver
+// may return the same pointer), hence the multimap. Unmapping detaches the
+// matching ArrayBuffer so JS cannot touch memory the driver has taken back.
+// Worker threads share the map, each entry belongs to the isolate it was
+// created in. The handles are weak: an ArrayBuffer collected while its
+// region is still mapped just drops its entry.
+struct MappedBuffer {
+  v8::Isolate *isolate;
+  Nan::Persistent<ArrayBuffer> *handle;
+};
+
+static std::mutex mappedBuffersMutex;
+static std::unordered_multimap<void*, MappedBuffer> mappedBuffers;
+
+static void forgetMappedPtr(const Nan::WeakCallbackInfo<Nan::Persistent<ArrayBuffer> > &data) {
+  Nan::Persistent<ArrayBuffer> *p = data.GetParameter();
+  {
+    std::lock_guard<std::mutex> lock(mappedBuffersMutex);
+    for(auto it = mappedBuffers.begin(); it != mappedBuffers.end(); ++it) {
+      if(it->second.handle == p) {
+        mappedBuffers.erase(it);
+        break;
+      }
+    }
+  }
+  p->Reset();
+  delete p;
+}
+
+static Local<ArrayBuffer> wrapMappedPtr(void *ptr, size_t size) {
+  Local<ArrayBuffer> obj = newExternalArrayBuffer(ptr, size);
+  Nan::Persistent<ArrayBuffer> *p = new Nan::Persistent<ArrayBuffer>(obj);
+  p->SetWeak(p, forgetMappedPtr, Nan::WeakCallbackType::kParameter);
+  std::lock_guard<std::mutex> lock(mappedBuffersMutex);
+  mappedBuffers.emplace(ptr, MappedBuffer { v8::Isolate::GetCurrent(), p });
+  return obj;
+}
+
+// Returns the ArrayBuffer behind a mapped ArrayBuffer or one of its views,
+// an empty handle otherwise.
+static Local<ArrayBuffer> mappedArrayBuffer(Local<Value> value) {
+  if(value->IsArrayBuffer())
+    return value.As<ArrayBuffer>();
+  if(value->IsArrayBufferView())
+    return value.As<ArrayBufferView>()->Buffer();
+  return Local<ArrayBuffer>();
+}
+
+static void detachMappedPtr(void *ptr, Local<ArrayBuffer> buf) {
+  if(buf.IsEmpty())
+    return;
+  v8::Isolate *isolate = v8::Isolate::GetCurrent();
+  std::lock_guard<std::mutex> lock(mappedBuffersMutex);
+  auto range = mappedBuffers.equal_range(ptr);
+  for(auto it = range.first; it != range.second; ++it) {
+    if(it->second.isolate != isolate)
+      continue;
+    Nan::Persistent<ArrayBuffer> *p = it->second.handle;
+    if(Nan::New(*p)->StrictEquals(buf)) {
+      detachArrayBuffer(Nan::New(*p));
+      p->Reset();
+      delete p;
+      mappedBuffers.erase(it);
+      return;
+    }
+  }
+}
+
+// Drops the entries of an isolate whose environment is going away
+static void releaseMappedBuffers(void *arg) {
+  v8::Isolate *isolate = static_cast<v8::Isolate*>(arg);
+  std::lock_guard<std::mutex> lock(mappedBuffersMutex);
+  for(auto it = mappedBuffers.begin(); it != mappedBuffers.end(); ) {
+    if(it->second.isolate == isolate) {
+      it->second.handle->Reset();
+      delete it->second.handle;
+      it = mappedBuffers.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+// Large transfers from pageable memory go through the pinned staging pool,
+// mapped regions are pinned already.
+static bool useStaging(size_t size, void *ptr) {
+  size_t threshold = stagingThreshold();
+  if(!threshold || size < threshold)
+    return false;
+  std::lock_guard<std::mutex> lock(mappedBuffersMutex);
+  return mappedBuffers.find(ptr) == mappedBuffers.end();
+}
+
 #ifndef CL_VERSION_2_0
 
 // /* Command Queue APIs */
@@ -53,7 +161,7 @@ NAN_METHOD(CreateCommandQueue) {
   cl_command_queue_properties properties = Nan::To<uint32_t>(info[2]).FromJust();
 
   cl_int err;
-  cl_command_queue q = ::clCreateCommandQueue(
+  cl_command_queue q = NOCL_CL(clCreateCommandQueue)(
     context->getRaw(), device->getRaw(), properties, &err);
 
   CHECK_ERR(err)
@@ -107,7 +215,7 @@ NAN_METHOD(CreateCommandQueueWithProperties) {
   cl_properties.push_back(0);
 
   cl_int err;
-  cl_command_queue q = ::clCreateCommandQueueWithProperties(
+  cl_command_queue q = NOCL_CL(clCreateCommandQueueWithProperties)(
     context->getRaw(),
     device->getRaw(),
     cl_properties.data(),
@@ -143,6 +251,8 @@ NAN_METHOD(ReleaseCommandQueue) {
   // Arg 0
   NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
+  if(!q->isReleased())
+    forgetRecorder(q->getRaw());
   cl_int err=q->release();
   CHECK_ERR(err)
   info.GetReturnValue().Set(JS_INT(err));
@@ -166,27 +276,27 @@ NAN_METHOD(GetCommandQueueInfo) {
   switch(param_name) {
     case CL_QUEUE_CONTEXT: {
       cl_context val;
-      CHECK_ERR(::clGetCommandQueueInfo(q->getRaw(),param_name,sizeof(cl_context), &val, nullptr))
-      CHECK_ERR(::clRetainContext(val))
+      CHECK_ERR(NOCL_CL(clGetCommandQueueInfo)(q->getRaw(),param_name,sizeof(cl_context), &val, nullptr))
+      CHECK_ERR(NOCL_CL(clRetainContext)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLContext, val));
       return;
     }
     case CL_QUEUE_DEVICE: {
       cl_device_id val;
-      CHECK_ERR(::clGetCommandQueueInfo(q->getRaw(),param_name,sizeof(cl_device_id), &val, nullptr))
-      CHECK_ERR(::clRetainDevice(val))
+      CHECK_ERR(NOCL_CL(clGetCommandQueueInfo)(q->getRaw(),param_name,sizeof(cl_device_id), &val, nullptr))
+      CHECK_ERR(NOCL_CL(clRetainDevice)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLDeviceId, val));
       return;
     }
     case CL_QUEUE_REFERENCE_COUNT: {
       cl_uint val;
-      CHECK_ERR(::clGetCommandQueueInfo(q->getRaw(),param_name,sizeof(cl_uint), &val, nullptr))
+      CHECK_ERR(NOCL_CL(clGetCommandQueueInfo)(q->getRaw(),param_name,sizeof(cl_uint), &val, nullptr))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_QUEUE_PROPERTIES: {
       cl_command_queue_properties val;
-      CHECK_ERR(::clGetCommandQueueInfo(q->getRaw(),param_name,sizeof(cl_command_queue_properties), &val, nullptr))
+      CHECK_ERR(NOCL_CL(clGetCommandQueueInfo)(q->getRaw(),param_name,sizeof(cl_command_queue_properties), &val, nullptr))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -204,7 +314,7 @@ NAN_METHOD(Flush) {
   // Arg 0
   NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
-  cl_int err = ::clFlush(q->getRaw());
+  cl_int err = NOCL_CL(clFlush)(q->getRaw());
 
   CHECK_ERR(err);
   info.GetReturnValue().Set(JS_INT(err));
@@ -219,7 +329,7 @@ NAN_METHOD(Finish) {
   // Arg 0
   NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
-  cl_int err = ::clFinish(q->getRaw());
+  cl_int err = NOCL_CL(clFinish)(q->getRaw());
 
   CHECK_ERR(err);
   info.GetReturnValue().Set(JS_INT(err));
@@ -247,15 +357,30 @@ NAN_METHOD(EnqueueReadBuffer) {
   NOCL_UNWRAP(buffer, NoCLMem, info[1]);
 
   cl_bool blocking_read = Nan::To<bool>(info[2]).FromJust();
-  size_t offset = Nan::To<uint32_t>(info[3]).FromJust();
-  size_t size = Nan::To<uint32_t>(info[4]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[3]);
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[4]);
+
+  // JS Array, filled with elements of the type given after the event flag.
+  // Always blocking, blocking_read is ignored.
+  if(info[5]->IsArray() && ARG_EXISTS(8)) {
+    GET_WAIT_LIST_AND_EVENT(6)
+    record.bytes = size;
+    Nan::Utf8String type(info[8]);
+    CHECK_ERR(enqueueReadArray(
+      q->getRaw(),buffer->getRaw(),offset,size,Local<Array>::Cast(info[5]),*type,
+      NoCLEvent::toCLArray(cl_events), eventPtr));
+    RETURN_EVENT
+    return;
+  }
 
   void *ptr=nullptr;
+  size_t len=0;
   if(info[5]->IsUndefined() || info[5]->IsNull()) {
     CHECK_ERR(CL_INVALID_VALUE);
   }
   else {
-    size_t len=0;
     getPtrAndLen(info[5],ptr,len);
     // std::cout<<"[EnqueueReadBuffer] ptr 0x"<<std::hex<<ptr<<std::dec<<std::endl;
 
@@ -264,8 +389,21 @@ NAN_METHOD(EnqueueReadBuffer) {
   }
 
   GET_WAIT_LIST_AND_EVENT(6)
+  record.bytes = size;
+
+  if(useStaging(size, ptr)) {
+    if(size > len)
+      THROW_ERR(CL_INVALID_VALUE);
+    // recorded as a read, its event being a marker
+    record.command = CL_COMMAND_READ_BUFFER;
+    CHECK_ERR(enqueueStagedRead(
+      q->getRaw(),buffer->getRaw(),blocking_read,offset,size,ptr,info[5],
+      NoCLEvent::toCLArray(cl_events), eventPtr));
+    RETURN_EVENT
+    return;
+  }
 
-  CHECK_ERR(::clEnqueueReadBuffer(
+  CHECK_ERR(NOCL_CL(clEnqueueReadBuffer)(
     q->getRaw(),buffer->getRaw(),blocking_read,offset,size,ptr,
     (cl_uint) cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -307,18 +445,22 @@ NAN_METHOD(EnqueueReadBufferRect) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      buffer_offset[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(buffer_offset[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      host_offset[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(host_offset[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
-  size_t buffer_row_pitch = Nan::To<uint32_t>(info[6]).FromJust();
-  size_t buffer_slice_pitch = Nan::To<uint32_t>(info[7]).FromJust();
-  size_t host_row_pitch = Nan::To<uint32_t>(info[8]).FromJust();
-  size_t host_slice_pitch = Nan::To<uint32_t>(info[9]).FromJust();
+  size_t buffer_row_pitch;
+  NOCL_TO_SIZE_T(buffer_row_pitch, info[6]);
+  size_t buffer_slice_pitch;
+  NOCL_TO_SIZE_T(buffer_slice_pitch, info[7]);
+  size_t host_row_pitch;
+  NOCL_TO_SIZE_T(host_row_pitch, info[8]);
+  size_t host_slice_pitch;
+  NOCL_TO_SIZE_T(host_slice_pitch, info[9]);
 
   void *ptr=nullptr;
   size_t len=0;
@@ -333,8 +475,9 @@ NAN_METHOD(EnqueueReadBufferRect) {
   }
 
   GET_WAIT_LIST_AND_EVENT(11)
+  record.bytes = region[0] * region[1] * region[2];
 
-  CHECK_ERR(::clEnqueueReadBufferRect(
+  CHECK_ERR(NOCL_CL(clEnqueueReadBufferRect)(
     q->getRaw(),buffer->getRaw(),blocking_read,buffer_offset,host_offset,region,
     buffer_row_pitch,buffer_slice_pitch,host_row_pitch,host_slice_pitch,ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -364,15 +507,29 @@ NAN_METHOD(EnqueueWriteBuffer) {
   NOCL_UNWRAP(buffer, NoCLMem, info[1]);
 
   cl_bool blocking_write = Nan::To<bool>(info[2]).FromJust();
-  size_t offset = Nan::To<uint32_t>(info[3]).FromJust();
-  size_t size = Nan::To<uint32_t>(info[4]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[3]);
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[4]);
+
+  // JS Array, converted to the element type given after the event flag
+  if(info[5]->IsArray() && ARG_EXISTS(8)) {
+    GET_WAIT_LIST_AND_EVENT(6)
+    record.bytes = size;
+    Nan::Utf8String type(info[8]);
+    CHECK_ERR(enqueueWriteArray(
+      q->getRaw(),buffer->getRaw(),blocking_write,offset,size,Local<Array>::Cast(info[5]),*type,
+      NoCLEvent::toCLArray(cl_events), eventPtr));
+    RETURN_EVENT
+    return;
+  }
 
   void *ptr=nullptr;
+  size_t len=0;
   if(info[5]->IsUndefined() || info[5]->IsNull()) {
     CHECK_ERR(CL_INVALID_VALUE);
   }
   else {
-    size_t len=0;
     getPtrAndLen(info[5],ptr,len);
 
     if(!ptr || !len)
@@ -380,8 +537,21 @@ NAN_METHOD(EnqueueWriteBuffer) {
   }
 
   GET_WAIT_LIST_AND_EVENT(6)
+  record.bytes = size;
+
+  if(useStaging(size, ptr)) {
+    if(size > len)
+      THROW_ERR(CL_INVALID_VALUE);
+    // recorded as a write, its event being a marker
+    record.command = CL_COMMAND_WRITE_BUFFER;
+    CHECK_ERR(enqueueStagedWrite(
+      q->getRaw(),buffer->getRaw(),blocking_write,offset,size,ptr,info[5],
+      NoCLEvent::toCLArray(cl_events), eventPtr));
+    RETURN_EVENT
+    return;
+  }
 
-  CHECK_ERR(::clEnqueueWriteBuffer(
+  CHECK_ERR(NOCL_CL(clEnqueueWriteBuffer)(
     q->getRaw(),buffer->getRaw(),blocking_write,offset,size,ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -423,18 +593,22 @@ NAN_METHOD(EnqueueWriteBufferRect) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      buffer_offset[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(buffer_offset[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      host_offset[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(host_offset[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
-  size_t buffer_row_pitch = Nan::To<uint32_t>(info[6]).FromJust();
-  size_t buffer_slice_pitch = Nan::To<uint32_t>(info[7]).FromJust();
-  size_t host_row_pitch = Nan::To<uint32_t>(info[8]).FromJust();
-  size_t host_slice_pitch = Nan::To<uint32_t>(info[9]).FromJust();
+  size_t buffer_row_pitch;
+  NOCL_TO_SIZE_T(buffer_row_pitch, info[6]);
+  size_t buffer_slice_pitch;
+  NOCL_TO_SIZE_T(buffer_slice_pitch, info[7]);
+  size_t host_row_pitch;
+  NOCL_TO_SIZE_T(host_row_pitch, info[8]);
+  size_t host_slice_pitch;
+  NOCL_TO_SIZE_T(host_slice_pitch, info[9]);
 
   void *ptr=nullptr;
   size_t len=0;
@@ -448,8 +622,9 @@ NAN_METHOD(EnqueueWriteBufferRect) {
   }
 
   GET_WAIT_LIST_AND_EVENT(11)
+  record.bytes = region[0] * region[1] * region[2];
 
-  CHECK_ERR(::clEnqueueWriteBufferRect(
+  CHECK_ERR(NOCL_CL(clEnqueueWriteBufferRect)(
     q->getRaw(),buffer->getRaw(),blocking_write,buffer_offset,host_offset,region,
     buffer_row_pitch,buffer_slice_pitch,host_row_pitch,host_slice_pitch,ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -458,6 +633,222 @@ NAN_METHOD(EnqueueWriteBufferRect) {
   RETURN_EVENT
 }
 
+// One contiguous piece of a scatter/gather transfer
+struct TransferRegion {
+  size_t device;
+  size_t host;
+  size_t size;
+};
+
+// A run of regions of the same size at constant device and host strides,
+// transferred with a single rect command
+struct TransferRun {
+  size_t first;
+  size_t count;
+};
+
+// Reads the (deviceOffset, hostOffset, length) triples of a typed array or of
+// a JS Array of numbers
+static bool getRegions(Local<Value> value, std::vector<TransferRegion> &regions) {
+  if(!value->IsArray() && !value->IsTypedArray())
+    return false;
+
+  size_t n = value->IsArray() ? value.As<Array>()->Length() : value.As<TypedArray>()->Length();
+  if(n % 3)
+    return false;
+  regions.resize(n / 3);
+
+  void *ptr = nullptr;
+  size_t len = 0;
+  if(value->IsUint32Array() || value->IsFloat64Array()
+#ifdef NOCL_HAS_BIGINT
+     || value->IsBigUint64Array()
+#endif
+    )
+    getPtrAndLen(value, ptr, len);
+
+  for(size_t i = 0; i < n; i++) {
+    size_t v;
+    if(!ptr) {
+      if(!toSizeT(Nan::Get(value.As<Object>(), (uint32_t) i).ToLocalChecked(), v))
+        return false;
+    }
+    else if(value->IsUint32Array())
+      v = static_cast<uint32_t*>(ptr)[i];
+    else if(value->IsFloat64Array()) {
+      if(!toSizeT(static_cast<double*>(ptr)[i], v))
+        return false;
+    }
+    else
+      v = static_cast<size_t>(static_cast<uint64_t*>(ptr)[i]);
+    size_t *field = i % 3 == 0 ? &regions[i / 3].device :
+                    i % 3 == 1 ? &regions[i / 3].host : &regions[i / 3].size;
+    *field = v;
+  }
+  return true;
+}
+
+// Sorts the regions by device offset, merges the ones that follow each other
+// on both sides and drops empty ones.
+static void coalesceRegions(std::vector<TransferRegion> &regions) {
+  std::stable_sort(regions.begin(), regions.end(),
+    [](const TransferRegion &a, const TransferRegion &b) { return a.device < b.device; });
+  size_t n = 0;
+  for(const TransferRegion &r : regions) {
+    if(!r.size)
+      continue;
+    if(n && regions[n - 1].device + regions[n - 1].size == r.device &&
+       regions[n - 1].host + regions[n - 1].size == r.host)
+      regions[n - 1].size += r.size;
+    else
+      regions[n++] = r;
+  }
+  regions.resize(n);
+}
+
+// Splits the regions into runs. Runs of 3 regions or more (an individual
+// transfer is cheaper below that) go through a rect command.
+static std::vector<TransferRun> findRuns(const std::vector<TransferRegion> &regions) {
+  std::vector<TransferRun> runs;
+  size_t i = 0;
+  while(i < regions.size()) {
+    size_t j = i + 1;
+    if(j < regions.size() && regions[j].size == regions[i].size && regions[j].host > regions[i].host) {
+      size_t dstride = regions[j].device - regions[i].device;
+      size_t hstride = regions[j].host - regions[i].host;
+      if(dstride >= regions[i].size && hstride >= regions[i].size) {
+        while(j + 1 < regions.size() && regions[j + 1].size == regions[i].size &&
+              regions[j + 1].device - regions[j].device == dstride &&
+              regions[j + 1].host > regions[j].host &&
+              regions[j + 1].host - regions[j].host == hstride)
+          j++;
+        j++;
+      }
+    }
+    if(j - i < 3) {
+      runs.push_back({i, 1});
+      i++;
+    }
+    else {
+      runs.push_back({i, j - i});
+      i = j;
+    }
+  }
+  return runs;
+}
+
+static void enqueueBufferRegions(const Nan::FunctionCallbackInfo<v8::Value> &info, bool write) {
+  Nan::HandleScope scope;
+  REQ_ARGS(5);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  // Arg 1
+  NOCL_UNWRAP(buffer, NoCLMem, info[1]);
+
+  cl_bool blocking = Nan::To<bool>(info[2]).FromJust();
+
+  std::vector<TransferRegion> regions;
+  if(!getRegions(info[3], regions))
+    return Nan::ThrowTypeError("Regions must be an array of (deviceOffset, hostOffset, length) triples");
+
+  void *ptr=nullptr;
+  size_t len=0;
+  getPtrAndLen(info[4],ptr,len);
+  if(!ptr || !len)
+    return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
+
+  for(const TransferRegion &r : regions) {
+    if(r.host + r.size > len || r.host + r.size < r.host)
+      THROW_ERR(CL_INVALID_VALUE);
+  }
+
+  GET_WAIT_LIST_AND_EVENT(5)
+  for(const TransferRegion &r : regions)
+    record.bytes += r.size;
+  std::vector<cl_event> wait_list = NoCLEvent::toCLArray(cl_events);
+
+  coalesceRegions(regions);
+  std::vector<TransferRun> runs = findRuns(regions);
+
+  std::vector<cl_event> events(runs.size(), nullptr);
+  cl_int ret = CL_SUCCESS;
+  size_t done = 0;
+  for(; done < runs.size() && ret == CL_SUCCESS; done++) {
+    const TransferRegion &r = regions[runs[done].first];
+    char *host = static_cast<char*>(ptr);
+    if(runs[done].count == 1) {
+      ret = write ?
+        NOCL_CL(clEnqueueWriteBuffer)(q->getRaw(), buffer->getRaw(), CL_FALSE, r.device, r.size,
+          host + r.host, (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr,
+          &events[done]) :
+        NOCL_CL(clEnqueueReadBuffer)(q->getRaw(), buffer->getRaw(), CL_FALSE, r.device, r.size,
+          host + r.host, (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr,
+          &events[done]);
+      continue;
+    }
+
+    const TransferRegion &next = regions[runs[done].first + 1];
+    size_t dpitch = next.device - r.device;
+    size_t hpitch = next.host - r.host;
+    size_t buffer_origin[] = { r.device % dpitch, r.device / dpitch, 0 };
+    size_t host_origin[] = { r.host % hpitch, r.host / hpitch, 0 };
+    size_t region[] = { r.size, runs[done].count, 1 };
+    ret = write ?
+      NOCL_CL(clEnqueueWriteBufferRect)(q->getRaw(), buffer->getRaw(), CL_FALSE, buffer_origin,
+        host_origin, region, dpitch, 0, hpitch, 0, ptr,
+        (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, &events[done]) :
+      NOCL_CL(clEnqueueReadBufferRect)(q->getRaw(), buffer->getRaw(), CL_FALSE, buffer_origin,
+        host_origin, region, dpitch, 0, hpitch, 0, ptr,
+        (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, &events[done]);
+  }
+  if(ret != CL_SUCCESS)
+    done--;
+
+  // a single event for the whole transfer
+  if(ret == CL_SUCCESS && eventPtr) {
+    if(done == 1) {
+      event = events[0];
+      events[0] = nullptr;
+    }
+    else {
+#ifdef CL_VERSION_1_2
+      // with no region left the event still follows the wait list
+      const std::vector<cl_event> &deps = done ? events : wait_list;
+      ret = NOCL_CL(clEnqueueMarkerWithWaitList)(q->getRaw(), (cl_uint) deps.size(),
+        deps.size() ? deps.data() : nullptr, &event);
+#else
+      ret = NOCL_CL(clEnqueueMarker)(q->getRaw(), &event);
+#endif
+    }
+  }
+
+  if(blocking || ret != CL_SUCCESS) {
+    if(done)
+      NOCL_CL(clWaitForEvents)((cl_uint) done, events.data());
+  }
+  for(size_t i = 0; i < done; i++) {
+    if(events[i])
+      NOCL_CL(clReleaseEvent)(events[i]);
+  }
+  CHECK_ERR(ret);
+
+  RETURN_EVENT
+}
+
+// enqueueReadBufferRegions(command_queue, buffer, blocking_read, regions, ptr,
+//                          event_wait_list, event)
+NAN_METHOD(EnqueueReadBufferRegions) {
+  enqueueBufferRegions(info, false);
+}
+
+// enqueueWriteBufferRegions(command_queue, buffer, blocking_write, regions, ptr,
+//                           event_wait_list, event)
+NAN_METHOD(EnqueueWriteBufferRegions) {
+  enqueueBufferRegions(info, true);
+}
+
 #ifdef CL_VERSION_1_2
 // extern CL_API_ENTRY cl_int CL_API_CALL
 // clEnqueueFillBuffer(cl_command_queue   /* command_queue */,
@@ -501,12 +892,15 @@ NAN_METHOD(EnqueueFillBuffer) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
-  size_t offset=Nan::To<uint32_t>(info[3]).FromJust();
-  size_t size=Nan::To<uint32_t>(info[4]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[3]);
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[4]);
 
   GET_WAIT_LIST_AND_EVENT(5)
+  record.bytes = size;
 
-  CHECK_ERR(::clEnqueueFillBuffer(
+  CHECK_ERR(NOCL_CL(clEnqueueFillBuffer)(
     q->getRaw(), buffer->getRaw(), pattern, len, offset, size,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -538,13 +932,17 @@ NAN_METHOD(EnqueueCopyBuffer) {
   NOCL_UNWRAP(dst_buffer, NoCLMem, info[2]);
 
 
-  size_t src_offset=Nan::To<uint32_t>(info[3]).FromJust();
-  size_t dst_offset=Nan::To<uint32_t>(info[4]).FromJust();
-  size_t size=Nan::To<uint32_t>(info[5]).FromJust();
+  size_t src_offset;
+  NOCL_TO_SIZE_T(src_offset, info[3]);
+  size_t dst_offset;
+  NOCL_TO_SIZE_T(dst_offset, info[4]);
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[5]);
 
   GET_WAIT_LIST_AND_EVENT(6)
+  record.bytes = size;
 
-  CHECK_ERR(::clEnqueueCopyBuffer(q->getRaw(),
+  CHECK_ERR(NOCL_CL(clEnqueueCopyBuffer)(q->getRaw(),
     src_buffer->getRaw(),dst_buffer->getRaw(),src_offset,dst_offset, size,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -585,21 +983,26 @@ NAN_METHOD(EnqueueCopyBufferRect) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      src_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(src_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      dst_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(dst_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
-  size_t src_row_pitch = Nan::To<uint32_t>(info[6]).FromJust();
-  size_t src_slice_pitch = Nan::To<uint32_t>(info[7]).FromJust();
-  size_t dst_row_pitch = Nan::To<uint32_t>(info[8]).FromJust();
-  size_t dst_slice_pitch = Nan::To<uint32_t>(info[9]).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
+  size_t src_row_pitch;
+  NOCL_TO_SIZE_T(src_row_pitch, info[6]);
+  size_t src_slice_pitch;
+  NOCL_TO_SIZE_T(src_slice_pitch, info[7]);
+  size_t dst_row_pitch;
+  NOCL_TO_SIZE_T(dst_row_pitch, info[8]);
+  size_t dst_slice_pitch;
+  NOCL_TO_SIZE_T(dst_slice_pitch, info[9]);
 
   GET_WAIT_LIST_AND_EVENT(10)
+  record.bytes = region[0] * region[1] * region[2];
 
-  CHECK_ERR(::clEnqueueCopyBufferRect(
+  CHECK_ERR(NOCL_CL(clEnqueueCopyBufferRect)(
     q->getRaw(),src_buffer->getRaw(),dst_buffer->getRaw(),
     src_origin, dst_origin, region,
     src_row_pitch, src_slice_pitch, dst_row_pitch, dst_slice_pitch,
@@ -638,13 +1041,15 @@ NAN_METHOD(EnqueueReadImage) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
-  size_t row_pitch = Nan::To<uint32_t>(info[5]).FromJust();
-  size_t slice_pitch = Nan::To<uint32_t>(info[6]).FromJust();
+  size_t row_pitch;
+  NOCL_TO_SIZE_T(row_pitch, info[5]);
+  size_t slice_pitch;
+  NOCL_TO_SIZE_T(slice_pitch, info[6]);
 
   void *ptr=nullptr;
   size_t len=0;
@@ -660,7 +1065,7 @@ NAN_METHOD(EnqueueReadImage) {
 
   GET_WAIT_LIST_AND_EVENT(8)
 
-  CHECK_ERR(::clEnqueueReadImage(q->getRaw(),image->getRaw(),blocking_read,
+  CHECK_ERR(NOCL_CL(clEnqueueReadImage)(q->getRaw(),image->getRaw(),blocking_read,
     origin,region,row_pitch,slice_pitch, ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -698,13 +1103,15 @@ NAN_METHOD(EnqueueWriteImage) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
-  size_t row_pitch = Nan::To<uint32_t>(info[5]).FromJust();
-  size_t slice_pitch = Nan::To<uint32_t>(info[6]).FromJust();
+  size_t row_pitch;
+  NOCL_TO_SIZE_T(row_pitch, info[5]);
+  size_t slice_pitch;
+  NOCL_TO_SIZE_T(slice_pitch, info[6]);
 
   void *ptr=nullptr;
   size_t len=0;
@@ -719,7 +1126,7 @@ NAN_METHOD(EnqueueWriteImage) {
 
   GET_WAIT_LIST_AND_EVENT(8)
 
-  CHECK_ERR(::clEnqueueWriteImage(q->getRaw(),image->getRaw(),blocking_write,
+  CHECK_ERR(NOCL_CL(clEnqueueWriteImage)(q->getRaw(),image->getRaw(),blocking_write,
     origin,region,row_pitch,slice_pitch, ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -761,14 +1168,14 @@ NAN_METHOD(EnqueueFillImage) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
   GET_WAIT_LIST_AND_EVENT(5)
 
-  CHECK_ERR(::clEnqueueFillImage(
+  CHECK_ERR(NOCL_CL(clEnqueueFillImage)(
     q->getRaw(),image->getRaw(),fill_color,
     origin,region,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -806,17 +1213,17 @@ NAN_METHOD(EnqueueCopyImage) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      src_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(src_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      dst_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(dst_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
   GET_WAIT_LIST_AND_EVENT(6)
 
-  CHECK_ERR(::clEnqueueCopyImage(
+  CHECK_ERR(NOCL_CL(clEnqueueCopyImage)(
     q->getRaw(),src_image->getRaw(),dst_image->getRaw(),
     src_origin,dst_origin, region,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -853,16 +1260,17 @@ NAN_METHOD(EnqueueCopyImageToBuffer) {
   Local<Array> arr= Local<Array>::Cast(info[3]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-      src_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(src_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[4]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
-  size_t dst_offset = Nan::To<uint32_t>(info[5]).FromJust();
+  size_t dst_offset;
+  NOCL_TO_SIZE_T(dst_offset, info[5]);
 
   GET_WAIT_LIST_AND_EVENT(6)
 
-  CHECK_ERR(::clEnqueueCopyImageToBuffer(
+  CHECK_ERR(NOCL_CL(clEnqueueCopyImageToBuffer)(
     q->getRaw(),src_image->getRaw(),dst_buffer->getRaw(),
     src_origin, region, dst_offset,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -894,7 +1302,8 @@ NAN_METHOD(EnqueueCopyBufferToImage) {
   // Arg 2
   NOCL_UNWRAP(dst_image, NoCLMem, info[2]);
 
-  size_t src_offset = Nan::To<uint32_t>(info[3]).FromJust();
+  size_t src_offset;
+  NOCL_TO_SIZE_T(src_offset, info[3]);
 
   size_t dst_origin[]={0,0,0};
   size_t region[]={1,1,1};
@@ -902,14 +1311,14 @@ NAN_METHOD(EnqueueCopyBufferToImage) {
   uint32_t i;
 
   for(i=0;i<max(arr->Length(),2u);i++)
-      dst_origin[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(dst_origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-      region[i]=Nan::To<uint32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
   GET_WAIT_LIST_AND_EVENT(6)
 
-  CHECK_ERR(::clEnqueueCopyBufferToImage(
+  CHECK_ERR(NOCL_CL(clEnqueueCopyBufferToImage)(
     q->getRaw(),src_buffer->getRaw(),dst_image->getRaw(),
     src_offset, dst_origin, region,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -918,15 +1327,6 @@ NAN_METHOD(EnqueueCopyBufferToImage) {
   RETURN_EVENT
 }
 
-// static std::unordered_map<void*,int> mapPointers;
-
-void CL_CALLBACK notifyMapCB (cl_event event, cl_int event_command_exec_status, void *user_data)
-{
-  // NoCLMapCB* asyncCB = static_cast<NoCLMapCB*>(user_data);
-  // if(asyncCB!=nullptr)
-  //     asyncCB->CallBackIsDone();
-}
-
 // extern CL_API_ENTRY void * CL_API_CALL
 // clEnqueueMapBuffer(cl_command_queue /* command_queue */,
 //                    cl_mem           /* buffer */,
@@ -943,22 +1343,25 @@ NAN_METHOD(EnqueueMapBuffer) {
   REQ_ARGS(6);
 
   // Arg 0
-  NOCL_UNWRAP(cq, NoCLCommandQueue, info[0]);
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
   // Arg 1
   NOCL_UNWRAP(mem, NoCLMem, info[1]);
 
   cl_bool blocking_map = Nan::To<bool>(info[2]).FromJust() ? CL_TRUE : CL_FALSE;
   cl_map_flags map_flags = Nan::To<uint32_t>(info[3]).FromJust();
-  size_t offset = Nan::To<uint32_t>(info[4]).FromJust();
-  size_t size = Nan::To<uint32_t>(info[5]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[4]);
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[5]);
 
   GET_WAIT_LIST_AND_EVENT(6)
+  record.bytes = size;
 
   void* mPtr = nullptr;
   cl_int err;
 
-  mPtr = clEnqueueMapBuffer(cq->getRaw(),mem->getRaw(),
+  mPtr = NOCL_CL(clEnqueueMapBuffer)(q->getRaw(),mem->getRaw(),
                             blocking_map,map_flags, offset,
                             size, (cl_uint)cl_events.size(),
                             NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -966,18 +1369,15 @@ NAN_METHOD(EnqueueMapBuffer) {
 
   CHECK_ERR(err)
 
-  Local<v8::ArrayBuffer> obj = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), mPtr, size);
+  // With a non-blocking map the content is only valid once the map event
+  // completes, see cl.mapAsync.
+  Local<v8::ArrayBuffer> obj = wrapMappedPtr(mPtr, size);
 
-  if(eventPtr) {
+  record.finish(event, returnEvent);
+  if(returnEvent) {
     Nan::Set(obj, JS_STR("event"), NOCL_WRAP(NoCLEvent,event));
   }
 
-  if(!blocking_map) {
-    // TODO? buf->SetIndexedPropertiesToExternalArrayData(NULL, buf->GetIndexedPropertiesExternalArrayDataType(), 0);
-    // NoCLMapCB* cb = new NoCLMapCB(buf,size,mPtr);
-    // err = clSetEventCallback(event,CL_COMPLETE,notifyMapCB,cb);
-    // CHECK_ERR(err)
-  }
   info.GetReturnValue().Set(scope.Escape(obj));
 }
 
@@ -999,7 +1399,7 @@ NAN_METHOD(EnqueueMapImage) {
   REQ_ARGS(6);
 
   // Arg 0
-  NOCL_UNWRAP(cq, NoCLCommandQueue, info[0]);
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
   // Arg 1
   NOCL_UNWRAP(mem, NoCLMem, info[1]);
@@ -1011,10 +1411,10 @@ NAN_METHOD(EnqueueMapImage) {
   Local<Array> arr= Local<Array>::Cast(info[4]);
   uint32_t i;
   for(i=0;i<max(arr->Length(),2u);i++)
-    origin[i]=Nan::To<int32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+    NOCL_TO_SIZE_T(origin[i], Nan::Get(arr, i).ToLocalChecked());
   arr= Local<Array>::Cast(info[5]);
   for(i=0;i<max(arr->Length(),2u);i++)
-    region[i]=Nan::To<int32_t>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+    NOCL_TO_SIZE_T(region[i], Nan::Get(arr, i).ToLocalChecked());
 
   size_t image_row_pitch;
   size_t image_slice_pitch;
@@ -1024,7 +1424,7 @@ NAN_METHOD(EnqueueMapImage) {
   void* mPtr = nullptr;
   cl_int err;
 
-  mPtr = clEnqueueMapImage (cq->getRaw(),mem->getRaw(),
+  mPtr = NOCL_CL(clEnqueueMapImage)(q->getRaw(),mem->getRaw(),
                               blocking_map,map_flags, origin,
                               region,
                               &image_row_pitch, &image_slice_pitch,
@@ -1039,21 +1439,16 @@ NAN_METHOD(EnqueueMapImage) {
   if (image_slice_pitch) {
     size = image_slice_pitch * region[2];
   }
-  Local<v8::ArrayBuffer> obj = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), mPtr, size);
+  Local<v8::ArrayBuffer> obj = wrapMappedPtr(mPtr, size);
 
-  Nan::Set(obj, JS_STR("image_row_pitch"), Nan::New(static_cast<int>(image_row_pitch)));
-  Nan::Set(obj, JS_STR("image_slice_pitch"), Nan::New(static_cast<int>(image_slice_pitch)));
+  Nan::Set(obj, JS_STR("image_row_pitch"), JS_SIZE(image_row_pitch));
+  Nan::Set(obj, JS_STR("image_slice_pitch"), JS_SIZE(image_slice_pitch));
 
-  if(eventPtr) {
+  record.finish(event, returnEvent);
+  if(returnEvent) {
     Nan::Set(obj, JS_STR("event"), NOCL_WRAP(NoCLEvent,event));
   }
 
-  if(!blocking_map) {
-    //TODO? buf->SetIndexedPropertiesToExternalArrayData(NULL, buf->GetIndexedPropertiesExternalArrayDataType(), 0);
-    // NoCLMapCB* cb = new NoCLMapCB(buf,size,mPtr);
-    // err = clSetEventCallback(event,CL_COMPLETE,notifyMapCB,cb);
-    // CHECK_ERR(err)
-  }
   info.GetReturnValue().Set(obj);
 //
 //  cl_event event=nullptr;
@@ -1093,6 +1488,13 @@ NAN_METHOD(EnqueueUnmapMemObject) {
   if(info[2]->IsUndefined() || info[2]->IsNull()) {
     THROW_ERR(CL_INVALID_VALUE);
   }
+
+  // Views of a mapped region are unmapped through their ArrayBuffer, so the
+  // pointer handed to the driver is the one it returned from the map call.
+  Local<ArrayBuffer> buf = mappedArrayBuffer(info[2]);
+  if(!buf.IsEmpty()) {
+    getPtrAndLen(buf, ptr, len);
+  }
   else {
     getPtrAndLen(info[2], ptr, len);
   }
@@ -1103,10 +1505,12 @@ NAN_METHOD(EnqueueUnmapMemObject) {
   GET_WAIT_LIST_AND_EVENT(3)
 
   cl_int err;
-  err = clEnqueueUnmapMemObject(q->getRaw(),mem->getRaw(),ptr,
+  err = NOCL_CL(clEnqueueUnmapMemObject)(q->getRaw(),mem->getRaw(),ptr,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent), eventPtr);
   CHECK_ERR(err)
 
+  detachMappedPtr(ptr, buf);
+
   RETURN_EVENT
  }
 
@@ -1145,7 +1549,7 @@ NAN_METHOD(EnqueueMigrateMemObjects) {
 
   GET_WAIT_LIST_AND_EVENT(3)
 
-  CHECK_ERR(::clEnqueueMigrateMemObjects(
+  CHECK_ERR(NOCL_CL(clEnqueueMigrateMemObjects)(
     q->getRaw(),num_mem_objects,
     mem_objects.get(),flags,
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
@@ -1189,8 +1593,9 @@ NAN_METHOD(EnqueueNDRangeKernel) {
       THROW_ERR(CL_INVALID_GLOBAL_OFFSET);
     }
 
+    cl_work_offset.resize(work_dim);
     for (unsigned int i = 0; i < work_dim; ++ i) {
-      cl_work_offset.push_back(Nan::To<uint32_t>(Nan::Get(js_work_offset, i).ToLocalChecked()).FromJust());
+      NOCL_TO_SIZE_T(cl_work_offset[i], Nan::Get(js_work_offset, i).ToLocalChecked());
     }
   }
 
@@ -1201,8 +1606,9 @@ NAN_METHOD(EnqueueNDRangeKernel) {
       THROW_ERR(CL_INVALID_GLOBAL_WORK_SIZE);
     }
 
+    cl_work_global.resize(work_dim);
     for (unsigned int i = 0; i < work_dim; ++ i) {
-      cl_work_global.push_back(Nan::To<uint32_t>(Nan::Get(js_work_global, i).ToLocalChecked()).FromJust());
+      NOCL_TO_SIZE_T(cl_work_global[i], Nan::Get(js_work_global, i).ToLocalChecked());
     }
   }
 
@@ -1214,14 +1620,16 @@ NAN_METHOD(EnqueueNDRangeKernel) {
       THROW_ERR(CL_INVALID_WORK_GROUP_SIZE);
     }
 
+    cl_work_local.resize(work_dim);
     for (unsigned int i = 0; i < work_dim; ++ i) {
-      cl_work_local.push_back(Nan::To<uint32_t>(Nan::Get(js_work_local, i).ToLocalChecked()).FromJust());
+      NOCL_TO_SIZE_T(cl_work_local[i], Nan::Get(js_work_local, i).ToLocalChecked());
     }
   }
 
   GET_WAIT_LIST_AND_EVENT(6)
+  record.kernel = k->getRaw();
 
-  CHECK_ERR(::clEnqueueNDRangeKernel(
+  CHECK_ERR(NOCL_CL(clEnqueueNDRangeKernel)(
     q->getRaw(),
     k->getRaw(),
     work_dim,
@@ -1254,8 +1662,9 @@ NAN_METHOD(EnqueueTask) {
 
 
   GET_WAIT_LIST_AND_EVENT(2)
+  record.kernel = k->getRaw();
 
-  CHECK_ERR(::clEnqueueTask(
+  CHECK_ERR(NOCL_CL(clEnqueueTask)(
     q->getRaw(),k->getRaw(),
     cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent),
     eventPtr));
@@ -1302,7 +1711,7 @@ NAN_METHOD(EnqueueMarkerWithWaitList) {
 
   GET_WAIT_LIST_AND_EVENT(1)
 
-  CHECK_ERR(::clEnqueueMarkerWithWaitList(
+  CHECK_ERR(NOCL_CL(clEnqueueMarkerWithWaitList)(
     q->getRaw(),
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent), eventPtr));
 
@@ -1323,7 +1732,7 @@ NAN_METHOD(EnqueueBarrierWithWaitList) {
 
   GET_WAIT_LIST_AND_EVENT(1)
 
-  CHECK_ERR(::clEnqueueBarrierWithWaitList(
+  CHECK_ERR(NOCL_CL(clEnqueueBarrierWithWaitList)(
     q->getRaw(),
     (cl_uint)cl_events.size(), NOCL_TO_CL_ARRAY(cl_events, NoCLEvent), eventPtr));
 
@@ -1344,7 +1753,7 @@ NAN_METHOD(EnqueueMarker) {
 
   GET_EVENT_FLAG(1)
 
-  CHECK_ERR(::clEnqueueMarker(q->getRaw(), eventPtr));
+  CHECK_ERR(NOCL_CL(clEnqueueMarker)(q->getRaw(), eventPtr));
 
   RETURN_EVENT
 }
@@ -1362,7 +1771,7 @@ NAN_METHOD(EnqueueWaitForEvents) {
 
   GET_WAIT_LIST(1)
 
-  CHECK_ERR(::clEnqueueWaitForEvents(q->getRaw(),
+  CHECK_ERR(NOCL_CL(clEnqueueWaitForEvents)(q->getRaw(),
         cl_events.size(),cl_events.size() ?  events.data(): nullptr));
 
 
@@ -1378,7 +1787,7 @@ NAN_METHOD(EnqueueBarrier) {
   // Arg 0
   NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
 
-  CHECK_ERR(::clEnqueueBarrier(q->getRaw()));
+  CHECK_ERR(NOCL_CL(clEnqueueBarrier)(q->getRaw()));
 
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 }
@@ -1454,45 +1863,49 @@ NAN_METHOD(EnqueueBarrier) {
 namespace CommandQueue {
 NAN_MODULE_INIT(init)
 {
+  addCleanupHook(releaseMappedBuffers, v8::Isolate::GetCurrent());
+
 #ifndef CL_VERSION_2_0
-  Nan::SetMethod(target, "createCommandQueue", CreateCommandQueue);
+  NOCL_SET_METHOD(target, "createCommandQueue", CreateCommandQueue);
 #else
-  Nan::SetMethod(target, "createCommandQueueWithProperties", CreateCommandQueueWithProperties);
+  NOCL_SET_METHOD(target, "createCommandQueueWithProperties", CreateCommandQueueWithProperties);
 #endif
-  Nan::SetMethod(target, "retainCommandQueue", RetainCommandQueue);
-  Nan::SetMethod(target, "releaseCommandQueue", ReleaseCommandQueue);
-  Nan::SetMethod(target, "getCommandQueueInfo", GetCommandQueueInfo);
-  Nan::SetMethod(target, "flush", Flush);
-  Nan::SetMethod(target, "finish", Finish);
-  Nan::SetMethod(target, "enqueueReadBuffer", EnqueueReadBuffer);
-  Nan::SetMethod(target, "enqueueReadBufferRect", EnqueueReadBufferRect);
-  Nan::SetMethod(target, "enqueueWriteBuffer", EnqueueWriteBuffer);
-  Nan::SetMethod(target, "enqueueWriteBufferRect", EnqueueWriteBufferRect);
-  Nan::SetMethod(target, "enqueueCopyBuffer", EnqueueCopyBuffer);
-  Nan::SetMethod(target, "enqueueCopyBufferRect", EnqueueCopyBufferRect);
-  Nan::SetMethod(target, "enqueueReadImage", EnqueueReadImage);
-  Nan::SetMethod(target, "enqueueWriteImage", EnqueueWriteImage);
-  Nan::SetMethod(target, "enqueueCopyImage", EnqueueCopyImage);
-  Nan::SetMethod(target, "enqueueCopyImageToBuffer", EnqueueCopyImageToBuffer);
-  Nan::SetMethod(target, "enqueueCopyBufferToImage", EnqueueCopyBufferToImage);
-  Nan::SetMethod(target, "enqueueMapBuffer", EnqueueMapBuffer);
-  Nan::SetMethod(target, "enqueueMapImage", EnqueueMapImage);
-  Nan::SetMethod(target, "enqueueUnmapMemObject", EnqueueUnmapMemObject);
-  Nan::SetMethod(target, "enqueueNDRangeKernel", EnqueueNDRangeKernel);
+  NOCL_SET_METHOD(target, "retainCommandQueue", RetainCommandQueue);
+  NOCL_SET_METHOD(target, "releaseCommandQueue", ReleaseCommandQueue);
+  NOCL_SET_METHOD(target, "getCommandQueueInfo", GetCommandQueueInfo);
+  NOCL_SET_METHOD(target, "flush", Flush);
+  NOCL_SET_METHOD(target, "finish", Finish);
+  NOCL_SET_METHOD(target, "enqueueReadBuffer", EnqueueReadBuffer);
+  NOCL_SET_METHOD(target, "enqueueReadBufferRect", EnqueueReadBufferRect);
+  NOCL_SET_METHOD(target, "enqueueWriteBuffer", EnqueueWriteBuffer);
+  NOCL_SET_METHOD(target, "enqueueWriteBufferRect", EnqueueWriteBufferRect);
+  NOCL_SET_METHOD(target, "enqueueReadBufferRegions", EnqueueReadBufferRegions);
+  NOCL_SET_METHOD(target, "enqueueWriteBufferRegions", EnqueueWriteBufferRegions);
+  NOCL_SET_METHOD(target, "enqueueCopyBuffer", EnqueueCopyBuffer);
+  NOCL_SET_METHOD(target, "enqueueCopyBufferRect", EnqueueCopyBufferRect);
+  NOCL_SET_METHOD(target, "enqueueReadImage", EnqueueReadImage);
+  NOCL_SET_METHOD(target, "enqueueWriteImage", EnqueueWriteImage);
+  NOCL_SET_METHOD(target, "enqueueCopyImage", EnqueueCopyImage);
+  NOCL_SET_METHOD(target, "enqueueCopyImageToBuffer", EnqueueCopyImageToBuffer);
+  NOCL_SET_METHOD(target, "enqueueCopyBufferToImage", EnqueueCopyBufferToImage);
+  NOCL_SET_METHOD(target, "enqueueMapBuffer", EnqueueMapBuffer);
+  NOCL_SET_METHOD(target, "enqueueMapImage", EnqueueMapImage);
+  NOCL_SET_METHOD(target, "enqueueUnmapMemObject", EnqueueUnmapMemObject);
+  NOCL_SET_METHOD(target, "enqueueNDRangeKernel", EnqueueNDRangeKernel);
 #ifndef CL_VERSION_2_0
-  Nan::SetMethod(target, "enqueueTask", EnqueueTask); // removed in 2.0
+  NOCL_SET_METHOD(target, "enqueueTask", EnqueueTask); // removed in 2.0
 #endif
-  Nan::SetMethod(target, "enqueueNativeKernel", EnqueueNativeKernel);
+  NOCL_SET_METHOD(target, "enqueueNativeKernel", EnqueueNativeKernel);
 #ifdef CL_VERSION_1_2
-  Nan::SetMethod(target, "enqueueMarkerWithWaitList", EnqueueMarkerWithWaitList);
-  Nan::SetMethod(target, "enqueueBarrierWithWaitList", EnqueueBarrierWithWaitList);
-  Nan::SetMethod(target, "enqueueFillBuffer", EnqueueFillBuffer);
-  Nan::SetMethod(target, "enqueueFillImage", EnqueueFillImage);
-  Nan::SetMethod(target, "enqueueMigrateMemObjects", EnqueueMigrateMemObjects);
+  NOCL_SET_METHOD(target, "enqueueMarkerWithWaitList", EnqueueMarkerWithWaitList);
+  NOCL_SET_METHOD(target, "enqueueBarrierWithWaitList", EnqueueBarrierWithWaitList);
+  NOCL_SET_METHOD(target, "enqueueFillBuffer", EnqueueFillBuffer);
+  NOCL_SET_METHOD(target, "enqueueFillImage", EnqueueFillImage);
+  NOCL_SET_METHOD(target, "enqueueMigrateMemObjects", EnqueueMigrateMemObjects);
 #elif defined(CL_VERSION_1_1)
-  Nan::SetMethod(target, "enqueueWaitForEvents", EnqueueWaitForEvents);
-  Nan::SetMethod(target, "enqueueMarker", EnqueueMarker);
-  Nan::SetMethod(target, "enqueueBarrier", EnqueueBarrier);
+  NOCL_SET_METHOD(target, "enqueueWaitForEvents", EnqueueWaitForEvents);
+  NOCL_SET_METHOD(target, "enqueueMarker", EnqueueMarker);
+  NOCL_SET_METHOD(target, "enqueueBarrier", EnqueueBarrier);
 #endif
 }
 } // namespace CommandQueue
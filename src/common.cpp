@@ -1,21 +1,30 @@
 #include "common.h"
 #include <iostream>
+#include <cmath>
+#include <limits>
 
 namespace opencl {
 
-class ScopedArrayBufferContents {
- public:
-  explicit ScopedArrayBufferContents(const v8::ArrayBuffer::Contents& contents)
-      : contents_(contents) {}
-  ~ScopedArrayBufferContents() { free(contents_.Data()); }
-  void* Data() const { return contents_.Data(); }
-  size_t ByteLength() const { return contents_.ByteLength(); }
+// Start of the memory behind an ArrayBuffer or a SharedArrayBuffer. Newer V8
+// reaches it through the backing store, which GetContents() only wraps.
+static void *arrayBufferData(Local<ArrayBuffer> buf)
+{
+#if V8_MAJOR_VERSION >= 8
+  return buf->GetBackingStore()->Data();
+#else
+  return buf->GetContents().Data();
+#endif
+}
 
- private:
-  const v8::ArrayBuffer::Contents contents_;
-};
+static void *sharedArrayBufferData(Local<SharedArrayBuffer> buf)
+{
+#if V8_MAJOR_VERSION >= 8
+  return buf->GetBackingStore()->Data();
+#else
+  return buf->GetContents().Data();
+#endif
+}
 
-// TODO replace TypedArray with node::Buffer or v8::ArrayBuffer (same thing)
 void getPtrAndLen(const Local<Value> value, void* &ptr, size_t &len)
 {
   Nan::HandleScope scope;
@@ -24,51 +33,104 @@ void getPtrAndLen(const Local<Value> value, void* &ptr, size_t &len)
   len=0;
   if(!value->IsUndefined() && !value->IsNull()) {
     if(value->IsArray()) {
-      // JS Array
-      // std::cout<<"[getPtrAndLen] JS array"<<std::endl;
-      // Local<Array> arr=value.As<Array>();
-      // len=arr->Length();
-      // can't access a pointer to JS Array data anymore...
+      // JS Array: no pointer to its elements, see enqueueWriteArray()
     }
     else if(value->IsArrayBuffer()) {
-      // std::cout<<"[getPtrAndLen] ArrayBuffer"<<std::endl;
-      Local<Object> obj = Nan::To<Object>(value).ToLocalChecked();
-      Local<ArrayBuffer> ta = obj.As<ArrayBuffer>();
-      len=ta->ByteLength();
-      ptr=ta->GetContents().Data();
+      Local<ArrayBuffer> ab = value.As<ArrayBuffer>();
+      len=ab->ByteLength();
+      ptr=arrayBufferData(ab);
     }
-    else if(value->IsUint8Array()) {
-      // WARNING node::Buffer is an augmented Uint8Array
-      // std::cout<<"[getPtrAndLen] Uint8Array"<<std::endl;
-      Local<Object> obj = Nan::To<Object>(value).ToLocalChecked();
-      Local<Uint8Array> ui = obj.As<Uint8Array>();
-      ArrayBuffer::Contents ab_c = ui->Buffer()->GetContents();
-      len=ui->ByteLength();
-      ptr=static_cast<char*>(ab_c.Data()) + ui->ByteOffset();
+    else if(value->IsSharedArrayBuffer()) {
+      // e.g. prepared by worker threads, used without a copy
+      Local<SharedArrayBuffer> sab = value.As<SharedArrayBuffer>();
+      len=sab->ByteLength();
+      ptr=sharedArrayBufferData(sab);
     }
-    else if(value->IsTypedArray()) {
-      // std::cout<<"[getPtrAndLen] TypedArray"<<std::endl;
-      Local<Object> obj = Nan::To<Object>(value).ToLocalChecked();
-      Local<TypedArray> ta = obj.As<TypedArray>();
-      len=ta->ByteLength();
-      ptr=static_cast<char*>(ta->Buffer()->GetContents().Data()) + ta->ByteOffset();
+    else if(value->IsArrayBufferView()) {
+      // typed arrays (node::Buffer is an augmented Uint8Array) and DataViews,
+      // over an ArrayBuffer or a SharedArrayBuffer alike
+      Local<ArrayBufferView> view = value.As<ArrayBufferView>();
+      len=view->ByteLength();
+      if(len)
+        ptr=static_cast<char*>(arrayBufferData(view->Buffer())) + view->ByteOffset();
     }
-    // else if(value->IsObject()) {
-      // shouldn't be called...
-      // std::cout<<"[getPtrAndLen] object"<<std::endl;
-      /*Local<Object> obj = Nan::To<Object>(value).ToLocalChecked();
-      String::Utf8Value name(obj->GetConstructorName());
-      std::cout<<"  object name: "<<*name<<std::endl;
-      if(!strcmp("Buffer",*name)) {
-        std::cout<<"[getPtrAndLen] node::Buffer"<<std::endl;
-        // node::Buffer
-        ptr=node::Buffer::Data(obj);
-        len=(int) node::Buffer::Length(obj);
-      }*/
-    // }
   }
 }
 
+bool toSizeT(double value, size_t &out)
+{
+  // negative, fractional, NaN, or above 2^53 where doubles skip integers
+  if(!(value >= 0 && value <= 9007199254740991.0) || value != std::floor(value))
+    return false;
+  out = static_cast<size_t>(value);
+  return true;
+}
+
+bool toSizeT(const Local<Value> value, size_t &out)
+{
+  out = 0;
+  // optional pitches and offsets
+  if(value->IsUndefined() || value->IsNull())
+    return true;
+#ifdef NOCL_HAS_BIGINT
+  if(value->IsBigInt()) {
+    bool lossless = false;
+    uint64_t v = value.As<BigInt>()->Uint64Value(&lossless);
+    // lossless is false for negative BigInts as well
+    if(!lossless || v > std::numeric_limits<size_t>::max())
+      return false;
+    out = static_cast<size_t>(v);
+    return true;
+  }
+#endif
+  Nan::Maybe<double> d = Nan::To<double>(value);
+  return d.IsJust() && toSizeT(d.FromJust(), out);
+}
+
+Local<ArrayBuffer> newExternalArrayBuffer(void *ptr, size_t len)
+{
+  v8::Isolate *isolate = v8::Isolate::GetCurrent();
+#if V8_MAJOR_VERSION >= 8
+  std::shared_ptr<v8::BackingStore> store = v8::ArrayBuffer::NewBackingStore(
+    ptr, len, v8::BackingStore::EmptyDeleter, nullptr);
+  return v8::ArrayBuffer::New(isolate, store);
+#else
+  return v8::ArrayBuffer::New(isolate, ptr, len);
+#endif
+}
+
+void detachArrayBuffer(Local<ArrayBuffer> buf)
+{
+#if V8_MAJOR_VERSION > 7 || (V8_MAJOR_VERSION == 7 && V8_MINOR_VERSION >= 3)
+  if(buf->IsDetachable())
+    buf->Detach();
+#else
+  if(buf->IsNeuterable())
+    buf->Neuter();
+#endif
+}
+
+void addCleanupHook(void (*fn)(void*), void *arg)
+{
+#ifdef NOCL_HAS_CLEANUP_HOOKS
+  node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), fn, arg);
+#else
+  // a single environment, which lives as long as the process
+  (void) fn;
+  (void) arg;
+#endif
+}
+
+void removeCleanupHook(void (*fn)(void*), void *arg)
+{
+#ifdef NOCL_HAS_CLEANUP_HOOKS
+  node::RemoveEnvironmentCleanupHook(v8::Isolate::GetCurrent(), fn, arg);
+#else
+  (void) fn;
+  (void) arg;
+#endif
+}
+
 const char* getExceptionMessage(const cl_int code) {
   switch (code) {
     case CL_SUCCESS:                            return "Success!";
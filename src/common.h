@@ -6,9 +6,6 @@
 #include <string>
 #include <memory>
 #include <vector>
-#ifdef LOGGING
-#include <iostream>
-#endif
 
 using namespace std;
 using namespace v8;
@@ -44,6 +41,8 @@ namespace {
 #define JS_STR(...) Nan::New<v8::String>(__VA_ARGS__).ToLocalChecked()
 #define JS_INT(val) Nan::New<v8::Integer>(static_cast<unsigned int>(val))
 #define JS_NUM(val) Nan::New<v8::Number>(val)
+// size_t values, exact up to 2^53
+#define JS_SIZE(val) Nan::New<v8::Number>(static_cast<double>(val))
 //#define JS_BOOL(val) Nan::New<v8::Boolean>(val)
 #define JS_RETHROW(tc) Nan::New<v8::Local<v8::Value> >(tc.Exception());
 
@@ -79,6 +78,23 @@ namespace {
 
 } // namespace
 
+// BigInt appeared in V8 6.7, its C++ API settled in 7.0
+#if V8_MAJOR_VERSION >= 7
+#define NOCL_HAS_BIGINT 1
+#endif
+
+// Per-environment cleanup hooks, run when the main thread or a worker thread
+// tears down its Node.js environment
+#if NODE_MAJOR_VERSION > 10 || (NODE_MAJOR_VERSION == 10 && NODE_MINOR_VERSION >= 2)
+#define NOCL_HAS_CLEANUP_HOOKS 1
+#endif
+
+// node::GetTracingController() and V8 trace events with explicit timestamps,
+// for the "node-opencl" trace_events category
+#if NODE_MAJOR_VERSION >= 12
+#define NOCL_HAS_TRACING 1
+#endif
+
 namespace opencl {
 
 #define ARG_EXISTS(nth) \
@@ -87,6 +103,32 @@ namespace opencl {
 
 void getPtrAndLen(const Local<Value> value, void* &ptr, size_t &len);
 
+// Reads a size or an offset given either as a Number (exact up to 2^53) or
+// as a BigInt, null and undefined being 0. Returns false for negative,
+// fractional or unsafe values, which would wrap around in a size_t.
+bool toSizeT(const Local<Value> value, size_t &out);
+bool toSizeT(double value, size_t &out);
+
+#define NOCL_TO_SIZE_T(var, value) { \
+  if (!opencl::toSizeT((value), (var))) \
+    THROW_ERR(CL_INVALID_VALUE); \
+}
+
+// Wraps memory owned by the OpenCL runtime (e.g. a mapped region) in an
+// ArrayBuffer. V8 never frees that memory, it is given back by the driver.
+Local<ArrayBuffer> newExternalArrayBuffer(void *ptr, size_t len);
+
+// Detaches an ArrayBuffer and all its views: their length drops to 0 and JS
+// can no longer reach the underlying memory.
+void detachArrayBuffer(Local<ArrayBuffer> buf);
+
+// Runs fn(arg) when the environment of the current isolate goes away. The
+// addon is loaded once per thread using it, each with its own isolate.
+void addCleanupHook(void (*fn)(void*), void *arg);
+
+// Unregisters a hook of addCleanupHook, on the thread which registered it
+void removeCleanupHook(void (*fn)(void*), void *arg);
+
 //template<typename CL_TYPE>
 //void getValuesFromArray(const Local<Array>& arr, std::vector<CL_TYPE>& vals)
 //{
@@ -106,4 +148,7 @@ const char* getExceptionMessage(const cl_int code);
 
 } // namespace opencl
 
+// binding call counters and driver timing
+#include "bindingstats.h"
+
 #endif // OPENCL_COMMON_H_
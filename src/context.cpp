@@ -64,7 +64,7 @@ NAN_METHOD(CreateContext) {
   }
 
 
-  ctx = ::clCreateContext(&cl_properties.front(),
+  ctx = NOCL_CL(clCreateContext)(&cl_properties.front(),
                         (int) cl_devices.size(), &cl_devices.front(),
                          NULL, NULL, // TODO callback support
                          &err);
@@ -113,7 +113,7 @@ NAN_METHOD(CreateContextFromType) {
   }
 
   int err=CL_SUCCESS;
-  cl_context ctx = ::clCreateContextFromType(cl_properties.data(),
+  cl_context ctx = NOCL_CL(clCreateContextFromType)(cl_properties.data(),
                         device_type,
                         nullptr, nullptr, // TODO callback support
                         &err);
@@ -163,21 +163,21 @@ NAN_METHOD(GetContextInfo) {
   case CL_CONTEXT_REFERENCE_COUNT:
   case CL_CONTEXT_NUM_DEVICES: {
     cl_uint param_value=0;
-    CHECK_ERR(::clGetContextInfo(context->getRaw(),param_name,sizeof(cl_uint), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetContextInfo)(context->getRaw(),param_name,sizeof(cl_uint), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT(param_value));
     return;
   }
   case CL_CONTEXT_DEVICES: {
     size_t n=0;
-    CHECK_ERR(::clGetContextInfo(context->getRaw(),param_name,0,NULL, &n));
+    CHECK_ERR(NOCL_CL(clGetContextInfo)(context->getRaw(),param_name,0,NULL, &n));
     n /= sizeof(cl_device_id);
 
     unique_ptr<cl_device_id[]> devices(new cl_device_id[n]);
-    CHECK_ERR(::clGetContextInfo(context->getRaw(),param_name,sizeof(cl_device_id)*n, devices.get(), NULL));
+    CHECK_ERR(NOCL_CL(clGetContextInfo)(context->getRaw(),param_name,sizeof(cl_device_id)*n, devices.get(), NULL));
 
     Local<Array> arr = Nan::New<Array>((int)n);
     for(uint32_t i=0;i<n;i++) {
-      CHECK_ERR(::clRetainDevice(devices[i]))
+      CHECK_ERR(NOCL_CL(clRetainDevice)(devices[i]))
       Nan::Set(arr, i, NOCL_WRAP(NoCLDeviceId, devices[i]));
     }
     info.GetReturnValue().Set(arr);
@@ -185,9 +185,9 @@ NAN_METHOD(GetContextInfo) {
   }
   case CL_CONTEXT_PROPERTIES: {
     size_t n=0;
-    CHECK_ERR(::clGetContextInfo(context->getRaw(),param_name,0,NULL, &n));
+    CHECK_ERR(NOCL_CL(clGetContextInfo)(context->getRaw(),param_name,0,NULL, &n));
     unique_ptr<cl_context_properties[]> ctx(new cl_context_properties[n]);
-    CHECK_ERR(::clGetContextInfo(context->getRaw(),param_name,sizeof(cl_context_properties)*n, ctx.get(), NULL));
+    CHECK_ERR(NOCL_CL(clGetContextInfo)(context->getRaw(),param_name,sizeof(cl_context_properties)*n, ctx.get(), NULL));
 
     Local<Array> arr = Nan::New<Array>((int)n);
     for(uint32_t i=0;i<n;i++) {
@@ -243,15 +243,15 @@ namespace Context {
 NAN_MODULE_INIT(init)
 {
 #ifdef CL_VERSION_2_0
-  Nan::SetMethod(target, "createContextFromType", CreateContextFromType);
+  NOCL_SET_METHOD(target, "createContextFromType", CreateContextFromType);
 #else
-  Nan::SetMethod(target, "createContext", CreateContext);
+  NOCL_SET_METHOD(target, "createContext", CreateContext);
 #endif
-  Nan::SetMethod(target, "retainContext", RetainContext);
-  Nan::SetMethod(target, "releaseContext", ReleaseContext);
-  Nan::SetMethod(target, "getContextInfo", GetContextInfo);
+  NOCL_SET_METHOD(target, "retainContext", RetainContext);
+  NOCL_SET_METHOD(target, "releaseContext", ReleaseContext);
+  NOCL_SET_METHOD(target, "getContextInfo", GetContextInfo);
 #ifdef CL_VERSION_2_1
-  // @TODO Nan::SetMethod(target, "setDefaultDeviceCommandQueue", SetDefaultDeviceCommandQueue);
+  // @TODO NOCL_SET_METHOD(target, "setDefaultDeviceCommandQueue", SetDefaultDeviceCommandQueue);
 #endif
 }
 } // namespace Context
@@ -0,0 +1,701 @@
+#include "convert.h"
+#include "types.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NOCL_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NOCL_TARGET_F16C
+#else
+#include <cpuid.h>
+#define NOCL_TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+#endif
+
+namespace opencl {
+
+cl_half floatToHalf(float f) {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t absx = x & 0x7fffffff;
+
+  if(absx >= 0x7f800000) // inf and NaN, keeping NaNs quiet
+    return (cl_half) (sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 | ((absx >> 13) & 0x3ff) : 0));
+  if(absx >= 0x477ff000) // rounds past 65504
+    return (cl_half) (sign | 0x7c00);
+  if(absx < 0x33000000) // below half the smallest subnormal
+    return (cl_half) sign;
+
+  uint32_t r, rem, halfway;
+  if(absx < 0x38800000) {
+    // subnormal: units of 2^-24
+    uint32_t m = (absx & 0x7fffff) | 0x800000;
+    int shift = 126 - (int) (absx >> 23);
+    r = m >> shift;
+    rem = m & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  }
+  else {
+    r = (absx - 0x38000000) >> 13;
+    rem = absx & 0x1fff;
+    halfway = 0x1000;
+  }
+  if(rem > halfway || (rem == halfway && (r & 1)))
+    r++;
+  return (cl_half) (sign | r);
+}
+
+float halfToFloat(cl_half h) {
+  uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t x;
+  if(exp == 0x1f)
+    x = sign | 0x7f800000 | (mant << 13);
+  else if(exp)
+    x = sign | ((exp + 112) << 23) | (mant << 13);
+  else if(mant) {
+    uint32_t e = 113;
+    do {
+      mant <<= 1;
+      e--;
+    } while(!(mant & 0x400));
+    x = sign | (e << 23) | ((mant & 0x3ff) << 13);
+  }
+  else
+    x = sign;
+  float f;
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+bool parseElementFormat(const std::string &name, bool device, ElementFormat &fmt) {
+  static const struct { const char *name; ScalarType type; } scalars[] = {
+    { "char", kChar }, { "uchar", kUChar }, { "short", kShort }, { "ushort", kUShort },
+    { "int", kInt }, { "uint", kUInt }, { "long", kLong }, { "ulong", kULong },
+    { "half", kHalf }, { "float", kFloat }, { "double", kDouble }
+  };
+  for(const auto &s : scalars) {
+    size_t len = strlen(s.name);
+    if(name.compare(0, len, s.name) != 0)
+      continue;
+    std::string suffix = name.substr(len);
+    unsigned n = suffix.empty() ? 1 : (unsigned) atoi(suffix.c_str());
+    if(!(n == 1 || n == 2 || n == 3 || n == 4 || n == 8 || n == 16) ||
+       (!suffix.empty() && std::to_string(n) != suffix))
+      continue;
+    fmt.type = s.type;
+    fmt.components = n;
+    fmt.stride = (device && n == 3) ? 4 : n;
+    return true;
+  }
+  return false;
+}
+
+static size_t scalarSize(ScalarType type) {
+  switch(type) {
+    case kChar: case kUChar: return 1;
+    case kShort: case kUShort: case kHalf: return 2;
+    case kInt: case kUInt: case kFloat: return 4;
+    default: return 8;
+  }
+}
+
+size_t elementSize(const ElementFormat &fmt) {
+  return scalarSize(fmt.type) * fmt.stride;
+}
+
+#ifdef NOCL_X86
+static bool detectF16C() {
+  // F16C, AVX and OS support for the AVX state (VEX encoded instructions)
+#ifdef _MSC_VER
+  int r[4];
+  __cpuid(r, 1);
+  unsigned c = (unsigned) r[2];
+#else
+  unsigned a, b, c, d;
+  if(!__get_cpuid(1, &a, &b, &c, &d))
+    return false;
+#endif
+  if(!(c & (1u << 29)) || !(c & (1u << 28)) || !(c & (1u << 27)))
+    return false;
+#ifdef _MSC_VER
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (lo & 6) == 6;
+#endif
+}
+
+static const bool hasF16C = detectF16C();
+
+NOCL_TARGET_F16C
+static size_t floatsToHalvesF16C(const float *src, cl_half *dst, size_t n) {
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+  }
+  return i;
+}
+
+NOCL_TARGET_F16C
+static size_t halvesToFloatsF16C(const cl_half *src, float *dst, size_t n) {
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+#endif
+
+static void floatsToHalves(const float *src, cl_half *dst, size_t n) {
+  size_t i = 0;
+#ifdef NOCL_X86
+  if(hasF16C)
+    i = floatsToHalvesF16C(src, dst, n);
+#endif
+  for(; i < n; i++)
+    dst[i] = floatToHalf(src[i]);
+}
+
+static void halvesToFloats(const cl_half *src, float *dst, size_t n) {
+  size_t i = 0;
+#ifdef NOCL_X86
+  if(hasF16C)
+    i = halvesToFloatsF16C(src, dst, n);
+#endif
+  for(; i < n; i++)
+    dst[i] = halfToFloat(src[i]);
+}
+
+static void doublesToFloats(const double *src, float *dst, size_t n) {
+  size_t i = 0;
+#ifdef NOCL_X86
+  for(; i + 4 <= n; i += 4) {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+    _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+  }
+#endif
+  for(; i < n; i++)
+    dst[i] = (float) src[i];
+}
+
+static void floatsToDoubles(const float *src, double *dst, size_t n) {
+  size_t i = 0;
+#ifdef NOCL_X86
+  for(; i + 4 <= n; i += 4) {
+    __m128 f = _mm_loadu_ps(src + i);
+    _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+    _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+  }
+#endif
+  for(; i < n; i++)
+    dst[i] = src[i];
+}
+
+// Integer widening and narrowing, vectorized by the compiler
+template <typename S, typename D>
+static void convertLoop(const S *src, D *dst, size_t n) {
+  for(size_t i = 0; i < n; i++)
+    dst[i] = static_cast<D>(src[i]);
+}
+
+template <typename S>
+static void convertFrom(const S *src, void *dst, ScalarType to, size_t n) {
+  switch(to) {
+    case kChar: convertLoop(src, static_cast<cl_char*>(dst), n); break;
+    case kUChar: convertLoop(src, static_cast<cl_uchar*>(dst), n); break;
+    case kShort: convertLoop(src, static_cast<cl_short*>(dst), n); break;
+    case kUShort: convertLoop(src, static_cast<cl_ushort*>(dst), n); break;
+    case kInt: convertLoop(src, static_cast<cl_int*>(dst), n); break;
+    case kUInt: convertLoop(src, static_cast<cl_uint*>(dst), n); break;
+    case kLong: convertLoop(src, static_cast<cl_long*>(dst), n); break;
+    case kULong: convertLoop(src, static_cast<cl_ulong*>(dst), n); break;
+    case kFloat: convertLoop(src, static_cast<cl_float*>(dst), n); break;
+    case kDouble: convertLoop(src, static_cast<cl_double*>(dst), n); break;
+    case kHalf: break; // handled by convertScalars()
+  }
+}
+
+// Converts n scalars
+static void convertScalars(const void *src, ScalarType from, void *dst, ScalarType to, size_t n) {
+  if(from == to) {
+    memcpy(dst, src, n * scalarSize(from));
+    return;
+  }
+  if(from == kFloat && to == kHalf)
+    return floatsToHalves(static_cast<const float*>(src), static_cast<cl_half*>(dst), n);
+  if(from == kHalf && to == kFloat)
+    return halvesToFloats(static_cast<const cl_half*>(src), static_cast<float*>(dst), n);
+  if(from == kDouble && to == kFloat)
+    return doublesToFloats(static_cast<const double*>(src), static_cast<float*>(dst), n);
+  if(from == kFloat && to == kDouble)
+    return floatsToDoubles(static_cast<const float*>(src), static_cast<double*>(dst), n);
+
+  // other conversions to or from half go through float, by blocks
+  if(from == kHalf || to == kHalf) {
+    const size_t kBlock = 1024;
+    float tmp[kBlock];
+    for(size_t i = 0; i < n; i += kBlock) {
+      size_t m = std::min(kBlock, n - i);
+      if(from == kHalf) {
+        halvesToFloats(static_cast<const cl_half*>(src) + i, tmp, m);
+        convertScalars(tmp, kFloat, static_cast<char*>(dst) + i * scalarSize(to), to, m);
+      }
+      else {
+        convertScalars(static_cast<const char*>(src) + i * scalarSize(from), from, tmp, kFloat, m);
+        floatsToHalves(tmp, static_cast<cl_half*>(dst) + i, m);
+      }
+    }
+    return;
+  }
+
+  switch(from) {
+    case kChar: convertFrom(static_cast<const cl_char*>(src), dst, to, n); break;
+    case kUChar: convertFrom(static_cast<const cl_uchar*>(src), dst, to, n); break;
+    case kShort: convertFrom(static_cast<const cl_short*>(src), dst, to, n); break;
+    case kUShort: convertFrom(static_cast<const cl_ushort*>(src), dst, to, n); break;
+    case kInt: convertFrom(static_cast<const cl_int*>(src), dst, to, n); break;
+    case kUInt: convertFrom(static_cast<const cl_uint*>(src), dst, to, n); break;
+    case kLong: convertFrom(static_cast<const cl_long*>(src), dst, to, n); break;
+    case kULong: convertFrom(static_cast<const cl_ulong*>(src), dst, to, n); break;
+    case kFloat: convertFrom(static_cast<const cl_float*>(src), dst, to, n); break;
+    case kDouble: convertFrom(static_cast<const cl_double*>(src), dst, to, n); break;
+    case kHalf: break;
+  }
+}
+
+static void convertRange(const char *src, const ElementFormat &from,
+                         char *dst, const ElementFormat &to, size_t count) {
+  if(from.stride == from.components && to.stride == to.components) {
+    convertScalars(src, from.type, dst, to.type, count * from.components);
+    return;
+  }
+  // padded vectors, one at a time
+  size_t srcSize = elementSize(from), dstSize = elementSize(to);
+  size_t pad = (to.stride - to.components) * scalarSize(to.type);
+  for(size_t i = 0; i < count; i++) {
+    char *out = dst + i * dstSize;
+    convertScalars(src + i * srcSize, from.type, out, to.type, from.components);
+    if(pad)
+      memset(out + dstSize - pad, 0, pad);
+  }
+}
+
+// Elements per thread below which splitting does not pay off
+static const size_t kThreadGrain = 1 << 18;
+
+void convertElements(const void *src, const ElementFormat &from,
+                     void *dst, const ElementFormat &to, size_t count) {
+  const char *in = static_cast<const char*>(src);
+  char *out = static_cast<char*>(dst);
+
+  size_t nthreads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), 8);
+  nthreads = std::min(nthreads, count / kThreadGrain);
+  if(nthreads <= 1) {
+    convertRange(in, from, out, to, count);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  size_t per = (count + nthreads - 1) / nthreads;
+  for(size_t t = 1; t < nthreads; t++) {
+    size_t begin = t * per, n = std::min(per, count - begin);
+    threads.emplace_back(convertRange, in + begin * elementSize(from), std::cref(from),
+                         out + begin * elementSize(to), std::cref(to), n);
+  }
+  convertRange(in, from, out, to, per);
+  for(std::thread &t : threads)
+    t.join();
+}
+
+// Host format of a typed array, when no type is given
+static bool typedArrayFormat(Local<Value> value, ElementFormat &fmt) {
+  const char *name =
+    value->IsInt8Array() ? "char" :
+    value->IsUint8Array() || value->IsUint8ClampedArray() ? "uchar" :
+    value->IsInt16Array() ? "short" :
+    value->IsUint16Array() ? "ushort" :
+    value->IsInt32Array() ? "int" :
+    value->IsUint32Array() ? "uint" :
+    value->IsFloat32Array() ? "float" :
+    value->IsFloat64Array() ? "double" :
+#ifdef NOCL_HAS_BIGINT
+    value->IsBigInt64Array() ? "long" :
+    value->IsBigUint64Array() ? "ulong" :
+#endif
+    nullptr;
+  return name && parseElementFormat(name, false, fmt);
+}
+
+// Reads the host and device formats of a converted transfer
+static bool getFormats(const Nan::FunctionCallbackInfo<v8::Value> &info, int n,
+                       ElementFormat &host, ElementFormat &device) {
+  if(ARG_EXISTS(n)) {
+    Nan::Utf8String name(info[n]);
+    if(!parseElementFormat(*name, false, host))
+      return false;
+  }
+  else if(!typedArrayFormat(info[n - 1], host))
+    return false;
+  Nan::Utf8String name(info[n + 1]);
+  return parseElementFormat(*name, true, device) && host.components == device.components;
+}
+
+static void CL_CALLBACK freeOnComplete(cl_event /* event */, cl_int /* status */, void *user_data) {
+  free(user_data);
+}
+
+// A non-blocking converted read: the host side conversion runs in the read
+// event callback, done completes after it.
+struct PendingRead {
+  void *staged;
+  void *host;
+  ElementFormat from;
+  ElementFormat to;
+  size_t count;
+  cl_event done;
+};
+
+static void CL_CALLBACK convertOnComplete(cl_event /* event */, cl_int status, void *user_data) {
+  PendingRead *read = static_cast<PendingRead*>(user_data);
+  if(status == CL_COMPLETE)
+    convertElements(read->staged, read->from, read->host, read->to, read->count);
+  ::clSetUserEventStatus(read->done, status == CL_COMPLETE ? CL_COMPLETE : status);
+  ::clReleaseEvent(read->done);
+  free(read->staged);
+  delete read;
+}
+
+// enqueueWriteBufferConverted(command_queue, buffer, blocking_write, offset, ptr,
+//                             host_type, device_type, event_wait_list, event)
+NAN_METHOD(EnqueueWriteBufferConverted) {
+  Nan::HandleScope scope;
+  REQ_ARGS(7);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  // Arg 1
+  NOCL_UNWRAP(buffer, NoCLMem, info[1]);
+
+  cl_bool blocking = Nan::To<bool>(info[2]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[3]);
+
+  void *ptr=nullptr;
+  size_t len=0;
+  getPtrAndLen(info[4],ptr,len);
+  if(!ptr || !len)
+    return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
+
+  ElementFormat host, device;
+  if(!getFormats(info, 5, host, device))
+    return Nan::ThrowTypeError("Unsupported or mismatched element types");
+
+  std::vector<NoCLEvent*> cl_events;
+  if(ARG_EXISTS(7)) {
+    Local<Array> js_events = Local<Array>::Cast(info[7]);
+    NOCL_TO_ARRAY(cl_events, js_events, NoCLEvent);
+  }
+  bool generateEvent = ARG_EXISTS(8) && Nan::To<bool>(info[8]).FromJust();
+  std::vector<cl_event> wait_list = NoCLEvent::toCLArray(cl_events);
+
+  size_t count = len / elementSize(host);
+  size_t size = count * elementSize(device);
+  void *staged = malloc(size ? size : 1);
+  if(!staged)
+    THROW_ERR(CL_OUT_OF_HOST_MEMORY);
+  convertElements(ptr, host, staged, device, count);
+
+  cl_event event = nullptr;
+  cl_int ret = NOCL_CL(clEnqueueWriteBuffer)(q->getRaw(), buffer->getRaw(), blocking, offset, size, staged,
+    (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, &event);
+  if(ret == CL_SUCCESS && !blocking)
+    ret = NOCL_CL(clSetEventCallback)(event, CL_COMPLETE, freeOnComplete, staged);
+  if(ret != CL_SUCCESS || blocking) {
+    if(event)
+      NOCL_CL(clWaitForEvents)(1, &event);
+    free(staged);
+  }
+  if(ret != CL_SUCCESS && event) {
+    NOCL_CL(clReleaseEvent)(event);
+  }
+  CHECK_ERR(ret);
+
+  if(generateEvent) {
+    info.GetReturnValue().Set(NOCL_WRAP(NoCLEvent, event));
+  } else {
+    NOCL_CL(clReleaseEvent)(event);
+    info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+  }
+}
+
+// enqueueReadBufferConverted(command_queue, buffer, blocking_read, offset, ptr,
+//                            host_type, device_type, event_wait_list, event)
+NAN_METHOD(EnqueueReadBufferConverted) {
+  Nan::HandleScope scope;
+  REQ_ARGS(7);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  // Arg 1
+  NOCL_UNWRAP(buffer, NoCLMem, info[1]);
+
+  cl_bool blocking = Nan::To<bool>(info[2]).FromJust();
+  size_t offset;
+  NOCL_TO_SIZE_T(offset, info[3]);
+
+  void *ptr=nullptr;
+  size_t len=0;
+  getPtrAndLen(info[4],ptr,len);
+  if(!ptr || !len)
+    return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
+
+  ElementFormat host, device;
+  if(!getFormats(info, 5, host, device))
+    return Nan::ThrowTypeError("Unsupported or mismatched element types");
+
+  std::vector<NoCLEvent*> cl_events;
+  if(ARG_EXISTS(7)) {
+    Local<Array> js_events = Local<Array>::Cast(info[7]);
+    NOCL_TO_ARRAY(cl_events, js_events, NoCLEvent);
+  }
+  bool generateEvent = ARG_EXISTS(8) && Nan::To<bool>(info[8]).FromJust();
+  std::vector<cl_event> wait_list = NoCLEvent::toCLArray(cl_events);
+
+  size_t count = len / elementSize(host);
+  size_t size = count * elementSize(device);
+  void *staged = malloc(size ? size : 1);
+  if(!staged)
+    THROW_ERR(CL_OUT_OF_HOST_MEMORY);
+
+  cl_event event = nullptr;
+  cl_int ret = NOCL_CL(clEnqueueReadBuffer)(q->getRaw(), buffer->getRaw(), blocking, offset, size, staged,
+    (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, &event);
+  if(ret != CL_SUCCESS) {
+    free(staged);
+    THROW_ERR(ret);
+  }
+
+  if(blocking) {
+    convertElements(staged, device, ptr, host, count);
+    free(staged);
+  }
+  else {
+    cl_context ctx;
+    ret = NOCL_CL(clGetCommandQueueInfo)(q->getRaw(), CL_QUEUE_CONTEXT, sizeof(cl_context), &ctx, nullptr);
+    cl_event done = nullptr;
+    if(ret == CL_SUCCESS)
+      done = NOCL_CL(clCreateUserEvent)(ctx, &ret);
+    if(ret != CL_SUCCESS) {
+      NOCL_CL(clWaitForEvents)(1, &event);
+      NOCL_CL(clReleaseEvent)(event);
+      free(staged);
+      THROW_ERR(ret);
+    }
+
+    PendingRead *read = new PendingRead { staged, ptr, device, host, count, done };
+    NOCL_CL(clRetainEvent)(done);
+    ret = NOCL_CL(clSetEventCallback)(event, CL_COMPLETE, convertOnComplete, read);
+    if(ret != CL_SUCCESS) {
+      NOCL_CL(clWaitForEvents)(1, &event);
+      convertOnComplete(event, CL_COMPLETE, read);
+    }
+    NOCL_CL(clReleaseEvent)(event);
+    // the returned event completes once the host copy is converted
+    event = done;
+  }
+
+  if(generateEvent) {
+    info.GetReturnValue().Set(NOCL_WRAP(NoCLEvent, event));
+  } else {
+    NOCL_CL(clReleaseEvent)(event);
+    info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+  }
+}
+
+// Host memory for Array transfers. Freed blocks are kept for reuse, so
+// repeated transfers of similar sizes do not go back to malloc.
+static const size_t kMaxScratchBlocks = 4;
+static std::mutex scratchMutex;
+static std::vector<std::pair<void*, size_t> > scratchBlocks;
+
+static void *acquireScratch(size_t size, size_t &capacity) {
+  {
+    std::lock_guard<std::mutex> lock(scratchMutex);
+    for(size_t i = 0; i < scratchBlocks.size(); i++) {
+      if(scratchBlocks[i].second >= size) {
+        void *ptr = scratchBlocks[i].first;
+        capacity = scratchBlocks[i].second;
+        scratchBlocks.erase(scratchBlocks.begin() + i);
+        return ptr;
+      }
+    }
+  }
+  capacity = size ? size : 1;
+  return malloc(capacity);
+}
+
+static void releaseScratch(void *ptr, size_t capacity) {
+  std::lock_guard<std::mutex> lock(scratchMutex);
+  if(scratchBlocks.size() >= kMaxScratchBlocks) {
+    // drop the smallest block
+    auto smallest = std::min_element(scratchBlocks.begin(), scratchBlocks.end(),
+      [](const std::pair<void*, size_t> &a, const std::pair<void*, size_t> &b) {
+        return a.second < b.second;
+      });
+    if(smallest->second >= capacity) {
+      free(ptr);
+      return;
+    }
+    free(smallest->first);
+    scratchBlocks.erase(smallest);
+  }
+  scratchBlocks.emplace_back(ptr, capacity);
+}
+
+struct ScratchBlock {
+  void *ptr;
+  size_t capacity;
+};
+
+static void CL_CALLBACK releaseScratchOnComplete(cl_event /* event */, cl_int /* status */, void *user_data) {
+  ScratchBlock *block = static_cast<ScratchBlock*>(user_data);
+  releaseScratch(block->ptr, block->capacity);
+  delete block;
+}
+
+// Elements of an Array go through a block of doubles, the JS number type
+static const size_t kArrayBlock = 1024;
+
+static cl_int arrayFormats(const std::string &type, size_t size, uint32_t length, bool write,
+                           ElementFormat &js, ElementFormat &device, size_t &count) {
+  if(!parseElementFormat(type, true, device))
+    return CL_INVALID_VALUE;
+  js.type = kDouble;
+  js.components = js.stride = device.components;
+  count = size / elementSize(device);
+  if(size % elementSize(device) || (write && (size_t) length < count * device.components))
+    return CL_INVALID_VALUE;
+  return CL_SUCCESS;
+}
+
+cl_int enqueueWriteArray(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                         size_t offset, size_t size, Local<Array> array,
+                         const std::string &type, const std::vector<cl_event> &wait_list,
+                         cl_event *event) {
+  ElementFormat js, device;
+  size_t count;
+  cl_int ret = arrayFormats(type, size, array->Length(), true, js, device, count);
+  if(ret != CL_SUCCESS)
+    return ret;
+
+  size_t capacity;
+  char *staged = static_cast<char*>(acquireScratch(size, capacity));
+  if(!staged)
+    return CL_OUT_OF_HOST_MEMORY;
+
+  // indexed gets on packed Smi and double elements take V8's fast path
+  size_t perBlock = std::max<size_t>(1, kArrayBlock / js.components);
+  double values[kArrayBlock];
+  uint32_t index = 0;
+  for(size_t i = 0; i < count && ret == CL_SUCCESS; i += perBlock) {
+    // the handles of a block go away with it
+    Nan::HandleScope scope;
+    size_t n = std::min(perBlock, count - i);
+    for(size_t k = 0; k < n * js.components; k++, index++) {
+      Local<Value> value;
+      if(!Nan::Get(array, index).ToLocal(&value) || !value->IsNumber()) {
+        ret = CL_INVALID_VALUE;
+        break;
+      }
+      values[k] = value.As<Number>()->Value();
+    }
+    if(ret == CL_SUCCESS)
+      convertRange(reinterpret_cast<const char*>(values), js, staged + i * elementSize(device), device, n);
+  }
+  if(ret != CL_SUCCESS) {
+    releaseScratch(staged, capacity);
+    return ret;
+  }
+
+  cl_event done = nullptr;
+  ret = ::clEnqueueWriteBuffer(q, buffer, blocking, offset, size, staged,
+    (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, &done);
+  if(ret == CL_SUCCESS && !blocking) {
+    ScratchBlock *block = new ScratchBlock { staged, capacity };
+    ret = ::clSetEventCallback(done, CL_COMPLETE, releaseScratchOnComplete, block);
+    if(ret != CL_SUCCESS)
+      delete block;
+  }
+  if(ret != CL_SUCCESS || blocking) {
+    if(done)
+      ::clWaitForEvents(1, &done);
+    releaseScratch(staged, capacity);
+  }
+  if(ret == CL_SUCCESS && event)
+    *event = done;
+  else if(done)
+    ::clReleaseEvent(done);
+  return ret;
+}
+
+cl_int enqueueReadArray(cl_command_queue q, cl_mem buffer, size_t offset, size_t size,
+                        Local<Array> array, const std::string &type,
+                        const std::vector<cl_event> &wait_list, cl_event *event) {
+  ElementFormat js, device;
+  size_t count;
+  cl_int ret = arrayFormats(type, size, array->Length(), false, js, device, count);
+  if(ret != CL_SUCCESS)
+    return ret;
+
+  size_t capacity;
+  char *staged = static_cast<char*>(acquireScratch(size, capacity));
+  if(!staged)
+    return CL_OUT_OF_HOST_MEMORY;
+
+  ret = ::clEnqueueReadBuffer(q, buffer, CL_TRUE, offset, size, staged,
+    (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr, event);
+  if(ret != CL_SUCCESS) {
+    releaseScratch(staged, capacity);
+    return ret;
+  }
+
+  size_t perBlock = std::max<size_t>(1, kArrayBlock / js.components);
+  double values[kArrayBlock];
+  uint32_t index = 0;
+  for(size_t i = 0; i < count; i += perBlock) {
+    // the handles of a block go away with it
+    Nan::HandleScope scope;
+    size_t n = std::min(perBlock, count - i);
+    convertRange(staged + i * elementSize(device), device, reinterpret_cast<char*>(values), js, n);
+    for(size_t k = 0; k < n * js.components; k++, index++)
+      Nan::Set(array, index, Nan::New<Number>(values[k]));
+  }
+  releaseScratch(staged, capacity);
+  return CL_SUCCESS;
+}
+
+namespace Convert {
+NAN_MODULE_INIT(init)
+{
+  NOCL_SET_METHOD(target, "enqueueWriteBufferConverted", EnqueueWriteBufferConverted);
+  NOCL_SET_METHOD(target, "enqueueReadBufferConverted", EnqueueReadBufferConverted);
+}
+} // namespace Convert
+
+} // namespace opencl
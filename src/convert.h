@@ -0,0 +1,56 @@
+#ifndef CONVERT_H_
+#define CONVERT_H_
+
+#include "common.h"
+
+namespace opencl {
+
+// IEEE 754 binary16 <-> binary32, rounding to nearest even
+cl_half floatToHalf(float f);
+float halfToFloat(cl_half h);
+
+enum ScalarType {
+  kChar, kUChar, kShort, kUShort, kInt, kUInt, kLong, kULong, kHalf, kFloat, kDouble
+};
+
+// Layout of one element: a scalar or an OpenCL vector. On the device a
+// 3-component vector takes the room of 4 (stride), on the host it is packed.
+struct ElementFormat {
+  ScalarType type;
+  unsigned components;
+  unsigned stride;
+};
+
+// Parses an OpenCL type name ("float", "half4", "uint3", ...). Returns false
+// for unknown names.
+bool parseElementFormat(const std::string &name, bool device, ElementFormat &fmt);
+
+size_t elementSize(const ElementFormat &fmt);
+
+// Converts count elements between formats of the same number of components,
+// zeroing padding components. Large arrays are split across threads.
+void convertElements(const void *src, const ElementFormat &from,
+                     void *dst, const ElementFormat &to, size_t count);
+
+// Transfers between a buffer and a JS Array of numbers, converted to or from
+// the OpenCL type name (see parseElementFormat). size is in bytes on the
+// device. Reads always complete before returning, since the Array can only
+// be filled on the thread owning it: enqueueReadBuffer ignores blocking_read
+// for Arrays. Unknown types, short Arrays and non-number
+// elements give CL_INVALID_VALUE.
+cl_int enqueueWriteArray(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                         size_t offset, size_t size, Local<Array> array,
+                         const std::string &type, const std::vector<cl_event> &wait_list,
+                         cl_event *event);
+
+cl_int enqueueReadArray(cl_command_queue q, cl_mem buffer, size_t offset, size_t size,
+                        Local<Array> array, const std::string &type,
+                        const std::vector<cl_event> &wait_list, cl_event *event);
+
+namespace Convert {
+NAN_MODULE_INIT(init);
+} // namespace Convert
+
+} // namespace opencl
+
+#endif // CONVERT_H_
@@ -22,15 +22,15 @@ NAN_METHOD(GetDeviceIDs) {
     type=Nan::To<uint32_t>(info[1]).FromJust();
 
   cl_uint n = 0;
-  CHECK_ERR(::clGetDeviceIDs(platform_id->getRaw(), type, 0, NULL, &n));
+  CHECK_ERR(NOCL_CL(clGetDeviceIDs)(platform_id->getRaw(), type, 0, NULL, &n));
 
   unique_ptr<cl_device_id[]> devices(new cl_device_id[n]);
-  CHECK_ERR(::clGetDeviceIDs(platform_id->getRaw(), type, n, devices.get(), NULL));
+  CHECK_ERR(NOCL_CL(clGetDeviceIDs)(platform_id->getRaw(), type, n, devices.get(), NULL));
 
   Local<Array> deviceArray = Nan::New<Array>(n);
   for (uint32_t i=0; i<n; i++) {
     // This is a noop for root-level devices but properly retains sub-devices.
-    CHECK_ERR(::clRetainDevice(devices[i]));
+    CHECK_ERR(NOCL_CL(clRetainDevice)(devices[i]));
     Nan::Set(deviceArray, i, NOCL_WRAP(NoCLDeviceId, devices[i]));
   }
 
@@ -63,7 +63,7 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_EXTENSIONS: {
     char param_value[1024];
     size_t param_value_size_ret=0;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(char)*1024, param_value, &param_value_size_ret));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(char)*1024, param_value, &param_value_size_ret));
 
     // NOTE: Adjust length because API returns NULL terminated string
     info.GetReturnValue().Set(JS_STR(param_value,(int)param_value_size_ret - 1));
@@ -73,7 +73,7 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_PLATFORM: {
     cl_platform_id param_value;
 
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_platform_id), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_platform_id), &param_value, NULL));
 
     if(param_value) {
       info.GetReturnValue().Set(NOCL_WRAP(NoCLPlatformId, param_value));
@@ -83,31 +83,31 @@ NAN_METHOD(GetDeviceInfo) {
   break;
   case CL_DEVICE_TYPE: {
     cl_device_type param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_device_type), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_device_type), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT(param_value));
   }
   return;
   case CL_DEVICE_LOCAL_MEM_TYPE: {
     cl_device_local_mem_type param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_device_local_mem_type), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_device_local_mem_type), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT(param_value));
     return;
   }
   case CL_DEVICE_GLOBAL_MEM_CACHE_TYPE: {
     cl_device_mem_cache_type param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_device_mem_cache_type), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_device_mem_cache_type), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT(param_value));
     return;
   }
   case CL_DEVICE_EXECUTION_CAPABILITIES: {
     cl_device_exec_capabilities param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_device_exec_capabilities), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_device_exec_capabilities), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT((int)param_value));
     return;
   }
   case CL_DEVICE_QUEUE_PROPERTIES: {
     cl_command_queue_properties param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_command_queue_properties), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_command_queue_properties), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT((int)param_value));
     return;
   }
@@ -115,7 +115,7 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_SINGLE_FP_CONFIG:
   case CL_DEVICE_DOUBLE_FP_CONFIG: {
     cl_device_fp_config param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_device_fp_config), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_device_fp_config), &param_value, NULL));
 
     info.GetReturnValue().Set(JS_INT((int)param_value));
     return;
@@ -123,11 +123,11 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_MAX_WORK_ITEM_SIZES: {
     // get CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS param
     cl_uint max_work_item_dimensions;
-    CHECK_ERR(::clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(size_t), &max_work_item_dimensions, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, sizeof(size_t), &max_work_item_dimensions, NULL));
 
     // get CL_DEVICE_MAX_WORK_ITEM_SIZES array param
     unique_ptr<size_t[]> param_value(new size_t[max_work_item_dimensions]);
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, max_work_item_dimensions*sizeof(size_t), param_value.get(), NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, max_work_item_dimensions*sizeof(size_t), param_value.get(), NULL));
 
     Local<Array> arr = Nan::New<Array>(max_work_item_dimensions);
     for(cl_uint i=0;i<max_work_item_dimensions;i++)
@@ -145,7 +145,7 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_IMAGE_SUPPORT:
   {
     cl_bool param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_bool), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_bool), &param_value, NULL));
     // keeping as Integer vs Boolean so comparisons with cl.TRUE/cl.FALSE work
     info.GetReturnValue().Set((param_value==CL_TRUE) ? Nan::True() : Nan::False());
     return;
@@ -201,7 +201,7 @@ NAN_METHOD(GetDeviceInfo) {
   case 0x4009:
   {
     cl_uint param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_uint), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_uint), &param_value, NULL));
     info.GetReturnValue().Set(JS_INT((int)param_value));
     return;
   }
@@ -212,7 +212,7 @@ NAN_METHOD(GetDeviceInfo) {
   case CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE:
   case CL_DEVICE_MAX_MEM_ALLOC_SIZE: {
     cl_ulong param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(cl_ulong), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(cl_ulong), &param_value, NULL));
 
     /**
       JS Compatibility
@@ -248,10 +248,9 @@ NAN_METHOD(GetDeviceInfo) {
 #endif
   {
     size_t param_value;
-    CHECK_ERR(::clGetDeviceInfo(device_id, param_name, sizeof(size_t), &param_value, NULL));
+    CHECK_ERR(NOCL_CL(clGetDeviceInfo)(device_id, param_name, sizeof(size_t), &param_value, NULL));
 
-    // assume for these params it will fit in an int
-    info.GetReturnValue().Set(Nan::New<Integer>((int)param_value));
+    info.GetReturnValue().Set(JS_SIZE(param_value));
     return;
   }
   default: {
@@ -287,10 +286,10 @@ NAN_METHOD(CreateSubDevices) {
   cl_uint capacity = 0;
   cl_device_partition_property pps [] = {CL_DEVICE_PARTITION_BY_COUNTS,3,1,CL_DEVICE_PARTITION_BY_COUNTS_LIST_END,0};
 
-  cl_int ret = ::clCreateSubDevices(deviceId, pps, 0, NULL, &capacity);
+  cl_int ret = NOCL_CL(clCreateSubDevices)(deviceId, pps, 0, NULL, &capacity);
   CHECK_ERR(ret);
   unique_ptr<cl_device_id[]> subDevices(new cl_device_id[capacity]);
-  ret = ::clCreateSubDevices(deviceId, &cl_properties.front(), capacity, subDevices.get(), NULL);
+  ret = NOCL_CL(clCreateSubDevices)(deviceId, &cl_properties.front(), capacity, subDevices.get(), NULL);
   CHECK_ERR(ret);
 
   Local<Array> subDevicesArray = Nan::New<Array>(capacity);
@@ -313,13 +312,13 @@ NAN_METHOD(RetainDevice) {
   cl_device_id deviceId = device->getRaw();
   cl_device_id parentId = NULL;
 
-  ::clGetDeviceInfo(deviceId, CL_DEVICE_PARENT_DEVICE, sizeof(cl_device_id), &parentId, NULL);
+  NOCL_CL(clGetDeviceInfo)(deviceId, CL_DEVICE_PARENT_DEVICE, sizeof(cl_device_id), &parentId, NULL);
 
   if (parentId == NULL) {
     THROW_ERR(CL_INVALID_DEVICE);
   }
 
-  cl_int ret = ::clRetainDevice(deviceId);
+  cl_int ret = NOCL_CL(clRetainDevice)(deviceId);
 
   CHECK_ERR(ret);
   info.GetReturnValue().Set(JS_INT(ret));
@@ -336,42 +335,80 @@ NAN_METHOD(ReleaseDevice) {
   cl_device_id deviceId = device->getRaw();
   cl_device_id parentId = NULL;
 
-  ::clGetDeviceInfo(deviceId, CL_DEVICE_PARENT_DEVICE, sizeof(cl_device_id), &parentId, NULL);
+  NOCL_CL(clGetDeviceInfo)(deviceId, CL_DEVICE_PARENT_DEVICE, sizeof(cl_device_id), &parentId, NULL);
 
   if (parentId == NULL) {
     THROW_ERR(CL_INVALID_DEVICE);
   }
 
-  cl_int ret = ::clReleaseDevice(deviceId);
+  cl_int ret = NOCL_CL(clReleaseDevice)(deviceId);
   CHECK_ERR(ret);
   info.GetReturnValue().Set(JS_INT(ret));
 }
 #endif
 
 #ifdef CL_VERSION_2_1
+// Timestamps are nanoseconds, returned as numbers (exact up to 2^53 ns, that
+// is 104 days of uptime) or as BigInts when as_bigint is true.
+static Local<Value> timestampToJS(cl_ulong t, bool asBigInt) {
+#ifdef NOCL_HAS_BIGINT
+  if(asBigInt)
+    return v8::BigInt::NewFromUnsigned(v8::Isolate::GetCurrent(), t);
+#endif
+  return JS_SIZE(t);
+}
+
 // extern CL_API_ENTRY cl_int CL_API_CALL
 // clGetDeviceAndHostTimer(cl_device_id    /* device */,
 //                         cl_ulong*       /* device_timestamp */,
 //                         cl_ulong*       /* host_timestamp */) CL_API_SUFFIX__VERSION_2_1;
+// Returns [device_timestamp, host_timestamp], sampled together.
+NAN_METHOD(GetDeviceAndHostTimer) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  NOCL_UNWRAP(device, NoCLDeviceId, info[0]);
+  bool asBigInt = ARG_EXISTS(1) && Nan::To<bool>(info[1]).FromJust();
+
+  cl_ulong deviceTimestamp = 0, hostTimestamp = 0;
+  CHECK_ERR(NOCL_CL(clGetDeviceAndHostTimer)(device->getRaw(), &deviceTimestamp, &hostTimestamp));
+
+  Local<Array> arr = Nan::New<Array>(2);
+  Nan::Set(arr, 0, timestampToJS(deviceTimestamp, asBigInt));
+  Nan::Set(arr, 1, timestampToJS(hostTimestamp, asBigInt));
+  info.GetReturnValue().Set(arr);
+}
 
 // extern CL_API_ENTRY cl_int CL_API_CALL
 // clGetHostTimer(cl_device_id /* device */,
 //                cl_ulong *   /* host_timestamp */)  CL_API_SUFFIX__VERSION_2_1;
+NAN_METHOD(GetHostTimer) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  NOCL_UNWRAP(device, NoCLDeviceId, info[0]);
+  bool asBigInt = ARG_EXISTS(1) && Nan::To<bool>(info[1]).FromJust();
+
+  cl_ulong hostTimestamp = 0;
+  CHECK_ERR(NOCL_CL(clGetHostTimer)(device->getRaw(), &hostTimestamp));
+
+  info.GetReturnValue().Set(timestampToJS(hostTimestamp, asBigInt));
+}
 #endif
 
 namespace Device {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "getDeviceIDs", GetDeviceIDs);
-  Nan::SetMethod(target, "getDeviceInfo", GetDeviceInfo);
+  NOCL_SET_METHOD(target, "getDeviceIDs", GetDeviceIDs);
+  NOCL_SET_METHOD(target, "getDeviceInfo", GetDeviceInfo);
 #ifdef CL_VERSION_1_2
-  Nan::SetMethod(target, "createSubDevices", CreateSubDevices);
-  Nan::SetMethod(target, "retainDevice", RetainDevice);
-  Nan::SetMethod(target, "releaseDevice", ReleaseDevice);
+  NOCL_SET_METHOD(target, "createSubDevices", CreateSubDevices);
+  NOCL_SET_METHOD(target, "retainDevice", RetainDevice);
+  NOCL_SET_METHOD(target, "releaseDevice", ReleaseDevice);
 #endif
 #ifdef CL_VERSION_2_1
-  // @TODO Nan::SetMethod(target, "getDeviceAndHostTimer", GetDeviceAndHostTimer);
-  // @TODO Nan::SetMethod(target, "getHostTimer", GetHostTimer);
+  NOCL_SET_METHOD(target, "getDeviceAndHostTimer", GetDeviceAndHostTimer);
+  NOCL_SET_METHOD(target, "getHostTimer", GetHostTimer);
 #endif
 }
 } // namespace Device
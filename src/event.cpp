@@ -1,5 +1,8 @@
 #include "event.h"
 #include "types.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 namespace opencl {
 
@@ -15,7 +18,7 @@ NAN_METHOD(WaitForEvents) {
   Local<Array> js_events = Local<Array>::Cast(info[0]);
   NOCL_TO_ARRAY(events, js_events, NoCLEvent);
 
-  CHECK_ERR(::clWaitForEvents(
+  CHECK_ERR(NOCL_CL(clWaitForEvents)(
     (cl_uint) events.size(), NOCL_TO_CL_ARRAY(events, NoCLEvent)));
 
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
@@ -41,37 +44,37 @@ NAN_METHOD(GetEventInfo) {
     case CL_EVENT_COMMAND_QUEUE:
     {
       cl_command_queue val;
-      CHECK_ERR(::clGetEventInfo(ev->getRaw(),param_name,sizeof(cl_command_queue), &val, NULL))
-      CHECK_ERR(::clRetainCommandQueue(val))
+      CHECK_ERR(NOCL_CL(clGetEventInfo)(ev->getRaw(),param_name,sizeof(cl_command_queue), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainCommandQueue)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLCommandQueue, val));
       return;
     }
     case CL_EVENT_CONTEXT:
     {
       cl_context val;
-      CHECK_ERR(::clGetEventInfo(ev->getRaw(),param_name,sizeof(cl_context), &val, NULL))
-      CHECK_ERR(::clRetainContext(val))
+      CHECK_ERR(NOCL_CL(clGetEventInfo)(ev->getRaw(),param_name,sizeof(cl_context), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainContext)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLContext, val));
       return;
     }
     case CL_EVENT_COMMAND_TYPE:
     {
       cl_command_type val;
-      CHECK_ERR(::clGetEventInfo(ev->getRaw(),param_name,sizeof(cl_command_type), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetEventInfo)(ev->getRaw(),param_name,sizeof(cl_command_type), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_EVENT_COMMAND_EXECUTION_STATUS:
     {
       cl_int val;
-      CHECK_ERR(::clGetEventInfo(ev->getRaw(),param_name,sizeof(cl_int), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetEventInfo)(ev->getRaw(),param_name,sizeof(cl_int), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_EVENT_REFERENCE_COUNT:
     {
       cl_uint val;
-      CHECK_ERR(::clGetEventInfo(ev->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetEventInfo)(ev->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -90,7 +93,7 @@ NAN_METHOD(CreateUserEvent) {
   NOCL_UNWRAP(context, NoCLContext, info[0]);
 
   cl_int err;
-  cl_event uev=::clCreateUserEvent(context->getRaw(), &err);
+  cl_event uev=NOCL_CL(clCreateUserEvent)(context->getRaw(), &err);
   CHECK_ERR(err)
   info.GetReturnValue().Set(NOCL_WRAP(NoCLEvent, uev));
 }
@@ -134,7 +137,7 @@ NAN_METHOD(SetUserEventStatus) {
   NOCL_UNWRAP(ev, NoCLEvent, info[0]);
 
   cl_int exec_status=Nan::To<uint32_t>(info[1]).FromJust();
-  CHECK_ERR(::clSetUserEventStatus(ev->getRaw(),exec_status));
+  CHECK_ERR(NOCL_CL(clSetUserEventStatus)(ev->getRaw(),exec_status));
 
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 }
@@ -154,6 +157,7 @@ NAN_METHOD(GetEventProfilingInfo) {
   NOCL_UNWRAP(ev, NoCLEvent, info[0]);
 
   cl_profiling_info param_name = Nan::To<uint32_t>(info[1]).FromJust();
+  bool asBigInt = ARG_EXISTS(2) && Nan::To<bool>(info[2]).FromJust();
 
   switch(param_name) {
     case CL_PROFILING_COMMAND_QUEUED:
@@ -172,7 +176,16 @@ NAN_METHOD(GetEventProfilingInfo) {
           input_value = ((int64_t) output_values[0]) << 32) | output_values[1];
       */
       cl_ulong val;
-      CHECK_ERR(::clGetEventProfilingInfo(ev->getRaw(),param_name,sizeof(cl_ulong), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetEventProfilingInfo)(ev->getRaw(),param_name,sizeof(cl_ulong), &val, NULL))
+
+      if(asBigInt) {
+#ifdef NOCL_HAS_BIGINT
+        info.GetReturnValue().Set(v8::BigInt::NewFromUnsigned(v8::Isolate::GetCurrent(), val));
+        return;
+#else
+        return Nan::ThrowTypeError("BigInt is not supported by this version of Node");
+#endif
+      }
 
       Local<Array> arr = Nan::New<Array>(2);
       Nan::Set(arr, 0, JS_INT((uint32_t) (val>>32))); // hi
@@ -184,6 +197,129 @@ NAN_METHOD(GetEventProfilingInfo) {
   return Nan::ThrowError(JS_STR(opencl::getExceptionMessage(CL_INVALID_VALUE)));
 }
 
+// getEventStatuses(events, out)
+// Fills out[i], an Int32Array, with the CL_EVENT_COMMAND_EXECUTION_STATUS of
+// events[i]: CL_QUEUED, CL_SUBMITTED, CL_RUNNING, CL_COMPLETE or a negative
+// error code. Returns the number of events which are complete or failed.
+NAN_METHOD(GetEventStatuses) {
+  Nan::HandleScope scope;
+  REQ_ARGS(2);
+
+  // Arg 0
+  std::vector<NoCLEvent *> events;
+  if(!info[0]->IsArray())
+    THROW_ERR(CL_INVALID_VALUE);
+  Local<Array> js_events = Local<Array>::Cast(info[0]);
+  NOCL_TO_ARRAY(events, js_events, NoCLEvent);
+
+  // Arg 1
+  if(!info[1]->IsInt32Array())
+    return Nan::ThrowTypeError("out must be an Int32Array");
+  void *out = nullptr;
+  size_t len = 0;
+  getPtrAndLen(info[1], out, len);
+  if(len < events.size() * sizeof(cl_int))
+    THROW_ERR(CL_INVALID_VALUE);
+
+  uint32_t completed = 0;
+  cl_int *statuses = static_cast<cl_int*>(out);
+  for(size_t i = 0; i < events.size(); i++) {
+    CHECK_ERR(NOCL_CL(clGetEventInfo)(events[i]->getRaw(), CL_EVENT_COMMAND_EXECUTION_STATUS,
+      sizeof(cl_int), &statuses[i], nullptr));
+    if(statuses[i] <= CL_COMPLETE)
+      completed++;
+  }
+
+  info.GetReturnValue().Set(JS_INT(completed));
+}
+
+// getEventsProfiling(events, out)
+// Fills out[4 * i .. 4 * i + 3] with the QUEUED, SUBMIT, START and END
+// timestamps of events[i], out being a BigUint64Array or a Float64Array
+// (exact up to 2^53 ns). Events without profiling info, e.g. not complete yet
+// or from a queue without profiling, get zeros. Returns the number of events
+// whose timestamps were filled.
+NAN_METHOD(GetEventsProfiling) {
+  Nan::HandleScope scope;
+  REQ_ARGS(2);
+
+  // Arg 0
+  std::vector<NoCLEvent *> events;
+  if(!info[0]->IsArray())
+    THROW_ERR(CL_INVALID_VALUE);
+  Local<Array> js_events = Local<Array>::Cast(info[0]);
+  NOCL_TO_ARRAY(events, js_events, NoCLEvent);
+
+  // Arg 1
+  bool isDouble = info[1]->IsFloat64Array();
+  bool isBigInt = false;
+#ifdef NOCL_HAS_BIGINT
+  isBigInt = info[1]->IsBigUint64Array();
+#endif
+  if(!isDouble && !isBigInt)
+    return Nan::ThrowTypeError("out must be a BigUint64Array or a Float64Array");
+  void *out = nullptr;
+  size_t len = 0;
+  getPtrAndLen(info[1], out, len);
+  if(len < events.size() * 4 * sizeof(cl_ulong))
+    THROW_ERR(CL_INVALID_VALUE);
+
+  static const cl_profiling_info params[4] = {
+    CL_PROFILING_COMMAND_QUEUED, CL_PROFILING_COMMAND_SUBMIT,
+    CL_PROFILING_COMMAND_START, CL_PROFILING_COMMAND_END
+  };
+  uint32_t filled = 0;
+  for(size_t i = 0; i < events.size(); i++) {
+    cl_ulong t[4] = { 0, 0, 0, 0 };
+    cl_int err = CL_SUCCESS;
+    for(int j = 0; j < 4 && err == CL_SUCCESS; j++)
+      err = NOCL_CL(clGetEventProfilingInfo)(events[i]->getRaw(), params[j], sizeof(cl_ulong), &t[j], nullptr);
+    if(err == CL_PROFILING_INFO_NOT_AVAILABLE) {
+      t[0] = t[1] = t[2] = t[3] = 0;
+    } else if(err != CL_SUCCESS) {
+      THROW_ERR(err);
+    } else {
+      filled++;
+    }
+
+    for(int j = 0; j < 4; j++) {
+      if(isDouble)
+        static_cast<double*>(out)[4 * i + j] = static_cast<double>(t[j]);
+      else
+        static_cast<uint64_t*>(out)[4 * i + j] = t[j];
+    }
+  }
+
+  info.GetReturnValue().Set(JS_INT(filled));
+}
+
+class NoCLEventWorker;
+
+// Link between a driver callback and the loop of the thread which set it.
+// The driver thread sends through async under mutex; once the environment
+// of that thread goes away, the cleanup hook closes async and the callback
+// is orphaned. Freed by the last of the driver callback and the loop side.
+struct EventNotification {
+  std::mutex mutex;
+  uv_async_t *async; // null once closed
+  NoCLEventWorker *worker;
+  int status;
+  std::atomic<int> refs;
+};
+
+static void unrefNotification(EventNotification *n) {
+  if(--n->refs == 0)
+    delete n;
+}
+
+static void closeNotification(EventNotification *n) {
+  std::lock_guard<std::mutex> lock(n->mutex);
+  uv_close((uv_handle_t*) n->async, [](uv_handle_t *handle) {
+    delete (uv_async_t*) handle;
+  });
+  n->async = nullptr;
+}
+
 class NoCLEventWorker : public AsyncWorker
 {
 public:
@@ -192,16 +328,19 @@ public:
   {
     SaveToPersistent(kIndex,  userData);
     SaveToPersistent(kIndex+1,noCLEvent);
-    this->async = new uv_async_t;
-    this->async->data = (void*) this;
-    uv_async_init(uv_default_loop(), this->async, (uv_async_cb) dispatched_async_uv_callback);
-  }
-
-  ~NoCLEventWorker() {
-    uv_close((uv_handle_t*)this->async, &delete_async_handle);
+    notification = new EventNotification();
+    notification->worker = this;
+    notification->status = 0;
+    notification->refs = 2;
+    notification->async = new uv_async_t;
+    notification->async->data = (void*) notification;
+    // the loop of the thread (main or worker) which set the callback
+    uv_async_init(Nan::GetCurrentEventLoop(), notification->async, (uv_async_cb) dispatched_async_uv_callback);
+    addCleanupHook(orphan, notification);
   }
 
-  uv_async_t *async;
+  // user_data of the driver callback
+  EventNotification *notification;
 
   void CallBackIsDone(int status) {
     mCLCallbackStatus = status;
@@ -227,32 +366,209 @@ public:
     callback->Call(3, argv, async_resource);
   }
 
+  // The callback could not be set: drops it, as if the driver had run it
+  // in an environment already gone
+  static void discard(EventNotification *n) {
+    removeCleanupHook(orphan, n);
+    orphan(n);
+    unrefNotification(n);
+  }
+
 protected:
   static const uint32_t kIndex = 0;
-  static void delete_async_handle(uv_handle_t *handle);
   // The callback invoked by the call to uv_async_send() in notifyCB.
   // Invoked on the main thread, so it's safe to call AsyncQueueWorker.
   static void dispatched_async_uv_callback(uv_async_t*);
+  // Cleanup hook of the environment, while the callback is not dispatched
+  static void orphan(void *arg);
 
 private:
   int mCLCallbackStatus = 0;
 };
 
-void NoCLEventWorker::delete_async_handle(uv_handle_t *handle) {
-  delete (uv_async_t *) handle;
-}
-
 void NoCLEventWorker::dispatched_async_uv_callback(uv_async_t *req) {
-  NoCLEventWorker* asyncCB = static_cast<NoCLEventWorker*>(req->data);
+  EventNotification *n = static_cast<EventNotification*>(req->data);
+  removeCleanupHook(orphan, n);
+  NoCLEventWorker* asyncCB = n->worker;
+  closeNotification(n);
+  asyncCB->CallBackIsDone(n->status);
+  unrefNotification(n);
   AsyncQueueWorker(asyncCB);
 }
 
+void NoCLEventWorker::orphan(void *arg) {
+  EventNotification *n = static_cast<EventNotification*>(arg);
+  closeNotification(n);
+  delete n->worker;
+  unrefNotification(n);
+}
+
 // callback invoked off the main thread by clSetEventCallback
 void CL_CALLBACK notifyCB (cl_event event, cl_int event_command_exec_status, void *user_data) {
-  NoCLEventWorker* asyncCB = static_cast<NoCLEventWorker*>(user_data);
-  asyncCB->CallBackIsDone(event_command_exec_status);
-  // send a message to the main thread to safely invoke the JS callback
-  uv_async_send(asyncCB->async);
+  EventNotification *n = static_cast<EventNotification*>(user_data);
+  {
+    std::lock_guard<std::mutex> lock(n->mutex);
+    // send a message to the main thread to safely invoke the JS callback
+    if(n->async) {
+      n->status = event_command_exec_status;
+      uv_async_send(n->async);
+    }
+  }
+  unrefNotification(n);
+}
+
+// Poll completion mode (setCompletionMode). A driver callback reaches JS
+// through a driver thread, uv_async_send and a thread pool round trip, which
+// is long for microsecond kernels. Instead, a check handle of the loop of the
+// thread reads the status of the pending events after each poll phase, and
+// an idle handle keeps that poll phase from blocking while events are
+// pending. Events still pending after the spin time go back to driver
+// callbacks, so the loop sleeps again when the queues are idle. The spin
+// time adapts to twice the average time polled events take to complete,
+// up to spin_us, and halves each time an event outlasts it.
+struct PolledCallback {
+  cl_event event; // retained
+  cl_int statusType;
+  Nan::Callback *callback;
+  Nan::Persistent<Object> userData;
+  Nan::Persistent<Object> eventObject;
+  uint64_t since;
+};
+
+struct CompletionPoller {
+  uv_idle_t idle;
+  uv_check_t check;
+  bool enabled;
+  uint64_t spin;    // bound of the spin time, nanoseconds
+  uint64_t bound;   // current spin time
+  uint64_t latency; // moving average of the time to complete, 0 until known
+  std::vector<PolledCallback*> pending;
+};
+
+// One per thread, as its event loop
+static thread_local CompletionPoller *poller = nullptr;
+
+static void callbackWithDriver(PolledCallback *p) {
+  Nan::HandleScope scope;
+  NoCLEventWorker *asyncCB = new NoCLEventWorker(p->callback,
+    Nan::New(p->userData), Nan::New(p->eventObject));
+  if(::clSetEventCallback(p->event, p->statusType, notifyCB, asyncCB->notification) != CL_SUCCESS) {
+    // the event is broken: report it right away, as a failed command
+    notifyCB(p->event, CL_INVALID_EVENT, asyncCB->notification);
+  }
+}
+
+static void releasePolled(PolledCallback *p) {
+  p->userData.Reset();
+  p->eventObject.Reset();
+  ::clReleaseEvent(p->event);
+  delete p;
+}
+
+static void idleNoop(uv_idle_t*) {}
+
+static void pollCompletions(uv_check_t *handle) {
+  CompletionPoller *self = static_cast<CompletionPoller*>(handle->data);
+  uint64_t now = uv_hrtime();
+
+  // callbacks may set new ones: work on the current list
+  std::vector<PolledCallback*> pending;
+  pending.swap(self->pending);
+  std::vector<std::pair<PolledCallback*, cl_int> > done;
+  for(PolledCallback *p : pending) {
+    cl_int status = CL_QUEUED;
+    if(::clGetEventInfo(p->event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, nullptr) != CL_SUCCESS)
+      status = CL_INVALID_EVENT;
+    if(status <= p->statusType) {
+      uint64_t took = now - p->since;
+      self->latency = self->latency ? self->latency - self->latency / 8 + took / 8 : took;
+      self->bound = std::min(self->spin, 2 * self->latency);
+      done.push_back(std::make_pair(p, status));
+    } else if(now - p->since > self->bound) {
+      // down to a single check per event, which still measures the fast ones
+      self->bound /= 2;
+      callbackWithDriver(p);
+      releasePolled(p);
+    } else {
+      self->pending.push_back(p);
+    }
+  }
+
+  if(!done.empty()) {
+    Nan::HandleScope scope;
+    Nan::AsyncResource resource("nodeOpenCL:PolledCallback");
+    for(auto &d : done) {
+      PolledCallback *p = d.first;
+      Local<Value> argv[] = {
+        Nan::New(p->userData),
+        JS_INT(d.second),
+        Nan::New(p->eventObject)
+      };
+      p->callback->Call(3, argv, &resource);
+      delete p->callback;
+      releasePolled(p);
+    }
+  }
+
+  // idle queues: let the loop block again
+  if(self->pending.empty()) {
+    uv_idle_stop(&self->idle);
+    uv_check_stop(&self->check);
+  }
+}
+
+static void releasePoller(void *arg) {
+  CompletionPoller *p = static_cast<CompletionPoller*>(arg);
+  for(PolledCallback *c : p->pending) {
+    delete c->callback;
+    releasePolled(c);
+  }
+  p->pending.clear();
+  uv_idle_stop(&p->idle);
+  uv_check_stop(&p->check);
+  // freed once both handles are closed, in order
+  uv_close((uv_handle_t*) &p->idle, nullptr);
+  uv_close((uv_handle_t*) &p->check, [](uv_handle_t *handle) {
+    delete static_cast<CompletionPoller*>(handle->data);
+  });
+  if(poller == p)
+    poller = nullptr;
+}
+
+// setCompletionMode(mode, spin_us)
+// mode is "callback" (the default) or "poll", for the event callbacks set
+// from now on by this thread. spin_us (default 1000) bounds the adaptive
+// polling of one event before it falls back to a driver callback.
+NAN_METHOD(SetCompletionMode) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  Nan::Utf8String mode(info[0]);
+  bool poll = std::string(*mode) == "poll";
+  if(!poll && std::string(*mode) != "callback")
+    THROW_ERR(CL_INVALID_VALUE);
+  double spinUs = ARG_EXISTS(1) ? Nan::To<double>(info[1]).FromJust() : 1000;
+  if(!(spinUs >= 0))
+    THROW_ERR(CL_INVALID_VALUE);
+
+  if(!poller && poll) {
+    poller = new CompletionPoller();
+    uv_loop_t *loop = Nan::GetCurrentEventLoop();
+    uv_idle_init(loop, &poller->idle);
+    uv_check_init(loop, &poller->check);
+    poller->check.data = poller;
+    // handles only keep the loop alive while events are pending
+    uv_unref((uv_handle_t*) &poller->idle);
+    addCleanupHook(releasePoller, poller);
+  }
+  if(poller) {
+    poller->enabled = poll;
+    poller->spin = (uint64_t) (spinUs * 1000);
+    poller->bound = poller->spin;
+    poller->latency = 0;
+  }
+
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 }
 
 NAN_METHOD(SetEventCallback)
@@ -264,9 +580,30 @@ NAN_METHOD(SetEventCallback)
   Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
   Local<Object> userData = info[3].As<Object>();
 
+  if(poller && poller->enabled) {
+    CHECK_ERR(NOCL_CL(clRetainEvent)(event->getRaw()));
+    PolledCallback *p = new PolledCallback();
+    p->event = event->getRaw();
+    p->statusType = callbackStatusType;
+    p->callback = callback;
+    p->userData.Reset(userData);
+    p->eventObject.Reset(info[0].As<Object>());
+    p->since = uv_hrtime();
+    if(poller->pending.empty()) {
+      uv_idle_start(&poller->idle, idleNoop);
+      uv_check_start(&poller->check, pollCompletions);
+    }
+    poller->pending.push_back(p);
+    info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+    return;
+  }
+
   NoCLEventWorker* asyncCB = new NoCLEventWorker(callback,userData,info[0].As<Object>());
 
-  CHECK_ERR(clSetEventCallback(event->getRaw(),callbackStatusType,notifyCB,asyncCB));
+  cl_int err = NOCL_CL(clSetEventCallback)(event->getRaw(),callbackStatusType,notifyCB,asyncCB->notification);
+  if(err != CL_SUCCESS)
+    NoCLEventWorker::discard(asyncCB->notification);
+  CHECK_ERR(err);
 
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 }
@@ -276,14 +613,17 @@ NAN_METHOD(SetEventCallback)
 namespace Event {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "waitForEvents", WaitForEvents);
-  Nan::SetMethod(target, "getEventInfo", GetEventInfo);
-  Nan::SetMethod(target, "createUserEvent", CreateUserEvent);
-  Nan::SetMethod(target, "retainEvent", RetainEvent);
-  Nan::SetMethod(target, "releaseEvent", ReleaseEvent);
-  Nan::SetMethod(target, "setUserEventStatus", SetUserEventStatus);
-  Nan::SetMethod(target, "setEventCallback", SetEventCallback);
-  Nan::SetMethod(target, "getEventProfilingInfo", GetEventProfilingInfo);
+  NOCL_SET_METHOD(target, "waitForEvents", WaitForEvents);
+  NOCL_SET_METHOD(target, "getEventInfo", GetEventInfo);
+  NOCL_SET_METHOD(target, "getEventStatuses", GetEventStatuses);
+  NOCL_SET_METHOD(target, "createUserEvent", CreateUserEvent);
+  NOCL_SET_METHOD(target, "retainEvent", RetainEvent);
+  NOCL_SET_METHOD(target, "releaseEvent", ReleaseEvent);
+  NOCL_SET_METHOD(target, "setUserEventStatus", SetUserEventStatus);
+  NOCL_SET_METHOD(target, "setEventCallback", SetEventCallback);
+  NOCL_SET_METHOD(target, "setCompletionMode", SetCompletionMode);
+  NOCL_SET_METHOD(target, "getEventProfilingInfo", GetEventProfilingInfo);
+  NOCL_SET_METHOD(target, "getEventsProfiling", GetEventsProfiling);
 }
 } // namespace Event
 
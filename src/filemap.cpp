@@ -0,0 +1,323 @@
+#include "filemap.h"
+#include "types.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace opencl {
+
+// A region of a file mapped in memory. The mapping itself starts on an
+// allocation granularity boundary, data points to the requested offset.
+struct FileMapping {
+  void *base;
+  size_t length;
+  char *data;
+  size_t size;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+};
+
+// Maps size bytes of path from offset (up to the end of the file when size is
+// 0). A writable mapping is shared with the file, which is created or
+// extended as needed. A read-only one is private: writes to it, e.g. by a
+// device using it as a USE_HOST_PTR buffer, never reach the file.
+// Returns 0 or a system error code.
+static int mapFile(const char *path, bool writable, size_t offset, size_t size, FileMapping &m) {
+#ifdef _WIN32
+  HANDLE file = ::CreateFileA(path, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                              FILE_SHARE_READ, nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return ::GetLastError();
+
+  LARGE_INTEGER fileSize;
+  if(!::GetFileSizeEx(file, &fileSize)) {
+    int err = ::GetLastError();
+    ::CloseHandle(file);
+    return err;
+  }
+  if(!size && !writable && (size_t) fileSize.QuadPart > offset)
+    size = (size_t) fileSize.QuadPart - offset;
+  if(!size || (!writable && offset + size > (size_t) fileSize.QuadPart)) {
+    ::CloseHandle(file);
+    return ERROR_HANDLE_EOF;
+  }
+
+  // CreateFileMapping() extends the file to the size of a writable mapping
+  ULARGE_INTEGER end;
+  end.QuadPart = offset + size;
+  HANDLE mapping = ::CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_WRITECOPY,
+                                        writable ? end.HighPart : 0, writable ? end.LowPart : 0,
+                                        nullptr);
+  if(!mapping) {
+    int err = ::GetLastError();
+    ::CloseHandle(file);
+    return err;
+  }
+
+  SYSTEM_INFO si;
+  ::GetSystemInfo(&si);
+  ULARGE_INTEGER aligned;
+  aligned.QuadPart = offset / si.dwAllocationGranularity * si.dwAllocationGranularity;
+  size_t delta = offset - (size_t) aligned.QuadPart;
+  void *base = ::MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_COPY,
+                               aligned.HighPart, aligned.LowPart, size + delta);
+  if(!base) {
+    int err = ::GetLastError();
+    ::CloseHandle(mapping);
+    ::CloseHandle(file);
+    return err;
+  }
+  m.file = file;
+  m.mapping = mapping;
+#else
+  int fd = ::open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if(fd < 0)
+    return errno;
+
+  struct stat st;
+  if(::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    return err;
+  }
+  size_t fileSize = (size_t) st.st_size;
+  if(!size && !writable && fileSize > offset)
+    size = fileSize - offset;
+  // touching a page past the end of a file raises SIGBUS
+  if(!size || (!writable && offset + size > fileSize)) {
+    ::close(fd);
+    return EINVAL;
+  }
+  if(writable && offset + size > fileSize && ::ftruncate(fd, (off_t) (offset + size)) != 0) {
+    int err = errno;
+    ::close(fd);
+    return err;
+  }
+
+  size_t page = (size_t) ::sysconf(_SC_PAGESIZE);
+  size_t aligned = offset / page * page;
+  size_t delta = offset - aligned;
+  void *base = ::mmap(nullptr, size + delta, PROT_READ | PROT_WRITE,
+                      writable ? MAP_SHARED : MAP_PRIVATE, fd, (off_t) aligned);
+  int err = errno;
+  ::close(fd);
+  if(base == MAP_FAILED)
+    return err;
+#ifdef MADV_SEQUENTIAL
+  ::madvise(base, size + delta, MADV_SEQUENTIAL);
+#endif
+#endif
+
+  m.base = base;
+  m.length = size + delta;
+  m.data = static_cast<char*>(base) + delta;
+  m.size = size;
+  return 0;
+}
+
+static void unmapFile(FileMapping *m) {
+#ifdef _WIN32
+  ::UnmapViewOfFile(m->base);
+  ::CloseHandle(m->mapping);
+  ::CloseHandle(m->file);
+#else
+  ::munmap(m->base, m->length);
+#endif
+  delete m;
+}
+
+static void throwMapError(int err, const char *path) {
+#ifdef _WIN32
+  Nan::ThrowError(JS_STR(std::string("Cannot map file ") + path +
+                         " (error " + std::to_string(err) + ")"));
+#else
+  Nan::ThrowError(Nan::ErrnoException(err, "mmap", nullptr, path));
+#endif
+}
+
+static void CL_CALLBACK unmapOnRelease(cl_mem /* memobj */, void *user_data) {
+  unmapFile(static_cast<FileMapping*>(user_data));
+}
+
+static void CL_CALLBACK unmapOnComplete(cl_event /* event */, cl_int /* status */, void *user_data) {
+  unmapFile(static_cast<FileMapping*>(user_data));
+}
+
+// Whether every device of ctx is a CPU, i.e. can work on host memory in place
+static bool cpuOnlyContext(cl_context ctx) {
+  size_t n = 0;
+  if(::clGetContextInfo(ctx, CL_CONTEXT_DEVICES, 0, nullptr, &n) != CL_SUCCESS || !n)
+    return false;
+  std::vector<cl_device_id> devices(n / sizeof(cl_device_id));
+  if(::clGetContextInfo(ctx, CL_CONTEXT_DEVICES, n, devices.data(), nullptr) != CL_SUCCESS)
+    return false;
+  for(cl_device_id device : devices) {
+    cl_device_type type;
+    if(::clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, nullptr) != CL_SUCCESS ||
+       !(type & CL_DEVICE_TYPE_CPU))
+      return false;
+  }
+  return true;
+}
+
+// Unmaps the file once the transfer behind event is done. The mapping must
+// not be touched by the caller afterwards.
+static cl_int unmapWhenComplete(cl_command_queue q, cl_event event, FileMapping *m) {
+  cl_int ret = ::clSetEventCallback(event, CL_COMPLETE, unmapOnComplete, m);
+  if(ret != CL_SUCCESS) {
+    ::clWaitForEvents(1, &event);
+    unmapFile(m);
+    return ret;
+  }
+  // the callback only fires once the commands reach the device
+  return ::clFlush(q);
+}
+
+// createBufferFromFile(context, path, flags)
+NAN_METHOD(CreateBufferFromFile) {
+  Nan::HandleScope scope;
+  REQ_ARGS(3);
+
+  // Arg 0
+  NOCL_UNWRAP(context, NoCLContext, info[0]);
+
+  // Arg 1
+  REQ_STR_ARG(1, path);
+
+  // Arg 2
+  cl_mem_flags flags = Nan::To<uint32_t>(info[2]).FromJust();
+
+  FileMapping *m = new FileMapping();
+  int err = mapFile(*path, false, 0, 0, *m);
+  if(err) {
+    delete m;
+    return throwMapError(err, *path);
+  }
+
+  // CPU devices use the mapping in place, others get a copy (which the
+  // runtime may upload straight from the page cache)
+  if(!(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR))) {
+    if(!(flags & CL_MEM_ALLOC_HOST_PTR) && cpuOnlyContext(context->getRaw()))
+      flags |= CL_MEM_USE_HOST_PTR;
+    else
+      flags |= CL_MEM_COPY_HOST_PTR;
+  }
+
+  cl_int ret = CL_SUCCESS;
+  cl_mem mem = NOCL_CL(clCreateBuffer)(context->getRaw(), flags, m->size, m->data, &ret);
+  if(ret != CL_SUCCESS || !(flags & CL_MEM_USE_HOST_PTR))
+    unmapFile(m);
+  else
+    NOCL_CL(clSetMemObjectDestructorCallback)(mem, unmapOnRelease, m);
+  CHECK_ERR(ret);
+
+  info.GetReturnValue().Set(NOCL_WRAP(NoCLMem, mem));
+}
+
+// Common part of the file transfers:
+// (command_queue, buffer, path, fileOffset, size, bufferOffset, event_wait_list, generate_event)
+static void enqueueFileTransfer(const Nan::FunctionCallbackInfo<v8::Value> &info, bool write) {
+  Nan::HandleScope scope;
+  REQ_ARGS(3);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  // Arg 1
+  NOCL_UNWRAP(buffer, NoCLMem, info[1]);
+
+  // Arg 2
+  REQ_STR_ARG(2, path);
+
+  size_t fileOffset, size, offset;
+  NOCL_TO_SIZE_T(fileOffset, info[3]);
+  NOCL_TO_SIZE_T(size, info[4]);
+  NOCL_TO_SIZE_T(offset, info[5]);
+
+  std::vector<NoCLEvent*> cl_events;
+  if(ARG_EXISTS(6)) {
+    Local<Array> js_events = Local<Array>::Cast(info[6]);
+    NOCL_TO_ARRAY(cl_events, js_events, NoCLEvent);
+  }
+  bool generateEvent = ARG_EXISTS(7) && Nan::To<bool>(info[7]).FromJust();
+
+  // a read defaults to the rest of the buffer, a write to the rest of the file
+  if(!size && !write) {
+    size_t memSize = 0;
+    CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(buffer->getRaw(), CL_MEM_SIZE, sizeof(size_t), &memSize, nullptr));
+    if(offset >= memSize)
+      THROW_ERR(CL_INVALID_VALUE);
+    size = memSize - offset;
+  }
+
+  FileMapping *m = new FileMapping();
+  int err = mapFile(*path, !write, fileOffset, size, *m);
+  if(err) {
+    delete m;
+    return throwMapError(err, *path);
+  }
+
+  std::vector<cl_event> wait_list = NoCLEvent::toCLArray(cl_events);
+  cl_event event = nullptr;
+  cl_int ret;
+  if(write) {
+    ret = NOCL_CL(clEnqueueWriteBuffer)(q->getRaw(), buffer->getRaw(), CL_FALSE, offset, m->size, m->data,
+                                 (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr,
+                                 &event);
+  }
+  else {
+    ret = NOCL_CL(clEnqueueReadBuffer)(q->getRaw(), buffer->getRaw(), CL_FALSE, offset, m->size, m->data,
+                                (cl_uint) wait_list.size(), wait_list.size() ? wait_list.data() : nullptr,
+                                &event);
+  }
+  if(ret != CL_SUCCESS) {
+    unmapFile(m);
+    THROW_ERR(ret);
+  }
+
+  ret = unmapWhenComplete(q->getRaw(), event, m);
+  if(ret != CL_SUCCESS) {
+    NOCL_CL(clReleaseEvent)(event);
+    THROW_ERR(ret);
+  }
+
+  if(generateEvent) {
+    info.GetReturnValue().Set(NOCL_WRAP(NoCLEvent, event));
+  } else {
+    NOCL_CL(clReleaseEvent)(event);
+    info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+  }
+}
+
+// enqueueWriteBufferFromFile(command_queue, buffer, path, fileOffset, size, bufferOffset,
+//                            event_wait_list, generate_event)
+NAN_METHOD(EnqueueWriteBufferFromFile) {
+  enqueueFileTransfer(info, true);
+}
+
+// enqueueReadBufferToFile(command_queue, buffer, path, fileOffset, size, bufferOffset,
+//                         event_wait_list, generate_event)
+NAN_METHOD(EnqueueReadBufferToFile) {
+  enqueueFileTransfer(info, false);
+}
+
+namespace FileMap {
+NAN_MODULE_INIT(init)
+{
+  NOCL_SET_METHOD(target, "createBufferFromFile", CreateBufferFromFile);
+  NOCL_SET_METHOD(target, "enqueueWriteBufferFromFile", EnqueueWriteBufferFromFile);
+  NOCL_SET_METHOD(target, "enqueueReadBufferToFile", EnqueueReadBufferToFile);
+}
+} // namespace FileMap
+
+} // namespace opencl
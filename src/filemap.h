@@ -0,0 +1,14 @@
+#ifndef FILEMAP_H_
+#define FILEMAP_H_
+
+#include "common.h"
+
+namespace opencl {
+
+namespace FileMap {
+NAN_MODULE_INIT(init);
+} // namespace FileMap
+
+} // namespace opencl
+
+#endif // FILEMAP_H_
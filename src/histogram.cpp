@@ -0,0 +1,93 @@
+#include "histogram.h"
+#include <algorithm>
+#include <sstream>
+
+namespace opencl {
+
+static const unsigned kLinearBuckets = 64;
+static const unsigned kSubBuckets = 32;
+
+static int highestBit(uint64_t v) {
+  int n = 0;
+  while(v >>= 1)
+    n++;
+  return n;
+}
+
+static size_t bucketIndex(uint64_t v) {
+  if(v < kLinearBuckets)
+    return (size_t) v;
+  // keep the 5 bits below the leading one
+  int shift = highestBit(v) - 5;
+  uint64_t mantissa = v >> shift;
+  return kLinearBuckets + (shift - 1) * kSubBuckets + (size_t) (mantissa - kSubBuckets);
+}
+
+// Middle of the values falling into the bucket
+static uint64_t bucketValue(size_t i) {
+  if(i < kLinearBuckets)
+    return i;
+  int shift = (int) ((i - kLinearBuckets) / kSubBuckets) + 1;
+  uint64_t mantissa = (i - kLinearBuckets) % kSubBuckets + kSubBuckets;
+  return (mantissa << shift) + ((uint64_t(1) << shift) >> 1);
+}
+
+void Histogram::record(uint64_t value) {
+  size_t i = bucketIndex(value);
+  if(i >= buckets.size())
+    buckets.resize(i + 1, 0);
+  buckets[i]++;
+  min = count ? std::min(min, value) : value;
+  max = count ? std::max(max, value) : value;
+  count++;
+  sum += value;
+}
+
+void Histogram::merge(const Histogram &other) {
+  if(!other.count)
+    return;
+  if(other.buckets.size() > buckets.size())
+    buckets.resize(other.buckets.size(), 0);
+  for(size_t i = 0; i < other.buckets.size(); i++)
+    buckets[i] += other.buckets[i];
+  min = count ? std::min(min, other.min) : other.min;
+  max = count ? std::max(max, other.max) : other.max;
+  count += other.count;
+  sum += other.sum;
+}
+
+void Histogram::reset() {
+  buckets.clear();
+  count = sum = min = max = 0;
+}
+
+uint64_t Histogram::percentile(double percent) const {
+  if(!count)
+    return 0;
+  uint64_t rank = (uint64_t) (percent / 100.0 * count + 0.5);
+  rank = std::max<uint64_t>(1, std::min(rank, count));
+  uint64_t seen = 0;
+  for(size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if(seen >= rank)
+      return std::max(min, std::min(max, bucketValue(i)));
+  }
+  return max;
+}
+
+Local<Object> Histogram::toJS(const std::vector<double> &percentiles) const {
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, JS_STR("count"), JS_SIZE(count));
+  Nan::Set(result, JS_STR("min"), JS_SIZE(min));
+  Nan::Set(result, JS_STR("max"), JS_SIZE(max));
+  Nan::Set(result, JS_STR("mean"), JS_NUM(count ? (double) sum / count : 0));
+  for(double p : percentiles) {
+    // p50, p99, p99.9...
+    std::ostringstream name;
+    name << "p" << p;
+    Nan::Set(result, JS_STR(name.str()), JS_SIZE(percentile(p)));
+  }
+  return result;
+}
+
+} // namespace opencl
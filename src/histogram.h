@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include "common.h"
+
+namespace opencl {
+
+// Latency histogram in the spirit of HdrHistogram: values below 64 get a
+// bucket each, larger ones 32 buckets per power of two, so any percentile is
+// within about 3% of the recorded values. Buckets are allocated up to the
+// largest value seen, a few KB for nanosecond latencies. Not thread safe.
+class Histogram {
+public:
+  Histogram() : count(0), sum(0), min(0), max(0) {}
+
+  void record(uint64_t value);
+  void merge(const Histogram &other);
+  void reset();
+
+  // Value below which the given percentage (0 to 100) of the values fall
+  uint64_t percentile(double percent) const;
+
+  // { count, min, max, mean, p50, ... } for the given percentiles
+  Local<Object> toJS(const std::vector<double> &percentiles) const;
+
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+
+private:
+  std::vector<uint64_t> buckets;
+};
+
+} // namespace opencl
+
+#endif // HISTOGRAM_H_
@@ -0,0 +1,193 @@
+#include "hostmem.h"
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace opencl {
+
+static const size_t kCacheLine = 64;
+static const size_t kHugePage = 2 * 1024 * 1024;
+
+// Live allocations by start address. Each one is referenced by its
+// ArrayBuffer and by every buffer created on top of it with USE_HOST_PTR, and
+// freed when the last of them goes away.
+struct HostAllocation {
+  size_t size;
+  int refs;
+};
+
+static std::mutex allocationsMutex;
+static std::map<char*, HostAllocation> allocations;
+
+static void freeAligned(void *ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+static std::map<char*, HostAllocation>::iterator findAllocation(void *ptr) {
+  char *p = static_cast<char*>(ptr);
+  auto it = allocations.upper_bound(p);
+  if(it == allocations.begin())
+    return allocations.end();
+  --it;
+  return p < it->first + it->second.size ? it : allocations.end();
+}
+
+bool retainHostAllocation(void *ptr) {
+  std::lock_guard<std::mutex> lock(allocationsMutex);
+  auto it = findAllocation(ptr);
+  if(it == allocations.end())
+    return false;
+  it->second.refs++;
+  return true;
+}
+
+void releaseHostAllocation(void *ptr) {
+  void *release = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(allocationsMutex);
+    auto it = findAllocation(ptr);
+    if(it == allocations.end())
+      return;
+    if(--it->second.refs == 0) {
+      release = it->first;
+      allocations.erase(it);
+    }
+  }
+  if(release)
+    freeAligned(release);
+}
+
+// Binds the pages of [ptr, ptr+size) to a NUMA node, before they are touched.
+static bool bindToNode(void *ptr, size_t size, uint32_t node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  static const int kMpolBind = 2;
+  static const size_t kBitsPerLong = 8 * sizeof(unsigned long);
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+  if(node >= 1024)
+    return false;
+  mask[node / kBitsPerLong] |= 1UL << (node % kBitsPerLong);
+  return syscall(SYS_mbind, ptr, size, kMpolBind, mask, (unsigned long) 1024, 0) == 0;
+#else
+  // no NUMA policy API, memory is placed by the OS
+  return true;
+#endif
+}
+
+#if V8_MAJOR_VERSION >= 8
+static void freeHostBuffer(void *data, size_t /* length */, void * /* deleter_data */) {
+  releaseHostAllocation(data);
+}
+#else
+// Externalized ArrayBuffers have no deleter, a weak handle frees the memory
+struct WeakHostBuffer {
+  Nan::Persistent<ArrayBuffer> handle;
+  void *ptr;
+};
+
+static void freeOnGC(const Nan::WeakCallbackInfo<WeakHostBuffer> &data) {
+  WeakHostBuffer *weak = data.GetParameter();
+  releaseHostAllocation(weak->ptr);
+  weak->handle.Reset();
+  delete weak;
+}
+#endif
+
+// allocHostBuffer(bytes, { align, hugePages, numaNode })
+NAN_METHOD(AllocHostBuffer) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  size_t bytes;
+  NOCL_TO_SIZE_T(bytes, info[0]);
+  size_t align = 4096;
+  bool hugePages = false;
+  int32_t numaNode = -1;
+
+  if(ARG_EXISTS(1)) {
+    Local<Object> opts = Nan::To<Object>(info[1]).ToLocalChecked();
+    Local<Value> val = Nan::Get(opts, JS_STR("align")).ToLocalChecked();
+    if(!val->IsUndefined())
+      NOCL_TO_SIZE_T(align, val);
+    val = Nan::Get(opts, JS_STR("hugePages")).ToLocalChecked();
+    if(!val->IsUndefined())
+      hugePages = Nan::To<bool>(val).FromJust();
+    val = Nan::Get(opts, JS_STR("numaNode")).ToLocalChecked();
+    if(!val->IsUndefined())
+      numaNode = Nan::To<int32_t>(val).FromJust();
+  }
+
+  if(!bytes || align < sizeof(void*) || (align & (align - 1)))
+    THROW_ERR(CL_INVALID_VALUE);
+
+  if(hugePages && align < kHugePage)
+    align = kHugePage;
+
+  // whole cache lines (and whole huge pages) so that runtimes accept the
+  // region for zero-copy
+  size_t granule = hugePages ? kHugePage : kCacheLine;
+  size_t size = (bytes + granule - 1) / granule * granule;
+
+  void *ptr = nullptr;
+#ifdef _WIN32
+  ptr = _aligned_malloc(size, align);
+#else
+  if(posix_memalign(&ptr, align, size) != 0)
+    ptr = nullptr;
+#endif
+  if(!ptr)
+    THROW_ERR(CL_OUT_OF_HOST_MEMORY);
+
+#ifdef MADV_HUGEPAGE
+  if(hugePages)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+  if(numaNode >= 0 && !bindToNode(ptr, size, numaNode)) {
+    freeAligned(ptr);
+    return Nan::ThrowError("Cannot bind host memory to the requested NUMA node");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(allocationsMutex);
+    HostAllocation allocation = { size, 1 };
+    allocations[static_cast<char*>(ptr)] = allocation;
+  }
+
+  v8::Isolate *isolate = v8::Isolate::GetCurrent();
+#if V8_MAJOR_VERSION >= 8
+  std::shared_ptr<v8::BackingStore> store = v8::ArrayBuffer::NewBackingStore(
+    ptr, bytes, freeHostBuffer, nullptr);
+  Local<ArrayBuffer> buf = v8::ArrayBuffer::New(isolate, store);
+#else
+  Local<ArrayBuffer> buf = v8::ArrayBuffer::New(isolate, ptr, bytes);
+  WeakHostBuffer *weak = new WeakHostBuffer();
+  weak->handle.Reset(buf);
+  weak->ptr = ptr;
+  weak->handle.SetWeak(weak, freeOnGC, Nan::WeakCallbackType::kParameter);
+#endif
+
+  info.GetReturnValue().Set(buf);
+}
+
+namespace HostMem {
+NAN_MODULE_INIT(init)
+{
+  NOCL_SET_METHOD(target, "allocHostBuffer", AllocHostBuffer);
+}
+} // namespace HostMem
+
+} // namespace opencl
@@ -0,0 +1,22 @@
+#ifndef HOSTMEM_H_
+#define HOSTMEM_H_
+
+#include "common.h"
+
+namespace opencl {
+
+// Takes a reference on the allocHostBuffer() allocation containing ptr so
+// that it outlives its ArrayBuffer. Returns false, without taking anything,
+// when ptr does not come from allocHostBuffer().
+bool retainHostAllocation(void *ptr);
+
+// Gives back a reference taken by retainHostAllocation().
+void releaseHostAllocation(void *ptr);
+
+namespace HostMem {
+NAN_MODULE_INIT(init);
+} // namespace HostMem
+
+} // namespace opencl
+
+#endif // HOSTMEM_H_
@@ -1,4 +1,5 @@
 #include "kernel.h"
+#include "convert.h"
 #include "types.h"
 
 #include <unordered_map>
@@ -21,7 +22,7 @@ NAN_METHOD(CreateKernel) {
   REQ_STR_ARG(1, name)
 
   cl_int ret=CL_SUCCESS;
-  cl_kernel k = ::clCreateKernel(program->getRaw(), (const char*) *name, &ret);
+  cl_kernel k = NOCL_CL(clCreateKernel)(program->getRaw(), (const char*) *name, &ret);
   CHECK_ERR(ret);
 
   info.GetReturnValue().Set(NOCL_WRAP(NoCLKernel, k));
@@ -43,14 +44,14 @@ NAN_METHOD(CreateKernelsInProgram) {
 
   cl_uint numkernels;
 
-  CHECK_ERR(::clCreateKernelsInProgram(program->getRaw(), 0, NULL, &numkernels));
+  CHECK_ERR(NOCL_CL(clCreateKernelsInProgram)(program->getRaw(), 0, NULL, &numkernels));
 
   if (numkernels == 0) {
     THROW_ERR(CL_INVALID_VALUE);
   }
 
   cl_kernel * kernels = new cl_kernel[numkernels];
-  CHECK_ERR(::clCreateKernelsInProgram(program->getRaw(), numkernels, kernels, NULL));
+  CHECK_ERR(NOCL_CL(clCreateKernelsInProgram)(program->getRaw(), numkernels, kernels, NULL));
 
   Local<Array> karr = Nan::New<Array>();
 
@@ -135,7 +136,6 @@ public:
     CONVERT_NUMBER("ulong", cl_ulong, IsNumber, int64_t);
     CONVERT_NUMBER("float", cl_float, IsNumber, double);
     CONVERT_NUMBER("double", cl_double, IsNumber, double);
-    CONVERT_NUMBER("half", cl_half, IsNumber, double);
 
     #undef CONVERT_NUMBER
 
@@ -187,11 +187,38 @@ public:
     CONVERT_VECTS("ulong", cl_ulong, IsNumber, int64_t);
     CONVERT_VECTS("float", cl_float, IsNumber, double);
     CONVERT_VECTS("double", cl_double, IsNumber, double);
-    CONVERT_VECTS("half", cl_half, IsNumber, double);
 
     #undef CONVERT_VECT
     #undef CONVERT_VECTS
 
+    // cl_half holds the bits of a 16-bit float, a plain cast would store
+    // the integer part of the value
+    for (unsigned int n : {1u, 2u, 3u, 4u, 8u, 16u}) {
+      func_t f = [n](const Local<Value>& val) -> std::tuple<size_t, void*, cl_int> {
+        Local<Array> arr;
+        if (n > 1) {
+          if (!val->IsArray()) {
+            return std::tuple<size_t,void*,cl_int>(0, NULL, CL_INVALID_ARG_VALUE);
+          }
+          arr = Local<Array>::Cast(val);
+          if (arr->Length() != n) {
+            return std::tuple<size_t,void*,cl_int>(0, NULL, CL_INVALID_ARG_SIZE);
+          }
+        }
+        cl_half * vvc = new cl_half[n];
+        for (unsigned int i = 0; i < n; ++ i) {
+          Local<Value> v = n > 1 ? Nan::Get(arr, i).ToLocalChecked() : val;
+          if (!v->IsNumber()) {
+            delete[] vvc;
+            return std::tuple<size_t,void*,cl_int>(0, NULL, CL_INVALID_ARG_VALUE);
+          }
+          vvc[i] = floatToHalf((float) Nan::To<double>(v).FromJust());
+        }
+        return std::tuple<size_t,void*,cl_int>(sizeof(cl_half) * n, vvc, 0);
+      };
+      m_converters[n > 1 ? "half" + std::to_string(n) : std::string("half")] = f;
+    }
+
     // add boolean conversion
     m_converters["bool"] = [](const Local<Value>& val) {
         size_t ptr_size = sizeof(cl_bool);
@@ -261,13 +288,13 @@ NAN_METHOD(SetKernelArg) {
   // - CL_KERNEL_ARG_ADDRESS_PRIVATE
   if(!ARG_EXISTS(2)) {
     cl_kernel_arg_address_qualifier adrqual;
-    CHECK_ERR(::clGetKernelArgInfo(k->getRaw(), arg_idx, CL_KERNEL_ARG_ADDRESS_QUALIFIER, sizeof(cl_kernel_arg_address_qualifier), &adrqual, NULL));
+    CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(), arg_idx, CL_KERNEL_ARG_ADDRESS_QUALIFIER, sizeof(cl_kernel_arg_address_qualifier), &adrqual, NULL));
 
     // get typename (for conversion of the JS parameter)
     size_t nchars=0;
-    CHECK_ERR(::clGetKernelArgInfo(k->getRaw(), arg_idx, CL_KERNEL_ARG_TYPE_NAME, 0, NULL, &nchars));
+    CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(), arg_idx, CL_KERNEL_ARG_TYPE_NAME, 0, NULL, &nchars));
     char* tname = new char[nchars];
-    CHECK_ERR(::clGetKernelArgInfo(k->getRaw(), arg_idx, CL_KERNEL_ARG_TYPE_NAME, nchars, tname, NULL));
+    CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(), arg_idx, CL_KERNEL_ARG_TYPE_NAME, nchars, tname, NULL));
     type_name = std::string(tname);
     delete [] tname;
     if (adrqual == CL_KERNEL_ARG_ADDRESS_LOCAL)
@@ -299,13 +326,14 @@ NAN_METHOD(SetKernelArg) {
     if (!info[3]->IsNumber())
       THROW_ERR(CL_INVALID_ARG_VALUE);
     // local buffers are intialized with their size (data = NULL)
-    size_t local_size = Nan::To<int32_t>(info[3]).FromJust();
-    err = ::clSetKernelArg(k->getRaw(), arg_idx, local_size, NULL);
+    size_t local_size;
+    NOCL_TO_SIZE_T(local_size, info[3]);
+    err = NOCL_CL(clSetKernelArg)(k->getRaw(), arg_idx, local_size, NULL);
   } else if ('*' == type_name[type_name.length() - 1] || type_name == "cl_mem"){
     // type must be a buffer (CLMem object)
     NOCL_UNWRAP(mem , NoCLMem, info[3]);
     const void *data = mem->getRaw();
-    err = ::clSetKernelArg(k->getRaw(), arg_idx, sizeof(cl_mem), &data);
+    err = NOCL_CL(clSetKernelArg)(k->getRaw(), arg_idx, sizeof(cl_mem), &data);
   } else if (type_converter.hasType(type_name)) {
     // convert primitive types using the conversion
     // function map (indexed by OpenCL type name)
@@ -313,7 +341,7 @@ NAN_METHOD(SetKernelArg) {
     size_t size;
     std::tie(size, data, err) = type_converter.convert(type_name, info[3]);
     CHECK_ERR(err);
-    err = ::clSetKernelArg(k->getRaw(), arg_idx, size, data);
+    err = NOCL_CL(clSetKernelArg)(k->getRaw(), arg_idx, size, data);
     free(data);
   }
 
@@ -324,7 +352,7 @@ NAN_METHOD(SetKernelArg) {
   else if (type_name == "sampler_t") {
     NOCL_UNWRAP(sw , NoCLSampler, info[3]);
     const void* data = k->getRaw();
-    err = ::clSetKernelArg(k->getRaw(), arg_idx, sizeof(cl_sampler), &data);
+    err = NOCL_CL(clSetKernelArg)(k->getRaw(), arg_idx, sizeof(cl_sampler), &data);
   } else {
     std::string errstr = std::string("Unsupported OpenCL argument type: ") + type_name;
     return Nan::ThrowError(errstr.c_str());
@@ -354,30 +382,30 @@ NAN_METHOD(GetKernelInfo) {
 #endif
     case CL_KERNEL_FUNCTION_NAME: {
       size_t nchars=0;
-      CHECK_ERR(::clGetKernelInfo(k->getRaw(),param_name,0,NULL,&nchars));
+      CHECK_ERR(NOCL_CL(clGetKernelInfo)(k->getRaw(),param_name,0,NULL,&nchars));
       unique_ptr<char[]> name(new char[nchars]);
-      CHECK_ERR(::clGetKernelInfo(k->getRaw(),param_name,nchars,name.get(),NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelInfo)(k->getRaw(),param_name,nchars,name.get(),NULL));
       info.GetReturnValue().Set(JS_STR(name.get()));
       return;
     }
     case CL_KERNEL_NUM_ARGS:
     case CL_KERNEL_REFERENCE_COUNT: {
       cl_uint num=0;
-      CHECK_ERR(::clGetKernelInfo(k->getRaw(),param_name,sizeof(cl_uint),&num, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelInfo)(k->getRaw(),param_name,sizeof(cl_uint),&num, NULL));
       info.GetReturnValue().Set(JS_INT(num));
       return;
     }
     case CL_KERNEL_CONTEXT: {
       cl_context ctx=0;
-      CHECK_ERR(::clGetKernelInfo(k->getRaw(),param_name,sizeof(cl_context),&ctx, NULL));
-      CHECK_ERR(::clRetainContext(ctx))
+      CHECK_ERR(NOCL_CL(clGetKernelInfo)(k->getRaw(),param_name,sizeof(cl_context),&ctx, NULL));
+      CHECK_ERR(NOCL_CL(clRetainContext)(ctx))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLContext, ctx));
       return;
     }
     case CL_KERNEL_PROGRAM: {
       cl_program p=0;
-      CHECK_ERR(::clGetKernelInfo(k->getRaw(),param_name,sizeof(cl_program),&p, NULL));
-      CHECK_ERR(::clRetainProgram(p))
+      CHECK_ERR(NOCL_CL(clGetKernelInfo)(k->getRaw(),param_name,sizeof(cl_program),&p, NULL));
+      CHECK_ERR(NOCL_CL(clRetainProgram)(p))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLProgram, p));
       return;
     }
@@ -405,28 +433,28 @@ NAN_METHOD(GetKernelArgInfo) {
   switch(param_name) {
     case CL_KERNEL_ARG_ADDRESS_QUALIFIER: {
       cl_kernel_arg_address_qualifier num=0;
-      CHECK_ERR(::clGetKernelArgInfo(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_address_qualifier),&num, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_address_qualifier),&num, NULL));
       info.GetReturnValue().Set(JS_INT(num));
       return;
     }
     case CL_KERNEL_ARG_ACCESS_QUALIFIER: {
       cl_kernel_arg_access_qualifier num=0;
-      CHECK_ERR(::clGetKernelArgInfo(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_access_qualifier),&num, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_access_qualifier),&num, NULL));
       info.GetReturnValue().Set(JS_INT(num));
       return;
     }
     case CL_KERNEL_ARG_TYPE_QUALIFIER: {
       cl_kernel_arg_type_qualifier num=0;
-      CHECK_ERR(::clGetKernelArgInfo(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_type_qualifier),&num, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(),arg_idx,param_name,sizeof(cl_kernel_arg_type_qualifier),&num, NULL));
       info.GetReturnValue().Set(JS_INT(num));
       return;
     }
     case CL_KERNEL_ARG_TYPE_NAME:
     case CL_KERNEL_ARG_NAME: {
       size_t nchars=0;
-      CHECK_ERR(::clGetKernelArgInfo(k->getRaw(),arg_idx,param_name,0,NULL,&nchars));
+      CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(),arg_idx,param_name,0,NULL,&nchars));
       unique_ptr<char[]> name(new char[nchars]);
-      CHECK_ERR(::clGetKernelArgInfo(k->getRaw(),arg_idx,param_name,nchars,name.get(),NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelArgInfo)(k->getRaw(),arg_idx,param_name,nchars,name.get(),NULL));
       info.GetReturnValue().Set(JS_STR(name.get()));
       return;
     }
@@ -458,25 +486,25 @@ NAN_METHOD(GetKernelWorkGroupInfo) {
 #endif
     case CL_KERNEL_COMPILE_WORK_GROUP_SIZE: {
       size_t sz[3] = {0,0,0};
-      CHECK_ERR(::clGetKernelWorkGroupInfo(k->getRaw(),d->getRaw(),param_name,3*sizeof(size_t),sz, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelWorkGroupInfo)(k->getRaw(),d->getRaw(),param_name,3*sizeof(size_t),sz, NULL));
       Local<Array> szarr = Nan::New<Array>();
-      Nan::Set(szarr, 0,JS_INT(sz[0]));
-      Nan::Set(szarr, 1,JS_INT(sz[1]));
-      Nan::Set(szarr, 2,JS_INT(sz[2]));
+      Nan::Set(szarr, 0,JS_SIZE(sz[0]));
+      Nan::Set(szarr, 1,JS_SIZE(sz[1]));
+      Nan::Set(szarr, 2,JS_SIZE(sz[2]));
       info.GetReturnValue().Set(szarr);
       return;
     }
     case CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE:
     case CL_KERNEL_WORK_GROUP_SIZE: {
       size_t sz=0;
-      CHECK_ERR(::clGetKernelWorkGroupInfo(k->getRaw(),d->getRaw(),param_name,sizeof(size_t),&sz, NULL));
-      info.GetReturnValue().Set(JS_INT(sz));
+      CHECK_ERR(NOCL_CL(clGetKernelWorkGroupInfo)(k->getRaw(),d->getRaw(),param_name,sizeof(size_t),&sz, NULL));
+      info.GetReturnValue().Set(JS_SIZE(sz));
       return;
     }
     case CL_KERNEL_LOCAL_MEM_SIZE:
     case CL_KERNEL_PRIVATE_MEM_SIZE: {
       cl_ulong sz=0;
-      CHECK_ERR(::clGetKernelWorkGroupInfo(k->getRaw(),d->getRaw(),param_name,sizeof(cl_ulong),&sz, NULL));
+      CHECK_ERR(NOCL_CL(clGetKernelWorkGroupInfo)(k->getRaw(),d->getRaw(),param_name,sizeof(cl_ulong),&sz, NULL));
       /**
         JS Compatibility
 
@@ -530,21 +558,21 @@ NAN_METHOD(GetKernelWorkGroupInfo) {
 namespace Kernel {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "createKernel", CreateKernel);
-  Nan::SetMethod(target, "createKernelsInProgram", CreateKernelsInProgram);
-  Nan::SetMethod(target, "retainKernel", RetainKernel);
-  Nan::SetMethod(target, "releaseKernel", ReleaseKernel);
-  Nan::SetMethod(target, "setKernelArg", SetKernelArg);
-  Nan::SetMethod(target, "getKernelInfo", GetKernelInfo);
-  Nan::SetMethod(target, "getKernelArgInfo", GetKernelArgInfo);
-  Nan::SetMethod(target, "getKernelWorkGroupInfo", GetKernelWorkGroupInfo);
+  NOCL_SET_METHOD(target, "createKernel", CreateKernel);
+  NOCL_SET_METHOD(target, "createKernelsInProgram", CreateKernelsInProgram);
+  NOCL_SET_METHOD(target, "retainKernel", RetainKernel);
+  NOCL_SET_METHOD(target, "releaseKernel", ReleaseKernel);
+  NOCL_SET_METHOD(target, "setKernelArg", SetKernelArg);
+  NOCL_SET_METHOD(target, "getKernelInfo", GetKernelInfo);
+  NOCL_SET_METHOD(target, "getKernelArgInfo", GetKernelArgInfo);
+  NOCL_SET_METHOD(target, "getKernelWorkGroupInfo", GetKernelWorkGroupInfo);
 #ifdef CL_VERSION_2_0
-  // @TODO Nan::SetMethod(target, "setKernelArgSVMPointer", SetKernelArgSVMPointer);
-  // @TODO Nan::SetMethod(target, "setKernelExecInfo", SetKernelExecInfo);
+  // @TODO NOCL_SET_METHOD(target, "setKernelArgSVMPointer", SetKernelArgSVMPointer);
+  // @TODO NOCL_SET_METHOD(target, "setKernelExecInfo", SetKernelExecInfo);
 #endif
 #ifdef CL_VERSION_2_1
-  // @TODO Nan::SetMethod(target, "cloneKernel", CloneKernel);
-  // @TODO Nan::SetMethod(target, "getKernelSubGroupInfo", GetKernelSubGroupInfo);
+  // @TODO NOCL_SET_METHOD(target, "cloneKernel", CloneKernel);
+  // @TODO NOCL_SET_METHOD(target, "getKernelSubGroupInfo", GetKernelSubGroupInfo);
 #endif
 }
 } //namespace Kernel
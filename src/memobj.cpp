@@ -1,6 +1,7 @@
 #include "memobj.h"
 #include "types.h"
 #include "common.h"
+#include "hostmem.h"
 #include <node_buffer.h>
 #include "nanextension.h"
 
@@ -8,6 +9,11 @@ using namespace node;
 
 namespace opencl {
 
+// called by the driver once a buffer using allocHostBuffer() memory is gone
+static void CL_CALLBACK notifyReleaseHostPtr(cl_mem memobj, void *user_data) {
+  releaseHostAllocation(user_data);
+}
+
 // /* Memory Object APIs */
 // extern CL_API_ENTRY cl_mem CL_API_CALL
 // clCreateBuffer(cl_context   /* context */,
@@ -26,7 +32,8 @@ NAN_METHOD(CreateBuffer) {
   cl_mem_flags flags = Nan::To<uint32_t>(info[1]).FromJust();
 
   // Arg 2
-  size_t size = (size_t)Nan::To<int64_t>(info[2]).FromJust();
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[2]);
 
   // Arg 3
   void *host_ptr = NULL;
@@ -41,14 +48,22 @@ NAN_METHOD(CreateBuffer) {
       return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
+  // Memory from allocHostBuffer() is suitably aligned for zero-copy: use it
+  // in place unless told otherwise, and keep it alive as long as the buffer.
+  bool hostAllocated = host_ptr && retainHostAllocation(host_ptr);
+  if(hostAllocated && !(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+    flags |= CL_MEM_USE_HOST_PTR;
+
   cl_int ret=CL_SUCCESS;
-  cl_mem mem = ::clCreateBuffer(context->getRaw(), flags, size, host_ptr, &ret);
-  CHECK_ERR(ret);
+  cl_mem mem = NOCL_CL(clCreateBuffer)(context->getRaw(), flags, size, host_ptr, &ret);
 
-  // if(host_ptr) {
-  //   NoCLAvoidGC* user_data = new NoCLAvoidGC(info[3].As<Object>());
-  //   clSetMemObjectDestructorCallback(mem,notifyFreeClMemObj,user_data);
-  // }
+  if(hostAllocated) {
+    if(ret != CL_SUCCESS || !(flags & CL_MEM_USE_HOST_PTR))
+      releaseHostAllocation(host_ptr);
+    else
+      NOCL_CL(clSetMemObjectDestructorCallback)(mem, notifyReleaseHostPtr, host_ptr);
+  }
+  CHECK_ERR(ret);
 
   info.GetReturnValue().Set(NOCL_WRAP(NoCLMem, mem));
 }
@@ -75,11 +90,11 @@ NAN_METHOD(CreateSubBuffer) {
   if(buffer_create_type==CL_BUFFER_CREATE_TYPE_REGION) {
     Local<Object> obj = Nan::To<Object>(info[3]).ToLocalChecked();
     cl_buffer_region buffer_create_info;
-    buffer_create_info.origin = Nan::To<uint32_t>(Nan::Get(obj, JS_STR("origin")).ToLocalChecked()).FromJust();
-    buffer_create_info.size = Nan::To<uint32_t>(Nan::Get(obj, JS_STR("size")).ToLocalChecked()).FromJust();
+    NOCL_TO_SIZE_T(buffer_create_info.origin, Nan::Get(obj, JS_STR("origin")).ToLocalChecked());
+    NOCL_TO_SIZE_T(buffer_create_info.size, Nan::Get(obj, JS_STR("size")).ToLocalChecked());
 
     cl_int ret=CL_SUCCESS;
-    cl_mem mem = ::clCreateSubBuffer(buffer->getRaw(), flags, buffer_create_type, &buffer_create_info, &ret);
+    cl_mem mem = NOCL_CL(clCreateSubBuffer)(buffer->getRaw(), flags, buffer_create_type, &buffer_create_info, &ret);
     CHECK_ERR(ret);
 
     info.GetReturnValue().Set(NOCL_WRAP(NoCLMem, mem));
@@ -120,12 +135,12 @@ NAN_METHOD(CreateImage) {
 
 
   desc.image_type = Nan::Get(obj, JS_STR("type")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("type")).ToLocalChecked()).FromJust();
-  desc.image_width = Nan::Get(obj, JS_STR("width")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("width")).ToLocalChecked()).FromJust();
-  desc.image_height = Nan::Get(obj, JS_STR("height")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("height")).ToLocalChecked()).FromJust();
-  desc.image_depth = Nan::Get(obj, JS_STR("depth")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("depth")).ToLocalChecked()).FromJust();
-  desc.image_array_size = Nan::Get(obj, JS_STR("array_size")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("array_size")).ToLocalChecked()).FromJust();
-  desc.image_row_pitch = Nan::Get(obj, JS_STR("row_pitch")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("row_pitch")).ToLocalChecked()).FromJust();
-  desc.image_slice_pitch = Nan::Get(obj, JS_STR("slice_pitch")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("slice_pitch")).ToLocalChecked()).FromJust();
+  NOCL_TO_SIZE_T(desc.image_width, Nan::Get(obj, JS_STR("width")).ToLocalChecked());
+  NOCL_TO_SIZE_T(desc.image_height, Nan::Get(obj, JS_STR("height")).ToLocalChecked());
+  NOCL_TO_SIZE_T(desc.image_depth, Nan::Get(obj, JS_STR("depth")).ToLocalChecked());
+  NOCL_TO_SIZE_T(desc.image_array_size, Nan::Get(obj, JS_STR("array_size")).ToLocalChecked());
+  NOCL_TO_SIZE_T(desc.image_row_pitch, Nan::Get(obj, JS_STR("row_pitch")).ToLocalChecked());
+  NOCL_TO_SIZE_T(desc.image_slice_pitch, Nan::Get(obj, JS_STR("slice_pitch")).ToLocalChecked());
   Local<Value> buffer_value = Nan::Get(obj, JS_STR("buffer")).ToLocalChecked();
   if (buffer_value->IsObject()) {
     NOCL_UNWRAP(buffer, NoCLMem, buffer_value);
@@ -144,7 +159,7 @@ NAN_METHOD(CreateImage) {
   }
 
   cl_int ret=CL_SUCCESS;
-  cl_mem mem = ::clCreateImage(context->getRaw(), flags, &image_format, &desc, host_ptr, &ret);
+  cl_mem mem = NOCL_CL(clCreateImage)(context->getRaw(), flags, &image_format, &desc, host_ptr, &ret);
   CHECK_ERR(ret);
 
   // if(host_ptr) {
@@ -182,9 +197,12 @@ NAN_METHOD(CreateImage2D) {
   image_format.image_channel_order = Nan::Get(obj, JS_STR("channel_order")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("channel_order")).ToLocalChecked()).FromJust();
   image_format.image_channel_data_type = Nan::Get(obj, JS_STR("channel_data_type")).ToLocalChecked()->IsUndefined() ? 0 : Nan::To<uint32_t>(Nan::Get(obj, JS_STR("channel_data_type")).ToLocalChecked()).FromJust();
 
-  size_t image_width = Nan::To<uint32_t>(info[3]).FromJust();
-  size_t image_height = Nan::To<uint32_t>(info[4]).FromJust();
-  size_t image_row_pitch = Nan::To<uint32_t>(info[5]).FromJust();
+  size_t image_width;
+  NOCL_TO_SIZE_T(image_width, info[3]);
+  size_t image_height;
+  NOCL_TO_SIZE_T(image_height, info[4]);
+  size_t image_row_pitch;
+  NOCL_TO_SIZE_T(image_row_pitch, info[5]);
 
   void *host_ptr = NULL;
 
@@ -198,7 +216,7 @@ NAN_METHOD(CreateImage2D) {
   }
 
   cl_int ret=CL_SUCCESS;
-  cl_mem mem = ::clCreateImage2D(context->getRaw(), flags, &image_format, image_width,image_height,image_row_pitch, host_ptr, &ret);
+  cl_mem mem = NOCL_CL(clCreateImage2D)(context->getRaw(), flags, &image_format, image_width,image_height,image_row_pitch, host_ptr, &ret);
   CHECK_ERR(ret);
 
   // if(host_ptr) {
@@ -257,10 +275,10 @@ NAN_METHOD(GetSupportedImageFormats) {
   cl_mem_object_type image_type = Nan::To<uint32_t>(info[2]).FromJust();
 
   cl_uint numEntries=0;
-  CHECK_ERR(::clGetSupportedImageFormats(context->getRaw(), flags, image_type, 0, NULL, &numEntries));
+  CHECK_ERR(NOCL_CL(clGetSupportedImageFormats)(context->getRaw(), flags, image_type, 0, NULL, &numEntries));
 
   unique_ptr<cl_image_format[]> image_formats(new cl_image_format[numEntries]);
-  CHECK_ERR(::clGetSupportedImageFormats(context->getRaw(), flags, image_type, numEntries, image_formats.get(), NULL));
+  CHECK_ERR(NOCL_CL(clGetSupportedImageFormats)(context->getRaw(), flags, image_type, numEntries, image_formats.get(), NULL));
 
   Local<Array> imageFormats = Nan::New<Array>();
   for (uint32_t i=0; i<numEntries; i++) {
@@ -292,13 +310,13 @@ NAN_METHOD(GetMemObjectInfo) {
   switch(param_name) {
     case CL_MEM_TYPE: {
       cl_mem_object_type val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(cl_mem_object_type), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(cl_mem_object_type), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_MEM_FLAGS: {
       cl_mem_flags val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(cl_mem_flags), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(cl_mem_flags), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -306,36 +324,36 @@ NAN_METHOD(GetMemObjectInfo) {
     case CL_MEM_OFFSET:
     {
       size_t val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(size_t), &val, NULL))
-      info.GetReturnValue().Set(JS_INT(val));
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(size_t), &val, NULL))
+      info.GetReturnValue().Set(JS_SIZE(val));
       return;
     }
     case CL_MEM_MAP_COUNT:
     case CL_MEM_REFERENCE_COUNT:
     {
       cl_uint val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_MEM_HOST_PTR: {
       void* val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(void*), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(void*), &val, NULL))
 
       //info.GetReturnValue().Set(NOCL_WRAP(NoCLMappedPtr, val));
       return;
     }
     case CL_MEM_CONTEXT: {
       cl_context val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(cl_context), &val, NULL))
-      CHECK_ERR(::clRetainContext(val))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(cl_context), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainContext)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLContext, val));
       return;
     }
     case CL_MEM_ASSOCIATED_MEMOBJECT: {
       cl_mem val;
-      CHECK_ERR(::clGetMemObjectInfo(mem->getRaw(),param_name,sizeof(cl_mem), &val, NULL))
-      CHECK_ERR(::clRetainMemObject(val))
+      CHECK_ERR(NOCL_CL(clGetMemObjectInfo)(mem->getRaw(),param_name,sizeof(cl_mem), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainMemObject)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLMem, val));
       return;
     }
@@ -362,7 +380,7 @@ NAN_METHOD(GetImageInfo) {
   switch(param_name) {
     case CL_IMAGE_FORMAT: {
       cl_image_format val;
-      CHECK_ERR(::clGetImageInfo(mem->getRaw(),param_name,sizeof(cl_image_format), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetImageInfo)(mem->getRaw(),param_name,sizeof(cl_image_format), &val, NULL))
       Local<Array> arr=Nan::New<Array>(2);
       Nan::Set(arr, JS_STR("channel_order"), JS_INT(val.image_channel_order));
       Nan::Set(arr, JS_STR("channel_data_type"), JS_INT(val.image_channel_data_type));
@@ -380,15 +398,15 @@ NAN_METHOD(GetImageInfo) {
 #endif
     {
       size_t val;
-      CHECK_ERR(::clGetImageInfo(mem->getRaw(),param_name,sizeof(size_t), &val, NULL))
-      info.GetReturnValue().Set(JS_INT(val));
+      CHECK_ERR(NOCL_CL(clGetImageInfo)(mem->getRaw(),param_name,sizeof(size_t), &val, NULL))
+      info.GetReturnValue().Set(JS_SIZE(val));
       return;
     }
 #ifdef CL_VERSION_1_2
     case CL_IMAGE_BUFFER: {
       cl_mem val;
-      CHECK_ERR(::clGetImageInfo(mem->getRaw(),param_name,sizeof(cl_mem), &val, NULL))
-      CHECK_ERR(::clRetainMemObject(val))
+      CHECK_ERR(NOCL_CL(clGetImageInfo)(mem->getRaw(),param_name,sizeof(cl_mem), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainMemObject)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLMem, val));
       return;
     }
@@ -396,7 +414,7 @@ NAN_METHOD(GetImageInfo) {
     case CL_IMAGE_NUM_SAMPLES:
     {
       cl_uint val;
-      CHECK_ERR(::clGetImageInfo(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetImageInfo)(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -414,18 +432,18 @@ NAN_METHOD(GetImageInfo) {
 namespace MemObj {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "createBuffer", CreateBuffer);
-  Nan::SetMethod(target, "createSubBuffer", CreateSubBuffer);
+  NOCL_SET_METHOD(target, "createBuffer", CreateBuffer);
+  NOCL_SET_METHOD(target, "createSubBuffer", CreateSubBuffer);
 #ifdef CL_VERSION_1_2
-  Nan::SetMethod(target, "createImage", CreateImage);
+  NOCL_SET_METHOD(target, "createImage", CreateImage);
 #elif CL_VERSION_1_1
-  Nan::SetMethod(target, "createImage2D", CreateImage2D);
+  NOCL_SET_METHOD(target, "createImage2D", CreateImage2D);
 #endif
-  Nan::SetMethod(target, "retainMemObject", RetainMemObject);
-  Nan::SetMethod(target, "releaseMemObject", ReleaseMemObject);
-  Nan::SetMethod(target, "getSupportedImageFormats", GetSupportedImageFormats);
-  Nan::SetMethod(target, "getMemObjectInfo", GetMemObjectInfo);
-  Nan::SetMethod(target, "getImageInfo", GetImageInfo);
+  NOCL_SET_METHOD(target, "retainMemObject", RetainMemObject);
+  NOCL_SET_METHOD(target, "releaseMemObject", ReleaseMemObject);
+  NOCL_SET_METHOD(target, "getSupportedImageFormats", GetSupportedImageFormats);
+  NOCL_SET_METHOD(target, "getMemObjectInfo", GetMemObjectInfo);
+  NOCL_SET_METHOD(target, "getImageInfo", GetImageInfo);
 }
 } // namespace MemObj
 
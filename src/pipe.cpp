@@ -32,7 +32,7 @@ NAN_METHOD(CreatePipe) {
 
   cl_int err;
 
-  cl_mem pipe = ::clCreatePipe(
+  cl_mem pipe = NOCL_CL(clCreatePipe)(
     context->getRaw(),
     flags,
     size,
@@ -61,7 +61,7 @@ NAN_METHOD(GetPipeInfo) {
     case CL_PIPE_MAX_PACKETS:
     case CL_PIPE_PACKET_SIZE: {
       cl_uint val;
-      CHECK_ERR(::clGetPipeInfo(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetPipeInfo)(mem->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -76,8 +76,8 @@ namespace Pipe {
 NAN_MODULE_INIT(init)
 {
 #ifdef CL_VERSION_2_0
-  Nan::SetMethod(target, "createPipe", CreatePipe);
-  Nan::SetMethod(target, "getPipeInfo", GetPipeInfo);
+  NOCL_SET_METHOD(target, "createPipe", CreatePipe);
+  NOCL_SET_METHOD(target, "getPipeInfo", GetPipeInfo);
 #endif
 }
 } // namespace Pipe
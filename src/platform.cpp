@@ -12,10 +12,10 @@ NAN_METHOD(GetPlatformIDs) {
   Nan::HandleScope scope;
 
   cl_uint num_entries = 0;
-  CHECK_ERR(::clGetPlatformIDs(0, NULL, &num_entries));
+  CHECK_ERR(NOCL_CL(clGetPlatformIDs)(0, NULL, &num_entries));
 
   unique_ptr<cl_platform_id[]> platforms(new cl_platform_id[num_entries]);
-  CHECK_ERR(::clGetPlatformIDs(num_entries, platforms.get(), NULL));
+  CHECK_ERR(NOCL_CL(clGetPlatformIDs)(num_entries, platforms.get(), NULL));
 
   Local<Array> platformArray = Nan::New<Array>(num_entries);
   for (uint32_t i=0; i<num_entries; i++) {
@@ -41,7 +41,7 @@ NAN_METHOD(GetPlatformInfo) {
   char param_value[1024];
   size_t param_value_size_ret=0;
 
-  CHECK_ERR(::clGetPlatformInfo(platform_id->getRaw(), param_name, 1024, param_value, &param_value_size_ret));
+  CHECK_ERR(NOCL_CL(clGetPlatformInfo)(platform_id->getRaw(), param_name, 1024, param_value, &param_value_size_ret));
 
   // NOTE: Adjust length because API returns NULL terminated string
   info.GetReturnValue().Set(JS_STR(param_value,(int)param_value_size_ret - 1));
@@ -50,8 +50,8 @@ NAN_METHOD(GetPlatformInfo) {
 namespace Platform {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "getPlatformIDs", GetPlatformIDs);
-  Nan::SetMethod(target, "getPlatformInfo", GetPlatformInfo);
+  NOCL_SET_METHOD(target, "getPlatformIDs", GetPlatformIDs);
+  NOCL_SET_METHOD(target, "getPlatformInfo", GetPlatformInfo);
 }
 } // namespace Platform
 
@@ -23,7 +23,7 @@ NAN_METHOD(CreateProgramWithSource) {
   cl_int ret=CL_SUCCESS;
   size_t lengths[]={(size_t) str.length()};
   const char *strings[]={*str};
-  cl_program p=::clCreateProgramWithSource(context->getRaw(), 1, strings, lengths, &ret);
+  cl_program p=NOCL_CL(clCreateProgramWithSource)(context->getRaw(), 1, strings, lengths, &ret);
   CHECK_ERR(ret);
 
   info.GetReturnValue().Set(NOCL_WRAP(NoCLProgram, p));
@@ -87,7 +87,7 @@ NAN_METHOD(CreateProgramWithBinary) {
   }
 
   cl_int ret=CL_SUCCESS;
-  cl_program p=::clCreateProgramWithBinary(
+  cl_program p=NOCL_CL(clCreateProgramWithBinary)(
     context->getRaw(),
     (cl_uint) cl_devices.size(),
     NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
@@ -135,7 +135,7 @@ NAN_METHOD(CreateProgramWithBuiltInKernels) {
   }
 
   cl_int err = CL_SUCCESS;
-  cl_program prg = ::clCreateProgramWithBuiltInKernels(
+  cl_program prg = NOCL_CL(clCreateProgramWithBuiltInKernels)(
     context->getRaw(),
     (cl_uint) cl_devices.size(), NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
     names.front(),
@@ -247,13 +247,13 @@ NAN_METHOD(BuildProgram) {
     Nan::Callback *callback = new Nan::Callback(callbackHandle);
     NoCLProgramWorker* cb = new NoCLProgramWorker(callback,info[4].As<Object>(),info[0].As<Object>());
 
-   err = ::clBuildProgram(p->getRaw(),
+   err = NOCL_CL(clBuildProgram)(p->getRaw(),
           (cl_uint) devices.size(), NOCL_TO_CL_ARRAY(devices, NoCLDeviceId),
           options != NULL ? **options : nullptr,
           notifyPCB, cb);
   }
   else
-    err = ::clBuildProgram(p->getRaw(),
+    err = NOCL_CL(clBuildProgram)(p->getRaw(),
           (cl_uint) devices.size(), NOCL_TO_CL_ARRAY(devices, NoCLDeviceId),
           options != NULL ? **options : nullptr,
           nullptr, nullptr);
@@ -337,7 +337,7 @@ NAN_METHOD(CompileProgram) {
     Nan::Callback *callback = new Nan::Callback(callbackHandle);
     NoCLProgramWorker* cb = new NoCLProgramWorker(callback,info[6].As<Object>(),info[0].As<Object>());
 
-    err = ::clCompileProgram(
+    err = NOCL_CL(clCompileProgram)(
               p->getRaw(),
               (cl_uint) cl_devices.size(), NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
               options != NULL ? **options : nullptr,
@@ -348,7 +348,7 @@ NAN_METHOD(CompileProgram) {
 
 
   else
-    err = ::clCompileProgram(
+    err = NOCL_CL(clCompileProgram)(
               p->getRaw(),
               (cl_uint) cl_devices.size(), NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
               options != NULL ? **options : nullptr,
@@ -420,7 +420,7 @@ NAN_METHOD(LinkProgram) {
     Nan::Callback *callback = new Nan::Callback(callbackHandle);
     NoCLProgramWorker* cb = new NoCLProgramWorker(callback,info[5].As<Object>(),info[0].As<Object>());
 
-    prg = ::clLinkProgram(
+    prg = NOCL_CL(clLinkProgram)(
               ctx->getRaw(),
               (cl_uint) cl_devices.size(), NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
               options != NULL ? **options : nullptr,
@@ -430,7 +430,7 @@ NAN_METHOD(LinkProgram) {
   }
 
   else
-    prg = ::clLinkProgram(
+    prg = NOCL_CL(clLinkProgram)(
               ctx->getRaw(),
               (cl_uint) cl_devices.size(), NOCL_TO_CL_ARRAY(cl_devices, NoCLDeviceId),
               options != NULL ? **options : nullptr,
@@ -454,10 +454,10 @@ NAN_METHOD(UnloadPlatformCompiler) {
   // Arg 1
   NOCL_UNWRAP(platform, NoCLPlatformId, info[0]);
 
-  CHECK_ERR(::clUnloadPlatformCompiler(platform->getRaw()));
+  CHECK_ERR(NOCL_CL(clUnloadPlatformCompiler)(platform->getRaw()));
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 #else
-  CHECK_ERR(::clUnloadCompiler());
+  CHECK_ERR(NOCL_CL(clUnloadCompiler)());
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
 #endif
 
@@ -482,30 +482,30 @@ NAN_METHOD(GetProgramInfo) {
     case CL_PROGRAM_NUM_DEVICES:
     {
       cl_uint val;
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_PROGRAM_CONTEXT:
     {
       cl_context val;
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(),param_name,sizeof(cl_context), &val, NULL))
-      CHECK_ERR(::clRetainContext(val))
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(),param_name,sizeof(cl_context), &val, NULL))
+      CHECK_ERR(NOCL_CL(clRetainContext)(val))
       info.GetReturnValue().Set(NOCL_WRAP(NoCLContext, val));
       return;
     }
     case CL_PROGRAM_DEVICES:
     {
       size_t n=0;
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(),param_name,0,NULL, &n));
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(),param_name,0,NULL, &n));
       n /= sizeof(cl_device_id);
 
       unique_ptr<cl_device_id[]> devices(new cl_device_id[n]);
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(),param_name,sizeof(cl_device_id)*n, devices.get(), NULL));
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(),param_name,sizeof(cl_device_id)*n, devices.get(), NULL));
 
       Local<Array> arr = Nan::New<Array>((int)n);
       for(uint32_t i=0;i<n;i++) {
-        CHECK_ERR(::clRetainDevice(devices[i]))
+        CHECK_ERR(NOCL_CL(clRetainDevice)(devices[i]))
         Nan::Set(arr, i, NOCL_WRAP(NoCLDeviceId, devices[i]));
       }
 
@@ -518,12 +518,12 @@ NAN_METHOD(GetProgramInfo) {
 
       // DRIVER ISSUE :  This part segfaults if program has not been compiled
 
-      CHECK_ERR(::clGetProgramInfo(
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(
         prog->getRaw(), CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &nsizes, NULL));
 
       unique_ptr<size_t[]> sizes(new size_t[nsizes]);
 
-      CHECK_ERR(::clGetProgramInfo(
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(
         prog->getRaw(), param_name, nsizes * sizeof(size_t), sizes.get(), NULL));
 
       Local<Array> arr = Nan::New<Array>(nsizes);
@@ -535,7 +535,7 @@ NAN_METHOD(GetProgramInfo) {
     }
 
     /*
-     err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t)*nb_devices, np, &nbread);//Load in np the size of my binary
+     err = NOCL_CL(clGetProgramInfo)(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t)*nb_devices, np, &nbread);//Load in np the size of my binary
 
 
     char** bn = new char* [nb_devices]; //Create the binary array
@@ -544,7 +544,7 @@ NAN_METHOD(GetProgramInfo) {
     for(int i =0; i < nb_devices;i++)  bn[i] = new char[np[i]]; // I know... it's bad... but if i use new char[np[i]], i have a segfault... :/
 
 
-    err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *)*nb_devices, bn, &nbread); //Load the binary itself
+    err = NOCL_CL(clGetProgramInfo)(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *)*nb_devices, bn, &nbread); //Load the binary itself
 
 
      */
@@ -554,12 +554,12 @@ NAN_METHOD(GetProgramInfo) {
 
       // DRIVER ISSUE :  This part segfaults if program has not been compiled
 
-      CHECK_ERR(::clGetProgramInfo(
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(
         prog->getRaw(), CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &nsizes, NULL));
 
       unique_ptr<size_t[]> sizes(new size_t[nsizes]);
 
-      CHECK_ERR(::clGetProgramInfo(
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(
         prog->getRaw(), CL_PROGRAM_BINARY_SIZES, nsizes * sizeof(size_t), sizes.get(), NULL));
 
       unsigned char** bn = new unsigned char* [nsizes];
@@ -567,7 +567,7 @@ NAN_METHOD(GetProgramInfo) {
         bn[i] = new unsigned char[sizes[i]];
       }
 
-      CHECK_ERR(::clGetProgramInfo(
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(
         prog->getRaw(), CL_PROGRAM_BINARIES, nsizes * sizeof(size_t), bn, NULL));
 
       Local<Array> arr = Nan::New<Array>(nsizes);
@@ -587,7 +587,7 @@ NAN_METHOD(GetProgramInfo) {
     case CL_PROGRAM_NUM_KERNELS:
     {
       size_t val;
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(),param_name,sizeof(size_t), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(),param_name,sizeof(size_t), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -596,9 +596,9 @@ NAN_METHOD(GetProgramInfo) {
     case CL_PROGRAM_SOURCE:
     {
       size_t nchars;
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(), param_name, 0, NULL, &nchars));
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(), param_name, 0, NULL, &nchars));
       unique_ptr<char[]> names(new char[nchars]);
-      CHECK_ERR(::clGetProgramInfo(prog->getRaw(), param_name, nchars*sizeof(char), names.get(), NULL));
+      CHECK_ERR(NOCL_CL(clGetProgramInfo)(prog->getRaw(), param_name, nchars*sizeof(char), names.get(), NULL));
       info.GetReturnValue().Set(JS_STR(names.get()));
       return;
     }
@@ -625,7 +625,7 @@ NAN_METHOD(GetProgramBuildInfo) {
     case CL_PROGRAM_BUILD_STATUS:
     {
       cl_build_status val;
-      CHECK_ERR(::clGetProgramBuildInfo(prog->getRaw(), device->getRaw(),param_name,sizeof(cl_build_status), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetProgramBuildInfo)(prog->getRaw(), device->getRaw(),param_name,sizeof(cl_build_status), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -633,9 +633,9 @@ NAN_METHOD(GetProgramBuildInfo) {
     case CL_PROGRAM_BUILD_LOG:
     {
       size_t param_value_size_ret=0;
-      CHECK_ERR(::clGetProgramBuildInfo(prog->getRaw(), device->getRaw(), param_name, 0, NULL, &param_value_size_ret));
+      CHECK_ERR(NOCL_CL(clGetProgramBuildInfo)(prog->getRaw(), device->getRaw(), param_name, 0, NULL, &param_value_size_ret));
       unique_ptr<char[]> param_value(new char[param_value_size_ret]);
-      CHECK_ERR(::clGetProgramBuildInfo(prog->getRaw(), device->getRaw(), param_name, param_value_size_ret, param_value.get(), NULL));
+      CHECK_ERR(NOCL_CL(clGetProgramBuildInfo)(prog->getRaw(), device->getRaw(), param_name, param_value_size_ret, param_value.get(), NULL));
       info.GetReturnValue().Set(JS_STR(param_value.get(),(int)param_value_size_ret));
       return;
     }
@@ -643,7 +643,7 @@ NAN_METHOD(GetProgramBuildInfo) {
     case CL_PROGRAM_BINARY_TYPE:
     {
       cl_program_binary_type val;
-      CHECK_ERR(::clGetProgramBuildInfo(prog->getRaw(), device->getRaw(), param_name,sizeof(cl_program_binary_type), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetProgramBuildInfo)(prog->getRaw(), device->getRaw(), param_name,sizeof(cl_program_binary_type), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -676,29 +676,29 @@ NAN_METHOD(GetProgramBuildInfo) {
 namespace Program {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "createProgramWithSource", CreateProgramWithSource);
-  Nan::SetMethod(target, "createProgramWithBinary", CreateProgramWithBinary);
+  NOCL_SET_METHOD(target, "createProgramWithSource", CreateProgramWithSource);
+  NOCL_SET_METHOD(target, "createProgramWithBinary", CreateProgramWithBinary);
 #ifdef CL_VERSION_1_2
-  Nan::SetMethod(target, "createProgramWithBuiltInKernels", CreateProgramWithBuiltInKernels);
+  NOCL_SET_METHOD(target, "createProgramWithBuiltInKernels", CreateProgramWithBuiltInKernels);
 #endif
-  Nan::SetMethod(target, "retainProgram", RetainProgram);
-  Nan::SetMethod(target, "releaseProgram", ReleaseProgram);
-  Nan::SetMethod(target, "buildProgram", BuildProgram);
+  NOCL_SET_METHOD(target, "retainProgram", RetainProgram);
+  NOCL_SET_METHOD(target, "releaseProgram", ReleaseProgram);
+  NOCL_SET_METHOD(target, "buildProgram", BuildProgram);
 #ifdef CL_VERSION_1_2
-  Nan::SetMethod(target, "compileProgram", CompileProgram);
-  Nan::SetMethod(target, "linkProgram", LinkProgram);
-  Nan::SetMethod(target, "unloadPlatformCompiler", UnloadPlatformCompiler);
+  NOCL_SET_METHOD(target, "compileProgram", CompileProgram);
+  NOCL_SET_METHOD(target, "linkProgram", LinkProgram);
+  NOCL_SET_METHOD(target, "unloadPlatformCompiler", UnloadPlatformCompiler);
 #else
-  Nan::SetMethod(target, "unloadCompiler", UnloadPlatformCompiler);
+  NOCL_SET_METHOD(target, "unloadCompiler", UnloadPlatformCompiler);
 #endif
-  Nan::SetMethod(target, "getProgramInfo", GetProgramInfo);
-  Nan::SetMethod(target, "getProgramBuildInfo", GetProgramBuildInfo);
+  NOCL_SET_METHOD(target, "getProgramInfo", GetProgramInfo);
+  NOCL_SET_METHOD(target, "getProgramBuildInfo", GetProgramBuildInfo);
 #ifdef CL_VERSION_2_1
-  // @TODO Nan::SetMethod(target, "createProgramWithIL", CreateProgramWithIL);
+  // @TODO NOCL_SET_METHOD(target, "createProgramWithIL", CreateProgramWithIL);
 #endif
 #ifdef CL_VERSION_2_2
-  // @TODO Nan::SetMethod(target, "setProgramReleaseCallback", SetProgramReleaseCallback);
-  // @TODO Nan::SetMethod(target, "setProgramSpecializationConstant", SetProgramSpecializationConstant);
+  // @TODO NOCL_SET_METHOD(target, "setProgramReleaseCallback", SetProgramReleaseCallback);
+  // @TODO NOCL_SET_METHOD(target, "setProgramSpecializationConstant", SetProgramSpecializationConstant);
 #endif
 }
 } // namespace Program
@@ -0,0 +1,514 @@
+#include "recorder.h"
+#include "histogram.h"
+#include "tracing.h"
+#include "types.h"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace opencl {
+
+struct CommandTimeline {
+  uint64_t id;
+  std::vector<uint64_t> waitFor; // ids of the recorded commands waited for
+  cl_command_type type;
+  std::string name;
+  size_t bytes;
+  cl_ulong queued;
+  cl_ulong submit;
+  cl_ulong start;
+  cl_ulong end;
+};
+
+// Latencies of the commands of a queue sharing a kernel name, or a command
+// type for the other commands, in nanoseconds
+struct CommandStats {
+  Histogram queueToStart;  // QUEUED to START
+  Histogram execution;     // START to END
+  Histogram endToCallback; // END to the completion callback
+};
+
+typedef std::pair<cl_command_type, std::string> CommandKey;
+
+// Recorder of a profiling enabled queue. Completion callbacks run on driver
+// threads, hence the lock around the collected timelines and statistics.
+struct QueueRecorder {
+  bool enabled;
+  bool stats;
+  uint32_t every;
+  size_t capacity;
+  uint64_t count;
+  std::mutex mutex;
+  std::vector<CommandTimeline> timelines;
+  size_t dropped;
+  size_t pending;
+  std::map<CommandKey, CommandStats> statistics;
+  std::deque<cl_event> recordedEvents; // under idsMutex, oldest first
+};
+
+// Ids of the commands recorded in timelines, by event. The events are
+// retained while they are in the map, so their addresses cannot be reused by
+// other events: a wait list event found here is that command, one not found
+// was never recorded and stays unlinked. Each recorder keeps its last
+// capacity events, for as long as it records.
+static std::mutex idsMutex;
+static std::unordered_map<cl_event, uint64_t> recordIds;
+static uint64_t nextRecordId = 1;
+
+// Call with idsMutex held
+static void forgetRecordedEvents(QueueRecorder &r, size_t keep) {
+  while(r.recordedEvents.size() > keep) {
+    cl_event event = r.recordedEvents.front();
+    r.recordedEvents.pop_front();
+    recordIds.erase(event);
+    ::clReleaseEvent(event);
+  }
+}
+
+// Number of recorders recording timelines or statistics: commands on other
+// queues only pay for an atomic load when none is.
+static std::atomic<int> activeRecorders(0);
+static std::mutex recordersMutex;
+static std::unordered_map<cl_command_queue, std::shared_ptr<QueueRecorder> > recorders;
+
+// The clock of trace_events, any thread
+static uint64_t hostNanoseconds() {
+  return uv_hrtime();
+}
+
+CommandRecord::CommandRecord(cl_command_queue q)
+  : kernel(nullptr), bytes(0), command(0), queue(q), timeline(false), traced(tracingEnabled()), enqueued(0),
+    capacity(0) {
+  if(activeRecorders.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(recordersMutex);
+    auto it = recorders.find(q);
+    if(it != recorders.end()) {
+      QueueRecorder &r = *it->second;
+      // every Nth command, starting with the first one
+      timeline = r.enabled && r.count++ % r.every == 0;
+      capacity = r.capacity;
+      if(timeline || r.stats)
+        recorder = it->second;
+    }
+  }
+  if(sampled())
+    enqueued = hostNanoseconds();
+}
+
+struct PendingTimeline {
+  cl_command_queue queue;
+  std::shared_ptr<QueueRecorder> recorder; // null when only traced
+  CommandTimeline timeline;
+  bool keepTimeline;
+  bool traced;
+  uint64_t enqueued;
+  cl_kernel kernel;
+};
+
+static std::string kernelName(cl_kernel kernel) {
+  size_t n = 0;
+  if(::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, 0, nullptr, &n) != CL_SUCCESS || !n)
+    return std::string();
+  std::vector<char> name(n);
+  if(::clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, n, name.data(), nullptr) != CL_SUCCESS)
+    return std::string();
+  return std::string(name.data());
+}
+
+static void CL_CALLBACK collectOnComplete(cl_event event, cl_int status, void *user_data) {
+  uint64_t completed = hostNanoseconds();
+  PendingTimeline *p = static_cast<PendingTimeline*>(user_data);
+  CommandTimeline &t = p->timeline;
+  // failed commands have no timestamps
+  bool ok = status == CL_COMPLETE &&
+    ::clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &t.queued, nullptr) == CL_SUCCESS &&
+    ::clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &t.submit, nullptr) == CL_SUCCESS &&
+    ::clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &t.start, nullptr) == CL_SUCCESS &&
+    ::clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &t.end, nullptr) == CL_SUCCESS;
+  // named here rather than when enqueued, off the main thread
+  if(p->kernel) {
+    t.name = kernelName(p->kernel);
+    ::clReleaseKernel(p->kernel);
+  }
+  if(p->traced) {
+    // device times from QUEUED, sampled while enqueuing, on the host clock.
+    // Without profiling, the span goes from the enqueue to the callback.
+    if(ok)
+      traceCommand(p->queue, t.type, t.name, t.bytes, p->enqueued + (t.start - t.queued),
+                   p->enqueued + (t.end - t.queued), true);
+    else
+      traceCommand(p->queue, t.type, t.name, t.bytes, p->enqueued, completed, false);
+  }
+  if(p->recorder) {
+    QueueRecorder &r = *p->recorder;
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.pending--;
+    if(ok && r.stats) {
+      CommandStats &s = r.statistics[CommandKey(t.type, t.name)];
+      s.queueToStart.record(t.start > t.queued ? t.start - t.queued : 0);
+      s.execution.record(t.end > t.start ? t.end - t.start : 0);
+      // QUEUED is sampled while enqueuing: the host time elapsed since then,
+      // less the device time from QUEUED to END
+      int64_t late = (int64_t) (completed - p->enqueued) - (int64_t) (t.end - t.queued);
+      s.endToCallback.record(late > 0 ? (uint64_t) late : 0);
+    }
+    if(ok && p->keepTimeline) {
+      if(r.timelines.size() < r.capacity)
+        r.timelines.push_back(std::move(t));
+      else
+        r.dropped++;
+    }
+  }
+  ::clReleaseEvent(event);
+  delete p;
+}
+
+void CommandRecord::finish(cl_event event, bool keep) {
+  if(!sampled() || !event)
+    return;
+
+  PendingTimeline *p = new PendingTimeline();
+  p->queue = queue;
+  p->recorder = recorder;
+  recorder.reset();
+  p->keepTimeline = timeline;
+  p->traced = traced;
+  traced = false;
+  p->enqueued = enqueued;
+  p->kernel = kernel;
+  if(kernel)
+    ::clRetainKernel(kernel);
+  CommandTimeline &t = p->timeline;
+  t.type = command;
+  if(!t.type)
+    ::clGetEventInfo(event, CL_EVENT_COMMAND_TYPE, sizeof(cl_command_type), &t.type, nullptr);
+  t.bytes = bytes;
+  t.queued = t.submit = t.start = t.end = 0;
+  t.id = 0;
+  if(timeline) {
+    std::lock_guard<std::mutex> lock(idsMutex);
+    for(cl_event e : waitList) {
+      auto it = recordIds.find(e);
+      if(it != recordIds.end())
+        t.waitFor.push_back(it->second);
+    }
+    t.id = nextRecordId++;
+    ::clRetainEvent(event);
+    recordIds[event] = t.id;
+    p->recorder->recordedEvents.push_back(event);
+    forgetRecordedEvents(*p->recorder, capacity);
+  }
+
+  if(keep)
+    ::clRetainEvent(event);
+  if(p->recorder) {
+    std::lock_guard<std::mutex> lock(p->recorder->mutex);
+    p->recorder->pending++;
+  }
+  if(::clSetEventCallback(event, CL_COMPLETE, collectOnComplete, p) != CL_SUCCESS) {
+    if(p->recorder) {
+      std::lock_guard<std::mutex> lock(p->recorder->mutex);
+      p->recorder->pending--;
+    }
+    if(p->kernel)
+      ::clReleaseKernel(p->kernel);
+    ::clReleaseEvent(event);
+    delete p;
+  }
+}
+
+// Timestamps are only available on profiling queues
+static cl_int checkProfiling(cl_command_queue q) {
+  cl_command_queue_properties properties = 0;
+  cl_int err = ::clGetCommandQueueInfo(q, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr);
+  if(err != CL_SUCCESS)
+    return err;
+  return properties & CL_QUEUE_PROFILING_ENABLE ? CL_SUCCESS : CL_INVALID_QUEUE_PROPERTIES;
+}
+
+// Recorder of a queue, created if needed. It retains the queue, so that the
+// queue cannot be destroyed and its address reused while it is a key of
+// recorders. Call with recordersMutex held.
+static QueueRecorder &getRecorder(cl_command_queue q) {
+  std::shared_ptr<QueueRecorder> &r = recorders[q];
+  if(!r) {
+    ::clRetainCommandQueue(q);
+    r = std::make_shared<QueueRecorder>();
+    r->enabled = false;
+    r->stats = false;
+    r->every = 1;
+    r->capacity = 0;
+    r->count = 0;
+    r->dropped = 0;
+    r->pending = 0;
+  }
+  return *r;
+}
+
+// Drops a recorder with what it collected, and its reference to the queue.
+// Completion callbacks still pending keep it alive until they have run.
+// Call with recordersMutex held.
+static void eraseRecorder(std::unordered_map<cl_command_queue, std::shared_ptr<QueueRecorder> >::iterator it) {
+  QueueRecorder &r = *it->second;
+  if(r.enabled || r.stats)
+    activeRecorders--;
+  {
+    std::lock_guard<std::mutex> lock(idsMutex);
+    forgetRecordedEvents(r, 0);
+  }
+  ::clReleaseCommandQueue(it->first);
+  recorders.erase(it);
+}
+
+// Once neither recording nor statistics are on and nothing is left to read,
+// the recorder is dropped. Call with recordersMutex held.
+static void dropIdleRecorder(cl_command_queue q) {
+  auto it = recorders.find(q);
+  if(it == recorders.end() || it->second->enabled || it->second->stats)
+    return;
+  bool idle;
+  {
+    std::lock_guard<std::mutex> lock(it->second->mutex);
+    idle = !it->second->pending && it->second->timelines.empty() && it->second->statistics.empty();
+  }
+  if(idle)
+    eraseRecorder(it);
+}
+
+void forgetRecorder(cl_command_queue q) {
+  std::lock_guard<std::mutex> lock(recordersMutex);
+  auto it = recorders.find(q);
+  if(it != recorders.end())
+    eraseRecorder(it);
+}
+
+// startRecording(command_queue, every, capacity)
+NAN_METHOD(StartRecording) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  uint32_t every = ARG_EXISTS(1) ? Nan::To<uint32_t>(info[1]).FromJust() : 1;
+  size_t capacity = 1 << 16;
+  if(ARG_EXISTS(2))
+    NOCL_TO_SIZE_T(capacity, info[2]);
+  if(!every || !capacity)
+    THROW_ERR(CL_INVALID_VALUE);
+
+  CHECK_ERR(checkProfiling(q->getRaw()));
+
+  std::lock_guard<std::mutex> lock(recordersMutex);
+  QueueRecorder &r = getRecorder(q->getRaw());
+  if(!r.enabled && !r.stats)
+    activeRecorders++;
+  r.enabled = true;
+  r.every = every;
+  r.capacity = capacity;
+  r.count = 0;
+
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+// stopRecording(command_queue)
+NAN_METHOD(StopRecording) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  std::lock_guard<std::mutex> lock(recordersMutex);
+  auto it = recorders.find(q->getRaw());
+  if(it != recorders.end() && it->second->enabled) {
+    it->second->enabled = false;
+    if(!it->second->stats)
+      activeRecorders--;
+    {
+      std::lock_guard<std::mutex> idsLock(idsMutex);
+      forgetRecordedEvents(*it->second, 0);
+    }
+    dropIdleRecorder(q->getRaw());
+  }
+
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+// getRecords(command_queue)
+// Returns { records, dropped, pending } and clears the collected records.
+// Each record has an id, unique in the process, and the ids of the recorded
+// commands in its wait list.
+NAN_METHOD(GetRecords) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  // completion callbacks only fire once the commands are submitted
+  CHECK_ERR(NOCL_CL(clFlush)(q->getRaw()));
+
+  std::vector<CommandTimeline> timelines;
+  size_t dropped = 0, pending = 0;
+  {
+    std::lock_guard<std::mutex> lock(recordersMutex);
+    auto it = recorders.find(q->getRaw());
+    if(it != recorders.end()) {
+      QueueRecorder &r = *it->second;
+      {
+        std::lock_guard<std::mutex> recorderLock(r.mutex);
+        timelines.swap(r.timelines);
+        dropped = r.dropped;
+        pending = r.pending;
+        r.dropped = 0;
+      }
+      dropIdleRecorder(q->getRaw());
+    }
+  }
+
+  Local<Array> records = Nan::New<Array>((int) timelines.size());
+  for(size_t i = 0; i < timelines.size(); i++) {
+    const CommandTimeline &t = timelines[i];
+    Local<Object> record = Nan::New<Object>();
+    // ids count the recorded commands of the process, far below 2^53
+    Nan::Set(record, JS_STR("id"), JS_SIZE(t.id));
+    Local<Array> waitFor = Nan::New<Array>((int) t.waitFor.size());
+    for(size_t j = 0; j < t.waitFor.size(); j++)
+      Nan::Set(waitFor, (uint32_t) j, JS_SIZE(t.waitFor[j]));
+    Nan::Set(record, JS_STR("waitFor"), waitFor);
+    Nan::Set(record, JS_STR("command"), JS_INT(t.type));
+    Nan::Set(record, JS_STR("name"), JS_STR(t.name));
+    Nan::Set(record, JS_STR("bytes"), JS_SIZE(t.bytes));
+    // nanoseconds, exact up to 2^53 (104 days of device uptime)
+    Nan::Set(record, JS_STR("queued"), JS_SIZE(t.queued));
+    Nan::Set(record, JS_STR("submit"), JS_SIZE(t.submit));
+    Nan::Set(record, JS_STR("start"), JS_SIZE(t.start));
+    Nan::Set(record, JS_STR("end"), JS_SIZE(t.end));
+    Nan::Set(records, (uint32_t) i, record);
+  }
+
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, JS_STR("records"), records);
+  Nan::Set(result, JS_STR("dropped"), JS_SIZE(dropped));
+  Nan::Set(result, JS_STR("pending"), JS_SIZE(pending));
+  info.GetReturnValue().Set(result);
+}
+
+// enableStats(command_queue, enabled)
+// Keeps latency histograms of the commands of a profiling queue.
+NAN_METHOD(EnableStats) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  // Arg 0
+  NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+
+  bool enabled = !ARG_EXISTS(1) || Nan::To<bool>(info[1]).FromJust();
+  if(enabled)
+    CHECK_ERR(checkProfiling(q->getRaw()));
+
+  std::lock_guard<std::mutex> lock(recordersMutex);
+  if(enabled) {
+    QueueRecorder &r = getRecorder(q->getRaw());
+    if(!r.enabled && !r.stats)
+      activeRecorders++;
+    r.stats = true;
+  } else {
+    auto it = recorders.find(q->getRaw());
+    if(it != recorders.end() && it->second->stats) {
+      it->second->stats = false;
+      if(!it->second->enabled)
+        activeRecorders--;
+      dropIdleRecorder(q->getRaw());
+    }
+  }
+
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+// getStats(command_queue, percentiles, reset)
+// Returns [{ command, name, queueToStart, execution, endToCallback }], each
+// latency being { count, min, max, mean, p50, p90, p99, p99.9 } in
+// nanoseconds. Without a queue, merges the statistics of all queues.
+NAN_METHOD(GetStats) {
+  Nan::HandleScope scope;
+
+  std::vector<cl_command_queue> queues;
+  if(ARG_EXISTS(0)) {
+    NOCL_UNWRAP(q, NoCLCommandQueue, info[0]);
+    queues.push_back(q->getRaw());
+  }
+
+  std::vector<double> percentiles;
+  if(ARG_EXISTS(1)) {
+    if(!info[1]->IsArray())
+      THROW_ERR(CL_INVALID_VALUE);
+    Local<Array> arr = Local<Array>::Cast(info[1]);
+    for(uint32_t i = 0; i < arr->Length(); i++) {
+      double p = Nan::To<double>(Nan::Get(arr, i).ToLocalChecked()).FromJust();
+      if(!(p >= 0 && p <= 100))
+        THROW_ERR(CL_INVALID_VALUE);
+      percentiles.push_back(p);
+    }
+  } else {
+    percentiles = { 50, 90, 99, 99.9 };
+  }
+  bool reset = ARG_EXISTS(2) && Nan::To<bool>(info[2]).FromJust();
+
+  std::map<CommandKey, CommandStats> merged;
+  {
+    std::lock_guard<std::mutex> lock(recordersMutex);
+    if(queues.empty()) {
+      for(auto &entry : recorders)
+        queues.push_back(entry.first);
+    }
+    for(cl_command_queue q : queues) {
+      auto it = recorders.find(q);
+      if(it == recorders.end())
+        continue;
+      QueueRecorder &r = *it->second;
+      std::lock_guard<std::mutex> recorderLock(r.mutex);
+      for(auto &entry : r.statistics) {
+        CommandStats &s = merged[entry.first];
+        s.queueToStart.merge(entry.second.queueToStart);
+        s.execution.merge(entry.second.execution);
+        s.endToCallback.merge(entry.second.endToCallback);
+      }
+      if(reset)
+        r.statistics.clear();
+    }
+    if(reset) {
+      for(cl_command_queue q : queues)
+        dropIdleRecorder(q);
+    }
+  }
+
+  Local<Array> result = Nan::New<Array>((int) merged.size());
+  uint32_t i = 0;
+  for(auto &entry : merged) {
+    Local<Object> stats = Nan::New<Object>();
+    Nan::Set(stats, JS_STR("command"), JS_INT(entry.first.first));
+    Nan::Set(stats, JS_STR("name"), JS_STR(entry.first.second));
+    Nan::Set(stats, JS_STR("queueToStart"), entry.second.queueToStart.toJS(percentiles));
+    Nan::Set(stats, JS_STR("execution"), entry.second.execution.toJS(percentiles));
+    Nan::Set(stats, JS_STR("endToCallback"), entry.second.endToCallback.toJS(percentiles));
+    Nan::Set(result, i++, stats);
+  }
+  info.GetReturnValue().Set(result);
+}
+
+namespace Recorder {
+NAN_MODULE_INIT(init)
+{
+  NOCL_SET_METHOD(target, "startRecording", StartRecording);
+  NOCL_SET_METHOD(target, "stopRecording", StopRecording);
+  NOCL_SET_METHOD(target, "getRecords", GetRecords);
+  NOCL_SET_METHOD(target, "enableStats", EnableStats);
+  NOCL_SET_METHOD(target, "getStats", GetStats);
+}
+} // namespace Recorder
+
+} // namespace opencl
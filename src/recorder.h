@@ -0,0 +1,56 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include "common.h"
+
+namespace opencl {
+
+struct QueueRecorder;
+
+// One enqueued command, as seen by the recorder of its queue. Built before
+// the command is enqueued: sampled() tells whether its event is needed, for
+// the timeline recorder, the latency statistics or trace_events.
+// finish() hands the event over to the recorder, which reads the profiling
+// timestamps once the command completes. The caller keeps its own reference
+// when keep is true, otherwise the recorder owns the event.
+class CommandRecord {
+public:
+  explicit CommandRecord(cl_command_queue q);
+
+  bool sampled() const {
+    return recorder != nullptr || traced;
+  }
+
+  // Sampled by the timeline recorder: only then is waitList needed, to link
+  // the record to the recorded commands it waits for
+  bool recorded() const {
+    return timeline;
+  }
+
+  void finish(cl_event event, bool keep);
+
+  cl_kernel kernel;        // for kernel commands, named after it
+  size_t bytes;            // for transfers
+  cl_command_type command; // when the event is not that of the command
+  std::vector<cl_event> waitList; // when recorded()
+
+private:
+  cl_command_queue queue;
+  std::shared_ptr<QueueRecorder> recorder;
+  bool timeline;     // sampled by the timeline recorder
+  bool traced;       // node-opencl trace_events category enabled
+  uint64_t enqueued; // host time, to map device times to the host clock
+  size_t capacity;   // of the timeline recorder, ids kept for its wait lists
+};
+
+// Drops the recorder of a queue released from JS, stopping its recording
+// and statistics
+void forgetRecorder(cl_command_queue q);
+
+namespace Recorder {
+NAN_MODULE_INIT(init);
+} // namespace Recorder
+
+} // namespace opencl
+
+#endif // RECORDER_H_
@@ -28,7 +28,7 @@ NAN_METHOD(CreateSampler) {
   cl_filter_mode filter_mode = Nan::To<uint32_t>(info[3]).FromJust();
 
   cl_int ret=CL_SUCCESS;
-  cl_sampler sw = ::clCreateSampler(
+  cl_sampler sw = NOCL_CL(clCreateSampler)(
               context->getRaw(),
               normalized_coords,
               addressing_mode,
@@ -88,7 +88,7 @@ NAN_METHOD(CreateSamplerWithProperties) {
    CL_SAMPLER_FILTER_MODE, CL_FILTER_LINEAR, 0};*/
 
   cl_int err = CL_SUCCESS;
-  cl_sampler sw = ::clCreateSamplerWithProperties(
+  cl_sampler sw = NOCL_CL(clCreateSamplerWithProperties)(
               context->getRaw(),
               cl_properties.data(),
               &err);
@@ -143,34 +143,34 @@ NAN_METHOD(GetSamplerInfo) {
     case CL_SAMPLER_REFERENCE_COUNT:
     {
       cl_uint val;
-      CHECK_ERR(::clGetSamplerInfo(sampler->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetSamplerInfo)(sampler->getRaw(),param_name,sizeof(cl_uint), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_SAMPLER_CONTEXT:
     {
       cl_context val;
-      CHECK_ERR(::clGetSamplerInfo(sampler->getRaw(),param_name,sizeof(cl_context), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetSamplerInfo)(sampler->getRaw(),param_name,sizeof(cl_context), &val, NULL))
       return;
     }
     case CL_SAMPLER_NORMALIZED_COORDS:
     {
       cl_bool val;
-      CHECK_ERR(::clGetSamplerInfo(sampler->getRaw(),param_name,sizeof(cl_bool), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetSamplerInfo)(sampler->getRaw(),param_name,sizeof(cl_bool), &val, NULL))
       info.GetReturnValue().Set(val==CL_TRUE ? Nan::True() : Nan::False());
       return;
     }
     case CL_SAMPLER_ADDRESSING_MODE:
     {
       cl_addressing_mode val;
-      CHECK_ERR(::clGetSamplerInfo(sampler->getRaw(),param_name,sizeof(cl_addressing_mode), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetSamplerInfo)(sampler->getRaw(),param_name,sizeof(cl_addressing_mode), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
     case CL_SAMPLER_FILTER_MODE:
     {
       cl_filter_mode val;
-      CHECK_ERR(::clGetSamplerInfo(sampler->getRaw(),param_name,sizeof(cl_filter_mode), &val, NULL))
+      CHECK_ERR(NOCL_CL(clGetSamplerInfo)(sampler->getRaw(),param_name,sizeof(cl_filter_mode), &val, NULL))
       info.GetReturnValue().Set(JS_INT(val));
       return;
     }
@@ -181,13 +181,13 @@ NAN_METHOD(GetSamplerInfo) {
 namespace Sampler {
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "retainSampler", RetainSampler);
-  Nan::SetMethod(target, "releaseSampler", ReleaseSampler);
-  Nan::SetMethod(target, "getSamplerInfo", GetSamplerInfo);
+  NOCL_SET_METHOD(target, "retainSampler", RetainSampler);
+  NOCL_SET_METHOD(target, "releaseSampler", ReleaseSampler);
+  NOCL_SET_METHOD(target, "getSamplerInfo", GetSamplerInfo);
 #ifndef CL_VERSION_2_0
-  Nan::SetMethod(target, "createSampler", CreateSampler);
+  NOCL_SET_METHOD(target, "createSampler", CreateSampler);
 #else
-  Nan::SetMethod(target, "createSamplerWithProperties", CreateSamplerWithProperties);
+  NOCL_SET_METHOD(target, "createSamplerWithProperties", CreateSamplerWithProperties);
 #endif
 }
 } // namespace Sampler
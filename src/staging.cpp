@@ -0,0 +1,562 @@
+#include "staging.h"
+#include "types.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace opencl {
+
+// Size of a pinned block, i.e. of a chunk of a staged transfer
+static const size_t kBlockSize = 4 * 1024 * 1024;
+
+// shared by all the threads using the addon
+static std::atomic<size_t> threshold(0);
+
+size_t stagingThreshold() {
+  return threshold;
+}
+
+struct StagingBlock {
+  cl_mem mem;
+  void *ptr;
+  std::chrono::steady_clock::time_point idleSince;
+};
+
+// Pool of a context. Its blocks are mapped for their whole life on a queue
+// the pool owns, and unmapped there, so no queue of the application is held.
+struct StagingPool {
+  StagingPool() : q(nullptr), used(0) {}
+  cl_command_queue q;
+  std::vector<StagingBlock> free;
+  size_t used;
+};
+
+// Free blocks kept per context, beyond which released blocks are freed, and
+// time after which a free block is freed. A pool without blocks is dropped
+// with its queue, so it no longer holds its context.
+static const size_t kMaxFreeBlocks = 4;
+static const std::chrono::seconds kIdleTime(2);
+
+static std::mutex poolMutex;
+static std::unordered_map<cl_context, StagingPool> pools;
+
+static void wakeStagingThread();
+
+static void freeBlock(StagingPool &pool, const StagingBlock &block) {
+  ::clEnqueueUnmapMemObject(pool.q, block.mem, block.ptr, 0, nullptr, nullptr);
+  ::clFinish(pool.q);
+  ::clReleaseMemObject(block.mem);
+}
+
+// With poolMutex held
+static void dropIfEmpty(cl_context ctx) {
+  auto it = pools.find(ctx);
+  if(it != pools.end() && !it->second.used && it->second.free.empty()) {
+    if(it->second.q)
+      ::clReleaseCommandQueue(it->second.q);
+    pools.erase(it);
+  }
+}
+
+// With poolMutex held. Frees the blocks idle since before the deadline.
+static void freeIdleBlocks(std::chrono::steady_clock::time_point deadline) {
+  std::vector<cl_context> contexts;
+  for(auto &entry : pools) {
+    std::vector<StagingBlock> &free = entry.second.free;
+    auto idle = std::partition(free.begin(), free.end(), [&](const StagingBlock &b) {
+      return b.idleSince > deadline;
+    });
+    for(auto b = idle; b != free.end(); ++b)
+      freeBlock(entry.second, *b);
+    free.erase(idle, free.end());
+    contexts.push_back(entry.first);
+  }
+  for(cl_context ctx : contexts)
+    dropIfEmpty(ctx);
+}
+
+static cl_int acquireBlock(cl_context ctx, cl_command_queue q, StagingBlock &block) {
+  cl_command_queue poolQueue;
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    StagingPool &pool = pools[ctx];
+    if(!pool.q) {
+      cl_device_id device;
+      cl_int err = ::clGetCommandQueueInfo(q, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, nullptr);
+      if(err == CL_SUCCESS)
+        pool.q = ::clCreateCommandQueue(ctx, device, 0, &err);
+      if(err != CL_SUCCESS) {
+        pool.q = nullptr;
+        dropIfEmpty(ctx);
+        return err;
+      }
+    }
+    pool.used++;
+    if(!pool.free.empty()) {
+      block = pool.free.back();
+      pool.free.pop_back();
+      return CL_SUCCESS;
+    }
+    // the pool, and its queue, stay while a block is used
+    poolQueue = pool.q;
+  }
+
+  cl_int err;
+  block.mem = ::clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                               kBlockSize, nullptr, &err);
+  if(err == CL_SUCCESS) {
+    block.ptr = ::clEnqueueMapBuffer(poolQueue, block.mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                     0, kBlockSize, 0, nullptr, nullptr, &err);
+    if(err != CL_SUCCESS)
+      ::clReleaseMemObject(block.mem);
+  }
+  if(err != CL_SUCCESS) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pools[ctx].used--;
+    dropIfEmpty(ctx);
+  }
+  return err;
+}
+
+static void releaseBlock(cl_context ctx, StagingBlock block) {
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    StagingPool &pool = pools[ctx];
+    pool.used--;
+    if(pool.free.size() >= kMaxFreeBlocks) {
+      freeBlock(pool, block);
+      return;
+    }
+    block.idleSince = std::chrono::steady_clock::now();
+    pool.free.push_back(block);
+  }
+  // to free it once idle
+  wakeStagingThread();
+}
+
+class StagedTransfer;
+
+// Host side steps of the non-blocking transfers: the completion callbacks of
+// the device copies post them, and the staging thread runs them. It never
+// waits for the device, so a transfer waiting for its wait list does not
+// hold the others back. It also frees the blocks left idle. The libuv thread
+// pool is left to fs, dns and crypto work.
+struct StagingTask {
+  StagedTransfer *transfer;
+  size_t chunk;
+  cl_int status;
+};
+
+static std::mutex taskMutex;
+static std::condition_variable taskReady;
+static std::deque<StagingTask> tasks;
+static bool threadStarted = false;
+
+static void postStagingTask(StagedTransfer *transfer, size_t chunk, cl_int status);
+static void stagingThread();
+
+static void wakeStagingThread() {
+  std::lock_guard<std::mutex> lock(taskMutex);
+  if(!threadStarted) {
+    std::thread(stagingThread).detach();
+    threadStarted = true;
+  }
+  taskReady.notify_one();
+}
+
+// One staged transfer: the device side copies of every chunk are enqueued at
+// once, so the transfer keeps its place in the queue, and are released one
+// by one through user events ("gates") as the host side copies progress.
+class StagedTransfer {
+public:
+  StagedTransfer(cl_context ctx, bool write, char *host, size_t size)
+    : ctx(ctx), write(write), host(host), size(size),
+      nchunks((size + kBlockSize - 1) / kBlockSize), nblocks(0), done(nullptr),
+      status(CL_COMPLETE), completed(0), async(nullptr), orphaned(false), finished(false) {
+  }
+
+  ~StagedTransfer() {
+    for(int b = 0; b < nblocks; b++)
+      releaseBlock(ctx, blocks[b]);
+    if(done)
+      ::clReleaseEvent(done);
+    hostRef.Reset();
+  }
+
+  cl_int enqueue(cl_command_queue q, cl_mem buffer, size_t offset,
+                 const std::vector<cl_event> &wait_list, cl_event *event) {
+    cl_int err;
+    int wanted = nchunks > 1 ? 2 : 1;
+    for(int b = 0; b < wanted; b++) {
+      err = acquireBlock(ctx, q, blocks[b]);
+      if(err != CL_SUCCESS)
+        return err;
+      nblocks++;
+    }
+
+    done = ::clCreateUserEvent(ctx, &err);
+    if(err != CL_SUCCESS)
+      return err;
+
+    gates.resize(nchunks, nullptr);
+    copies.resize(nchunks, nullptr);
+    for(size_t i = 0; i < nchunks; i++) {
+      std::vector<cl_event> deps(wait_list);
+      // a write waits for its chunk to be staged, a read for its block to be
+      // drained by the host
+      if(write || i >= 2) {
+        gates[i] = ::clCreateUserEvent(ctx, &err);
+        if(err != CL_SUCCESS)
+          return err;
+        deps.push_back(gates[i]);
+      }
+
+      void *staged = blocks[i % 2].ptr;
+      if(write) {
+        err = ::clEnqueueWriteBuffer(q, buffer, CL_FALSE, offset + i * kBlockSize,
+                                     chunkSize(i), staged,
+                                     (cl_uint) deps.size(), deps.data(), &copies[i]);
+      }
+      else {
+        err = ::clEnqueueReadBuffer(q, buffer, CL_FALSE, offset + i * kBlockSize,
+                                    chunkSize(i), staged,
+                                    (cl_uint) deps.size(), deps.data(), &copies[i]);
+      }
+      if(err != CL_SUCCESS)
+        return err;
+    }
+
+    // the event of the transfer is a marker completing with done: unlike
+    // user events, it has profiling info, from QUEUED to END of the transfer
+    if(event) {
+#ifdef CL_VERSION_1_2
+      err = ::clEnqueueMarkerWithWaitList(q, 1, &done, event);
+#else
+      err = ::clEnqueueWaitForEvents(q, 1, &done);
+      if(err == CL_SUCCESS)
+        err = ::clEnqueueMarker(q, event);
+#endif
+      if(err != CL_SUCCESS)
+        return err;
+    }
+
+    err = ::clFlush(q);
+    if(err != CL_SUCCESS && event) {
+      ::clReleaseEvent(*event);
+      *event = nullptr;
+    }
+    return err;
+  }
+
+  // Host side of a blocking transfer, on the calling thread.
+  cl_int run() {
+    cl_int status = CL_COMPLETE;
+    for(size_t i = 0; i < nchunks && status == CL_COMPLETE; i++) {
+      if(write) {
+        // the block is free again once the chunk staged two steps ago is copied
+        if(i >= 2)
+          status = waitFor(copies[i - 2]);
+        if(status == CL_COMPLETE)
+          stage(i);
+      }
+      else {
+        status = waitFor(copies[i]);
+        if(status == CL_COMPLETE)
+          drain(i);
+      }
+    }
+    finish(status);
+    return status;
+  }
+
+  // Host side of a non-blocking transfer, driven by the completion callbacks
+  // of the device copies. host, which owns the host memory, is kept alive
+  // until the transfer is done and deleted on the loop of this thread. If the
+  // environment of that thread goes away first, the transfer is orphaned:
+  // it stops copying to and from host, fails, and the staging thread
+  // deletes it.
+  void start(Local<Value> host) {
+    hostRef.Reset(host);
+    async = new uv_async_t;
+    async->data = this;
+    uv_async_init(Nan::GetCurrentEventLoop(), async, [](uv_async_t *handle) {
+      StagedTransfer *transfer = static_cast<StagedTransfer*>(handle->data);
+      removeCleanupHook(orphan, transfer);
+      delete transfer;
+      uv_close((uv_handle_t*) handle, deleteAsync);
+    });
+    addCleanupHook(orphan, this);
+
+    // the first two chunks of a write do not wait for a block
+    if(write) {
+      for(size_t i = 0; i < nchunks && i < 2; i++)
+        stage(i);
+    }
+
+    chunkRefs.resize(nchunks);
+    for(size_t i = 0; i < nchunks; i++) {
+      chunkRefs[i] = std::make_pair(this, i);
+      if(::clSetEventCallback(copies[i], CL_COMPLETE, onCopyComplete, &chunkRefs[i]) != CL_SUCCESS)
+        postStagingTask(this, i, CL_INVALID_EVENT);
+    }
+  }
+
+  // On the staging thread, once the device copy of a chunk is over
+  void copyCompleted(size_t i, cl_int copyStatus) {
+    std::unique_lock<std::mutex> lock(hostMutex);
+    completed++;
+    if(orphaned && copyStatus >= 0)
+      copyStatus = CL_INVALID_OPERATION;
+    if(copyStatus < 0 && status == CL_COMPLETE) {
+      // the commands still waiting for a gate terminate, then complete too
+      status = copyStatus;
+      for(size_t g = 0; g < gates.size(); g++)
+        openGate(g, status);
+    }
+    else if(status == CL_COMPLETE) {
+      if(write) {
+        if(i + 2 < nchunks)
+          stage(i + 2);
+      }
+      else {
+        drain(i);
+      }
+    }
+
+    if(completed == nchunks) {
+      lock.unlock();
+      finish(status);
+      lock.lock();
+      if(orphaned) {
+        lock.unlock();
+        delete this;
+        return;
+      }
+      finished = true;
+      uv_async_send(async);
+    }
+  }
+
+  // Terminates the commands still waiting for a gate and waits for the
+  // driver to be done with the blocks before they go back to the pool.
+  void finish(cl_int status) {
+    for(size_t i = 0; i < gates.size(); i++)
+      openGate(i, status == CL_COMPLETE ? CL_INVALID_OPERATION : status);
+    for(size_t i = 0; i < copies.size(); i++) {
+      if(copies[i]) {
+        ::clWaitForEvents(1, &copies[i]);
+        ::clReleaseEvent(copies[i]);
+        copies[i] = nullptr;
+      }
+    }
+    if(done)
+      ::clSetUserEventStatus(done, status);
+  }
+
+private:
+  size_t chunkSize(size_t i) const {
+    return std::min(kBlockSize, size - i * kBlockSize);
+  }
+
+  // host chunk i to its block, then lets its device copy go
+  void stage(size_t i) {
+    memcpy(blocks[i % 2].ptr, host + i * kBlockSize, chunkSize(i));
+    openGate(i, CL_COMPLETE);
+  }
+
+  // block of chunk i to the host, then lets the chunk two steps ahead reuse it
+  void drain(size_t i) {
+    memcpy(host + i * kBlockSize, blocks[i % 2].ptr, chunkSize(i));
+    if(i + 2 < nchunks)
+      openGate(i + 2, CL_COMPLETE);
+  }
+
+  void openGate(size_t i, cl_int status) {
+    if(gates[i]) {
+      ::clSetUserEventStatus(gates[i], status);
+      ::clReleaseEvent(gates[i]);
+      gates[i] = nullptr;
+    }
+  }
+
+  static cl_int waitFor(cl_event ev) {
+    cl_int err = ::clWaitForEvents(1, &ev);
+    if(err != CL_SUCCESS)
+      return err;
+    cl_int status;
+    err = ::clGetEventInfo(ev, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, nullptr);
+    return err != CL_SUCCESS ? err : status;
+  }
+
+  static void deleteAsync(uv_handle_t *handle) {
+    delete (uv_async_t*) handle;
+  }
+
+  // Cleanup hook of the environment of the loop of async. The host memory
+  // goes away with it: once hostMutex is taken, the staging thread no longer
+  // touches it.
+  static void orphan(void *arg) {
+    StagedTransfer *transfer = static_cast<StagedTransfer*>(arg);
+    std::unique_lock<std::mutex> lock(transfer->hostMutex);
+    uv_close((uv_handle_t*) transfer->async, deleteAsync);
+    transfer->async = nullptr;
+    transfer->hostRef.Reset();
+    if(transfer->finished) {
+      // done, but not yet deleted by async
+      lock.unlock();
+      delete transfer;
+      return;
+    }
+    transfer->orphaned = true;
+  }
+
+  // On a driver thread: only hands the chunk over to the staging thread
+  static void CL_CALLBACK onCopyComplete(cl_event, cl_int status, void *user_data) {
+    auto *ref = static_cast<std::pair<StagedTransfer*, size_t>*>(user_data);
+    postStagingTask(ref->first, ref->second, status);
+  }
+
+  cl_context ctx;
+  bool write;
+  char *host;
+  size_t size;
+  size_t nchunks;
+  StagingBlock blocks[2];
+  int nblocks;
+  std::vector<cl_event> gates;
+  std::vector<cl_event> copies;
+  cl_event done;
+  // non-blocking transfers, touched by the staging thread only once started
+  cl_int status;
+  size_t completed;
+  std::vector<std::pair<StagedTransfer*, size_t> > chunkRefs;
+  Nan::Persistent<Value> hostRef;
+  uv_async_t *async;
+  // between the staging thread and the cleanup hook of the environment
+  std::mutex hostMutex;
+  bool orphaned;
+  bool finished;
+};
+
+static void postStagingTask(StagedTransfer *transfer, size_t chunk, cl_int status) {
+  {
+    std::lock_guard<std::mutex> lock(taskMutex);
+    tasks.push_back({ transfer, chunk, status });
+  }
+  wakeStagingThread();
+}
+
+static void stagingThread() {
+  std::unique_lock<std::mutex> lock(taskMutex);
+  for(;;) {
+    if(tasks.empty()) {
+      bool idleBlocks;
+      {
+        std::lock_guard<std::mutex> poolLock(poolMutex);
+        idleBlocks = !pools.empty();
+      }
+      if(idleBlocks)
+        taskReady.wait_for(lock, kIdleTime);
+      else
+        taskReady.wait(lock);
+    }
+
+    while(!tasks.empty()) {
+      StagingTask task = tasks.front();
+      tasks.pop_front();
+      lock.unlock();
+      task.transfer->copyCompleted(task.chunk, task.status);
+      lock.lock();
+    }
+
+    lock.unlock();
+    {
+      std::lock_guard<std::mutex> poolLock(poolMutex);
+      freeIdleBlocks(std::chrono::steady_clock::now() - kIdleTime);
+    }
+    lock.lock();
+  }
+}
+
+static cl_int enqueueStaged(cl_command_queue q, cl_mem buffer, cl_bool blocking, bool write,
+                            size_t offset, size_t size, char *ptr, Local<Value> host,
+                            const std::vector<cl_event> &wait_list, cl_event *event) {
+  cl_context ctx;
+  cl_int err = ::clGetCommandQueueInfo(q, CL_QUEUE_CONTEXT, sizeof(cl_context), &ctx, nullptr);
+  if(err != CL_SUCCESS)
+    return err;
+
+  StagedTransfer *transfer = new StagedTransfer(ctx, write, ptr, size);
+  err = transfer->enqueue(q, buffer, offset, wait_list, event);
+  if(err != CL_SUCCESS) {
+    transfer->finish(err);
+    delete transfer;
+    return err;
+  }
+
+  if(blocking) {
+    err = transfer->run();
+    delete transfer;
+    return err;
+  }
+
+  transfer->start(host);
+  return CL_SUCCESS;
+}
+
+cl_int enqueueStagedWrite(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                          size_t offset, size_t size, const void *ptr,
+                          Local<Value> host, const std::vector<cl_event> &wait_list,
+                          cl_event *event) {
+  return enqueueStaged(q, buffer, blocking, true, offset, size,
+                       static_cast<char*>(const_cast<void*>(ptr)), host, wait_list, event);
+}
+
+cl_int enqueueStagedRead(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                         size_t offset, size_t size, void *ptr,
+                         Local<Value> host, const std::vector<cl_event> &wait_list,
+                         cl_event *event) {
+  return enqueueStaged(q, buffer, blocking, false, offset, size,
+                       static_cast<char*>(ptr), host, wait_list, event);
+}
+
+NAN_METHOD(SetStagingThreshold) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+  size_t value;
+  NOCL_TO_SIZE_T(value, info[0]);
+  threshold = value;
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+NAN_METHOD(GetStagingThreshold) {
+  Nan::HandleScope scope;
+  info.GetReturnValue().Set(JS_SIZE(threshold.load()));
+}
+
+// Unmaps and releases the free blocks of every context, and the pools with
+// no block in use. Blocks used by a transfer in flight go back to the pool
+// when it completes.
+NAN_METHOD(ReleaseStagingPools) {
+  Nan::HandleScope scope;
+  std::lock_guard<std::mutex> lock(poolMutex);
+  freeIdleBlocks(std::chrono::steady_clock::time_point::max());
+  info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
+}
+
+namespace Staging {
+NAN_MODULE_INIT(init)
+{
+  NOCL_SET_METHOD(target, "setStagingThreshold", SetStagingThreshold);
+  NOCL_SET_METHOD(target, "getStagingThreshold", GetStagingThreshold);
+  NOCL_SET_METHOD(target, "releaseStagingPools", ReleaseStagingPools);
+}
+} // namespace Staging
+
+} // namespace opencl
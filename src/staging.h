@@ -0,0 +1,35 @@
+#ifndef STAGING_H_
+#define STAGING_H_
+
+#include "common.h"
+
+namespace opencl {
+
+// Size above which blocking and non-blocking enqueueReadBuffer /
+// enqueueWriteBuffer go through the pinned staging pool. 0 disables it.
+size_t stagingThreshold();
+
+// Transfers between a pageable host pointer and a buffer through a pair of
+// pinned (CL_MEM_ALLOC_HOST_PTR, persistently mapped) blocks taken from a
+// per-context pool. The host copy of one chunk overlaps the device copy of
+// the previous one. When blocking is false, the host copies run on the
+// staging thread as the device copies complete, and host, which owns ptr, is
+// kept alive until they are done.
+// *event (when event is not null) completes once the whole transfer is done.
+cl_int enqueueStagedWrite(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                          size_t offset, size_t size, const void *ptr,
+                          Local<Value> host, const std::vector<cl_event> &wait_list,
+                          cl_event *event);
+
+cl_int enqueueStagedRead(cl_command_queue q, cl_mem buffer, cl_bool blocking,
+                         size_t offset, size_t size, void *ptr,
+                         Local<Value> host, const std::vector<cl_event> &wait_list,
+                         cl_event *event);
+
+namespace Staging {
+NAN_MODULE_INIT(init);
+} // namespace Staging
+
+} // namespace opencl
+
+#endif // STAGING_H_
@@ -22,12 +22,13 @@ NAN_METHOD(SVMAlloc) {
   cl_svm_mem_flags flags = Nan::To<uint32_t>(info[1]).FromJust();
 
   // Arg 2
-  cl_uint size = Nan::To<uint32_t>(info[2]).FromJust();
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[2]);
 
   // Arg 3
   cl_uint alignment = Nan::To<uint32_t>(info[3]).FromJust();
 
-  void* mPtr = ::clSVMAlloc (
+  void* mPtr = NOCL_CL(clSVMAlloc)(
     context->getRaw(),
     flags,
     size,
@@ -36,7 +37,7 @@ NAN_METHOD(SVMAlloc) {
   if(mPtr == NULL)
     THROW_ERR(CL_INVALID_ARG_VALUE);
 
-  Local<v8::ArrayBuffer> obj = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), mPtr, size);
+  Local<v8::ArrayBuffer> obj = newExternalArrayBuffer(mPtr, size);
 
   info.GetReturnValue().Set(obj);
 }
@@ -56,7 +57,7 @@ NAN_METHOD(SVMFree) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
-  clSVMFree(context->getRaw(),ptr);
+  NOCL_CL(clSVMFree)(context->getRaw(),ptr);
 
   // TODO sets arg[1] to buffer data
   // Local<Object> obj = info[1].As<Object>();
@@ -145,7 +146,7 @@ NAN_METHOD(enqueueSVMFree) {
 
     NoCLSVMWorker* cb = new NoCLSVMWorker(callback,userData,info[0].As<Object>());
 
-    err = clEnqueueSVMFree(cq->getRaw(),(cl_uint) vec.size(),vec.data(),
+    err = NOCL_CL(clEnqueueSVMFree)(cq->getRaw(),(cl_uint) vec.size(),vec.data(),
                             notifySVMCB,
                             cb,
                             (cl_uint) cl_events.size(),
@@ -153,7 +154,7 @@ NAN_METHOD(enqueueSVMFree) {
                             eventPtr);
   }
   else {
-   err = clEnqueueSVMFree(cq->getRaw(),(cl_uint) vec.size(),vec.data(),
+   err = NOCL_CL(clEnqueueSVMFree)(cq->getRaw(),(cl_uint) vec.size(),vec.data(),
                          NULL,
                          NULL,
                          (cl_uint) cl_events.size(),
@@ -193,7 +194,8 @@ NAN_METHOD(enqueueSVMMemcpy) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
-  size_t size = Nan::To<uint32_t>(info[4]).FromJust();
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[4]);
 
   if(size>static_cast<size_t>(len) || size>static_cast<size_t>(len2))
     THROW_ERR(CL_INVALID_VALUE);
@@ -209,7 +211,7 @@ NAN_METHOD(enqueueSVMMemcpy) {
   if(ARG_EXISTS(6) && Nan::To<bool>(info[6]).FromJust())
       eventPtr = &event;
 
-  err = clEnqueueSVMMemcpy(cq->getRaw(),blocking_copy,
+  err = NOCL_CL(clEnqueueSVMMemcpy)(cq->getRaw(),blocking_copy,
                            dst,src,size,
                            (cl_uint) cl_events.size(),
                            NOCL_TO_CL_ARRAY(
@@ -245,7 +247,8 @@ NAN_METHOD(enqueueSVMMemFill) {
   if(!pattern || !len) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
-  size_t size = Nan::To<uint32_t>(info[3]).FromJust();
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[3]);
 
   if(size>static_cast<size_t>(len) ||
      size >static_cast<size_t>(length) ||
@@ -263,7 +266,7 @@ NAN_METHOD(enqueueSVMMemFill) {
   if(ARG_EXISTS(5) && Nan::To<bool>(info[5]).FromJust())
       eventPtr = &event;
 
-  err =  clEnqueueSVMMemFill(cq->getRaw(),ptr,pattern,static_cast<size_t>(len),size,
+  err =  NOCL_CL(clEnqueueSVMMemFill)(cq->getRaw(),ptr,pattern,static_cast<size_t>(len),size,
                              (cl_uint) cl_events.size(),
                              NOCL_TO_CL_ARRAY(
                              cl_events, NoCLEvent),
@@ -294,7 +297,8 @@ NAN_METHOD(enqueueSVMMap) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
-  size_t size = Nan::To<uint32_t>(info[4]).FromJust();
+  size_t size;
+  NOCL_TO_SIZE_T(size, info[4]);
 
   std::vector<NoCLEvent*> cl_events;
   if(ARG_EXISTS(5)) {
@@ -307,7 +311,7 @@ NAN_METHOD(enqueueSVMMap) {
   if(ARG_EXISTS(6) && Nan::To<bool>(info[6]).FromJust())
       eventPtr = &event;
 
-  err = clEnqueueSVMMap(cq->getRaw(),blocking_map,map_flags,
+  err = NOCL_CL(clEnqueueSVMMap)(cq->getRaw(),blocking_map,map_flags,
                         ptr,size, (cl_uint)cl_events.size(),
                         NOCL_TO_CL_ARRAY(
                         cl_events, NoCLEvent),
@@ -346,7 +350,7 @@ NAN_METHOD(enqueueSVMUnmap) {
   if(ARG_EXISTS(3) && Nan::To<bool>(info[3]).FromJust())
       eventPtr = &event;
 
-  err = clEnqueueSVMUnmap(cq->getRaw(),ptr, (cl_uint)cl_events.size(),
+  err = NOCL_CL(clEnqueueSVMUnmap)(cq->getRaw(),ptr, (cl_uint)cl_events.size(),
                        NOCL_TO_CL_ARRAY(
                        cl_events, NoCLEvent),
                        eventPtr);
@@ -376,7 +380,7 @@ NAN_METHOD(setKernelArgSVMPointer) {
     return Nan::ThrowTypeError("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer");
   }
 
-  err = clSetKernelArgSVMPointer(k->getRaw(),idx,ptr);
+  err = NOCL_CL(clSetKernelArgSVMPointer)(k->getRaw(),idx,ptr);
 
   CHECK_ERR(err)
   info.GetReturnValue().Set(JS_INT(CL_SUCCESS));
@@ -401,17 +405,17 @@ namespace SVM {
 NAN_MODULE_INIT(init)
 {
 #ifdef CL_VERSION_2_0
-  Nan::SetMethod(target, "SVMAlloc", SVMAlloc);
-  Nan::SetMethod(target, "SVMFree", SVMFree);
-  Nan::SetMethod(target, "enqueueSVMFree", enqueueSVMFree);
-  Nan::SetMethod(target, "enqueueSVMMap", enqueueSVMMap);
-  Nan::SetMethod(target, "enqueueSVMMemcpy", enqueueSVMMemcpy);
-  Nan::SetMethod(target, "enqueueSVMMemFill", enqueueSVMMemFill);
-  Nan::SetMethod(target, "enqueueSVMUnmap", enqueueSVMUnmap);
-  Nan::SetMethod(target, "setKernelArgSVMPointer", setKernelArgSVMPointer);
+  NOCL_SET_METHOD(target, "SVMAlloc", SVMAlloc);
+  NOCL_SET_METHOD(target, "SVMFree", SVMFree);
+  NOCL_SET_METHOD(target, "enqueueSVMFree", enqueueSVMFree);
+  NOCL_SET_METHOD(target, "enqueueSVMMap", enqueueSVMMap);
+  NOCL_SET_METHOD(target, "enqueueSVMMemcpy", enqueueSVMMemcpy);
+  NOCL_SET_METHOD(target, "enqueueSVMMemFill", enqueueSVMMemFill);
+  NOCL_SET_METHOD(target, "enqueueSVMUnmap", enqueueSVMUnmap);
+  NOCL_SET_METHOD(target, "setKernelArgSVMPointer", setKernelArgSVMPointer);
 #endif
 #ifdef CL_VERSION_2_1
-  // @TODO Nan::SetMethod(target, "enqueueSVMMigrateMem", EnqueueSVMMigrateMem);
+  // @TODO NOCL_SET_METHOD(target, "enqueueSVMMigrateMem", EnqueueSVMMigrateMem);
 #endif
 }
 } // namespace Pipe
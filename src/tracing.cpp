@@ -0,0 +1,129 @@
+#include "tracing.h"
+#include <atomic>
+#include <cstdio>
+
+namespace opencl {
+
+// Enabled flag of the category, owned by the tracing controller
+static std::atomic<const uint8_t*> categoryEnabled(nullptr);
+
+bool tracingEnabled() {
+  const uint8_t *enabled = categoryEnabled.load(std::memory_order_relaxed);
+  return enabled && *enabled;
+}
+
+#ifdef NOCL_HAS_TRACING
+
+static const char kCategory[] = "node-opencl";
+
+// From V8's trace_event_common.h, which is not part of its public headers
+static const char kPhaseComplete = 'X';
+static const char kPhaseAsyncBegin = 'b';
+static const char kPhaseAsyncEnd = 'e';
+static const unsigned kFlagCopy = 1 << 0;
+static const unsigned kFlagHasId = 1 << 1;
+static const uint8_t kTypeUInt = 2;
+
+static v8::TracingController *controller() {
+  return node::GetTracingController();
+}
+
+TraceScope::TraceScope(const char *name) : name(name), handle(0) {
+  if(!tracingEnabled())
+    return;
+  handle = controller()->AddTraceEvent(kPhaseComplete, categoryEnabled.load(), name,
+    nullptr, 0, 0, 0, nullptr, nullptr, nullptr, nullptr, 0);
+}
+
+TraceScope::~TraceScope() {
+  if(handle)
+    controller()->UpdateTraceEventDuration(categoryEnabled.load(), name, handle);
+}
+
+static const char *commandTypeName(cl_command_type type) {
+  switch(type) {
+    case CL_COMMAND_NDRANGE_KERNEL: return "NDRANGE_KERNEL";
+    case CL_COMMAND_TASK: return "TASK";
+    case CL_COMMAND_NATIVE_KERNEL: return "NATIVE_KERNEL";
+    case CL_COMMAND_READ_BUFFER: return "READ_BUFFER";
+    case CL_COMMAND_WRITE_BUFFER: return "WRITE_BUFFER";
+    case CL_COMMAND_COPY_BUFFER: return "COPY_BUFFER";
+    case CL_COMMAND_READ_IMAGE: return "READ_IMAGE";
+    case CL_COMMAND_WRITE_IMAGE: return "WRITE_IMAGE";
+    case CL_COMMAND_COPY_IMAGE: return "COPY_IMAGE";
+    case CL_COMMAND_COPY_IMAGE_TO_BUFFER: return "COPY_IMAGE_TO_BUFFER";
+    case CL_COMMAND_COPY_BUFFER_TO_IMAGE: return "COPY_BUFFER_TO_IMAGE";
+    case CL_COMMAND_MAP_BUFFER: return "MAP_BUFFER";
+    case CL_COMMAND_MAP_IMAGE: return "MAP_IMAGE";
+    case CL_COMMAND_UNMAP_MEM_OBJECT: return "UNMAP_MEM_OBJECT";
+    case CL_COMMAND_MARKER: return "MARKER";
+    case CL_COMMAND_READ_BUFFER_RECT: return "READ_BUFFER_RECT";
+    case CL_COMMAND_WRITE_BUFFER_RECT: return "WRITE_BUFFER_RECT";
+    case CL_COMMAND_COPY_BUFFER_RECT: return "COPY_BUFFER_RECT";
+#ifdef CL_VERSION_1_2
+    case CL_COMMAND_BARRIER: return "BARRIER";
+    case CL_COMMAND_MIGRATE_MEM_OBJECTS: return "MIGRATE_MEM_OBJECTS";
+    case CL_COMMAND_FILL_BUFFER: return "FILL_BUFFER";
+    case CL_COMMAND_FILL_IMAGE: return "FILL_IMAGE";
+#endif
+#ifdef CL_VERSION_2_0
+    case CL_COMMAND_SVM_FREE: return "SVM_FREE";
+    case CL_COMMAND_SVM_MEMCPY: return "SVM_MEMCPY";
+    case CL_COMMAND_SVM_MEMFILL: return "SVM_MEMFILL";
+    case CL_COMMAND_SVM_MAP: return "SVM_MAP";
+    case CL_COMMAND_SVM_UNMAP: return "SVM_UNMAP";
+#endif
+    default: return "COMMAND";
+  }
+}
+
+// Async ids of the command spans
+static std::atomic<uint64_t> nextSpanId(1);
+
+void traceCommand(cl_command_queue q, cl_command_type type, const std::string &name,
+                  size_t bytes, uint64_t start, uint64_t end, bool deviceTimes) {
+  if(!tracingEnabled())
+    return;
+
+  // one track per queue
+  char queue[32];
+  snprintf(queue, sizeof(queue), "queue %p", (void*) q);
+  const char *spanName = name.empty() ? commandTypeName(type) : name.c_str();
+  uint64_t id = nextSpanId++;
+
+  const char *argNames[2] = { "bytes", "deviceTimes" };
+  uint8_t argTypes[2] = { kTypeUInt, kTypeUInt };
+  uint64_t argValues[2] = { bytes, deviceTimes ? 1u : 0u };
+
+  v8::TracingController *c = controller();
+  const uint8_t *enabled = categoryEnabled.load();
+  // trace timestamps are in microseconds
+  c->AddTraceEventWithTimestamp(kPhaseAsyncBegin, enabled, spanName, queue, id, 0,
+    2, argNames, argTypes, argValues, nullptr, kFlagCopy | kFlagHasId, (int64_t) (start / 1000));
+  c->AddTraceEventWithTimestamp(kPhaseAsyncEnd, enabled, spanName, queue, id, 0,
+    0, nullptr, nullptr, nullptr, nullptr, kFlagCopy | kFlagHasId, (int64_t) (end / 1000));
+}
+
+#else
+
+TraceScope::TraceScope(const char *name) : name(name), handle(0) {}
+
+TraceScope::~TraceScope() {}
+
+void traceCommand(cl_command_queue, cl_command_type, const std::string &,
+                  size_t, uint64_t, uint64_t, bool) {}
+
+#endif // NOCL_HAS_TRACING
+
+namespace Tracing {
+NAN_MODULE_INIT(init)
+{
+#ifdef NOCL_HAS_TRACING
+  // the same controller serves the main thread and the workers
+  if(!categoryEnabled.load() && controller())
+    categoryEnabled = controller()->GetCategoryGroupEnabled(kCategory);
+#endif
+}
+} // namespace Tracing
+
+} // namespace opencl
@@ -0,0 +1,39 @@
+#ifndef TRACING_H_
+#define TRACING_H_
+
+#include "common.h"
+
+namespace opencl {
+
+// Spans of the "node-opencl" category of Node's trace_events, written by
+// `node --trace-event-categories node-opencl`. Host times are uv_hrtime()
+// nanoseconds, the clock of the other trace events of the process. Without
+// tracing support in Node, nothing is ever enabled.
+
+// Whether the category is being recorded: a byte load
+bool tracingEnabled();
+
+// Complete event covering the lifetime of the object. name is not copied and
+// must outlive the trace.
+class TraceScope {
+public:
+  explicit TraceScope(const char *name);
+  ~TraceScope();
+
+private:
+  const char *name;
+  uint64_t handle;
+};
+
+// Async span of a completed command, on the track of its queue. name is the
+// kernel name, or empty for the command type name.
+void traceCommand(cl_command_queue q, cl_command_type type, const std::string &name,
+                  size_t bytes, uint64_t start, uint64_t end, bool deviceTimes);
+
+namespace Tracing {
+NAN_MODULE_INIT(init);
+} // namespace Tracing
+
+} // namespace opencl
+
+#endif // TRACING_H_
@@ -1,5 +1,7 @@
 #include "types.h"
 #include "common.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace opencl {
 
@@ -19,15 +21,94 @@ const char *cl_type_names[] = {
   "CLMappedPtr",
 };
 
-static Nan::Persistent<FunctionTemplate> prototypes[11];
-static Nan::Persistent<Function> constructors[11];
+// Templates and constructors of the wrappers. Each thread loading the addon
+// (the main thread, worker threads) has its own isolate, hence its own set.
+struct IsolateState {
+  Nan::Persistent<FunctionTemplate> prototypes[11];
+  Nan::Persistent<Function> constructors[11];
+};
+
+static std::mutex statesMutex;
+static std::unordered_map<v8::Isolate*, IsolateState*> states;
+
+// an isolate stays on its thread, which saves the lookup in most calls
+static thread_local v8::Isolate *lastIsolate = nullptr;
+static thread_local IsolateState *lastState = nullptr;
+
+static IsolateState &currentState() {
+  v8::Isolate *isolate = v8::Isolate::GetCurrent();
+  if(isolate != lastIsolate || !lastState) {
+    std::lock_guard<std::mutex> lock(statesMutex);
+    IsolateState *&state = states[isolate];
+    if(!state)
+      state = new IsolateState();
+    lastIsolate = isolate;
+    lastState = state;
+  }
+  return *lastState;
+}
+
+static void releaseState(void *arg) {
+  v8::Isolate *isolate = static_cast<v8::Isolate*>(arg);
+  IsolateState *state = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(statesMutex);
+    auto it = states.find(isolate);
+    if(it == states.end())
+      return;
+    state = it->second;
+    states.erase(it);
+  }
+  for(int i = 0; i < 11; i++) {
+    state->prototypes[i].Reset();
+    state->constructors[i].Reset();
+  }
+  delete state;
+  if(lastIsolate == isolate) {
+    lastIsolate = nullptr;
+    lastState = nullptr;
+  }
+}
 
 Nan::Persistent<v8::FunctionTemplate>& prototype(int id) {
-  return prototypes[id];
+  return currentState().prototypes[id];
 }
 
 Nan::Persistent<v8::Function>& constructor(int id) {
-  return constructors[id];
+  return currentState().constructors[id];
+}
+
+// Handles are "<type name>:<serial>" strings, which can be posted to other
+// worker threads. Exporting retains the OpenCL object and registers the
+// handle, importing consumes the registration and adopts that reference: the
+// imported wrapper releases it once collected. Only registered handles are
+// imported, once each, so a forged or reused string never becomes a wrapper.
+static std::mutex handlesMutex;
+static std::unordered_map<std::string, uintptr_t> exportedHandles;
+static uint64_t nextHandle = 1;
+
+template <typename W>
+static bool exportAs(Local<Value> value, std::string &handle, cl_int &ret) {
+  W *obj = W::Unwrap(value);
+  if(!obj)
+    return false;
+  ret = obj->isReleased() ? W::getErrorCode() : obj->acquire();
+  if(ret != CL_SUCCESS)
+    return true;
+  std::lock_guard<std::mutex> lock(handlesMutex);
+  std::stringstream ss;
+  ss << W::getTypeName() << ":" << std::hex << nextHandle++;
+  handle = ss.str();
+  exportedHandles[handle] = reinterpret_cast<uintptr_t>(obj->getRaw());
+  return true;
+}
+
+template <typename T, typename W>
+static bool importAs(const std::string &type, uintptr_t raw, Local<Value> &obj) {
+  if(type != W::getTypeName())
+    return false;
+  obj = W::NewInstance(reinterpret_cast<T>(raw));
+  return true;
 }
 
 namespace Types {
@@ -47,9 +128,75 @@ NAN_METHOD(releaseAll){
   // NoCLContext::releaseAll();
 }
 
+// exportHandle(object)
+NAN_METHOD(ExportHandle) {
+  Nan::HandleScope scope;
+  REQ_ARGS(1);
+
+  // buffers are not wrappers, even though Unwrap() accepts them
+  if(!info[0]->IsObject() || info[0]->IsArrayBuffer() || info[0]->IsArrayBufferView() ||
+     info[0]->IsSharedArrayBuffer())
+    return Nan::ThrowTypeError("Not an OpenCL object");
+
+  std::string handle;
+  cl_int ret = CL_SUCCESS;
+  if(!(exportAs<NoCLPlatformId>(info[0], handle, ret) ||
+       exportAs<NoCLDeviceId>(info[0], handle, ret) ||
+       exportAs<NoCLContext>(info[0], handle, ret) ||
+       exportAs<NoCLProgram>(info[0], handle, ret) ||
+       exportAs<NoCLKernel>(info[0], handle, ret) ||
+       exportAs<NoCLMem>(info[0], handle, ret) ||
+       exportAs<NoCLSampler>(info[0], handle, ret) ||
+       exportAs<NoCLCommandQueue>(info[0], handle, ret) ||
+       exportAs<NoCLEvent>(info[0], handle, ret)))
+    return Nan::ThrowTypeError("Not an OpenCL object");
+  CHECK_ERR(ret);
+
+  info.GetReturnValue().Set(JS_STR(handle));
+}
+
+// importHandle(handle)
+NAN_METHOD(ImportHandle) {
+  Nan::HandleScope scope;
+  REQ_STR_ARG(0, str);
+
+  std::string handle(*str);
+  size_t colon = handle.find(':');
+  if(colon == std::string::npos)
+    THROW_ERR(CL_INVALID_VALUE);
+  std::string type = handle.substr(0, colon);
+  uintptr_t raw;
+  {
+    std::lock_guard<std::mutex> lock(handlesMutex);
+    auto it = exportedHandles.find(handle);
+    if(it == exportedHandles.end())
+      THROW_ERR(CL_INVALID_VALUE);
+    raw = it->second;
+    exportedHandles.erase(it);
+  }
+
+  Local<Value> obj;
+  if(!(importAs<cl_platform_id, NoCLPlatformId>(type, raw, obj) ||
+       importAs<cl_device_id, NoCLDeviceId>(type, raw, obj) ||
+       importAs<cl_context, NoCLContext>(type, raw, obj) ||
+       importAs<cl_program, NoCLProgram>(type, raw, obj) ||
+       importAs<cl_kernel, NoCLKernel>(type, raw, obj) ||
+       importAs<cl_mem, NoCLMem>(type, raw, obj) ||
+       importAs<cl_sampler, NoCLSampler>(type, raw, obj) ||
+       importAs<cl_command_queue, NoCLCommandQueue>(type, raw, obj) ||
+       importAs<cl_event, NoCLEvent>(type, raw, obj)))
+    THROW_ERR(CL_INVALID_VALUE);
+
+  info.GetReturnValue().Set(obj);
+}
+
 NAN_MODULE_INIT(init)
 {
-  Nan::SetMethod(target, "releaseAll", releaseAll);
+  addCleanupHook(releaseState, v8::Isolate::GetCurrent());
+
+  NOCL_SET_METHOD(target, "releaseAll", releaseAll);
+  NOCL_SET_METHOD(target, "exportHandle", ExportHandle);
+  NOCL_SET_METHOD(target, "importHandle", ImportHandle);
 
   NoCLPlatformId::Init(target);
   NoCLDeviceId::Init(target);
@@ -122,6 +122,14 @@ public:
     return err;
   }
 
+  static const char *getTypeName() {
+    return cl_type_names[id];
+  }
+
+  bool isReleased() const {
+    return released;
+  }
+
 private:
   static NAN_METHOD(New) {
     NoCLWrapper<T, id, err, cl_release, cl_acquire> *obj = new NoCLWrapper<T, id, err, cl_release, cl_acquire>();
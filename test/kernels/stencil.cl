@@ -0,0 +1,26 @@
+__kernel void scale(
+    __global const uint* input,
+    __global uint* output,
+    const unsigned int count,
+    const unsigned int halo_before)
+{
+    unsigned int i = get_global_id(0);
+    if (i < count)
+        output[i] = input[halo_before + i] * 2;
+}
+
+__kernel void sum3(
+    __global const uint* input,
+    __global uint* output,
+    const unsigned int count,
+    const unsigned int halo_before,
+    const unsigned int halo_after)
+{
+    unsigned int i = get_global_id(0);
+    if (i < count) {
+        unsigned int j = halo_before + i;
+        unsigned int left = j > 0 ? input[j - 1] : 0;
+        unsigned int right = j + 1 < halo_before + count + halo_after ? input[j + 1] : 0;
+        output[i] = left + input[j] + right;
+    }
+}
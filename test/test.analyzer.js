@@ -0,0 +1,119 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+function record(id, waitFor, name, queued, start, end) {
+  return { id: id, waitFor: waitFor, command: cl.COMMAND_NDRANGE_KERNEL, name: name,
+           bytes: 0, queued: queued, submit: queued, start: start, end: end };
+}
+
+describe("Analyzer", function() {
+
+  describe("#analyzePipeline", function() {
+
+    // upload on queue A, two kernels on queue B waiting for it, the second
+    // one enqueued by the host only after the first one ended
+    var upload = record(1, [], "upload", 0, 10, 100);
+    var k1 = record(2, [1], "k1", 5, 120, 300);
+    var k2 = record(3, [], "k2", 1300, 1310, 1500);
+    var streams = [
+      { name: "A", device: "gpu", records: [upload] },
+      { name: "B", device: "gpu", records: [k1, k2] }
+    ];
+
+    it("should walk the critical path back through wait lists and queue order", function () {
+      var result = cl.analyzePipeline(streams);
+      assert.deepEqual(result.criticalPath.map(function (s) { return s.name; }), ["upload", "k1", "k2"]);
+      assert.equal(result.criticalPath[1].launch, 20);
+      assert.equal(result.criticalPath[2].hostRoundTrip, 1000);
+      assert.equal(result.criticalPath[2].launch, 10);
+      assert.equal(result.criticalPathTime, 1500);
+    });
+
+    it("should report host round trips and idle gaps", function () {
+      var result = cl.analyzePipeline(streams, { minGap: 15 });
+      assert.lengthOf(result.hostRoundTrips, 1);
+      assert.equal(result.hostRoundTrips[0].from.name, "k1");
+      assert.equal(result.hostRoundTripTime, 1000);
+
+      assert.lengthOf(result.idleGaps, 2);
+      assert.equal(result.idleGaps[0].duration, 1010);
+      assert.equal(result.idleGaps[0].cause, "host");
+      assert.equal(result.idleGaps[1].duration, 20);
+      assert.equal(result.idleGaps[1].cause, "dependency");
+    });
+
+    it("should measure the imbalance between devices", function () {
+      var result = cl.analyzePipeline([
+        { name: "A", device: 0, records: [record(1, [], "a", 0, 0, 300)] },
+        { name: "B", device: 1, records: [record(2, [], "b", 0, 0, 100)] }
+      ]);
+      assert.equal(result.devices[0].busy, 300);
+      assert.equal(result.devices[1].busy, 100);
+      assert.equal(result.imbalance, 1.5);
+    });
+
+    it("should link recorded commands through their events", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.startRecording(cq);
+          var write = cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, new Uint8Array(64), [], true);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 64, new Uint8Array(64), [write]);
+          cl.finish(cq);
+          cl.stopRecording(cq);
+
+          var records = U.waitForRecords(cq).records;
+          assert.lengthOf(records, 2);
+          assert.deepEqual(records[1].waitFor, [records[0].id]);
+          var result = cl.analyzePipeline([{ name: "cq", records: records }]);
+          assert.lengthOf(result.criticalPath, 2);
+
+          cl.releaseEvent(write);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should ignore wait list ids of commands missing from the records", function () {
+      var result = cl.analyzePipeline([
+        { name: "A", outOfOrder: true, records: [record(1, [], "a", 0, 0, 100), record(2, [7], "b", 0, 200, 300)] }
+      ]);
+      assert.lengthOf(result.criticalPath, 1);
+      assert.equal(result.criticalPath[0].name, "b");
+    });
+
+    it("should not link a command to a sampled one through an unsampled event", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          var data = new Uint8Array(64);
+          cl.startRecording(cq, 2);
+          // odd commands are not sampled: their events, released right away,
+          // reuse the addresses of earlier ones, sampled or not
+          for (var i = 0; i < 32; i++) {
+            var sampled = cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, data, [], true);
+            var unsampled = cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, data, [], true);
+            cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, data, [unsampled]);
+            cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, data);
+            cl.finish(cq);
+            cl.releaseEvent(sampled);
+            cl.releaseEvent(unsampled);
+          }
+          cl.stopRecording(cq);
+
+          var records = U.waitForRecords(cq).records;
+          assert.lengthOf(records, 64);
+          records.forEach(function (r) {
+            assert.deepEqual(r.waitFor, []);
+          });
+          var result = cl.analyzePipeline([{ name: "cq", outOfOrder: true, records: records }]);
+          assert.lengthOf(result.criticalPath, 1);
+
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+});
@@ -32,3 +32,31 @@ describe("Equality", function() {
   // });
 
 });
+
+describe("Binding stats", function() {
+
+  it("should count calls and split their time once timing is on", function () {
+    cl.getBindingStats(true);
+    cl.setBindingTiming(true);
+    for (var i = 0; i < 3; i++) {
+      cl.getPlatformIDs();
+    }
+    cl.setBindingTiming(false);
+
+    var stats = cl.getBindingStats(true);
+    assert.equal(stats.getPlatformIDs.calls, 3);
+    assert.isAbove(stats.getPlatformIDs.time, 0);
+    assert.isAbove(stats.getPlatformIDs.driverTime, 0);
+    assert.equal(stats.getPlatformIDs.marshalingTime,
+      stats.getPlatformIDs.time - stats.getPlatformIDs.driverTime);
+    assert.isUndefined(cl.getBindingStats().getPlatformIDs);
+  });
+
+  it("should keep counting with timing off", function () {
+    cl.getBindingStats(true);
+    cl.getPlatformIDs();
+    var stats = cl.getBindingStats().getPlatformIDs;
+    assert.equal(stats.calls, 1);
+    assert.equal(stats.time, 0);
+  });
+});
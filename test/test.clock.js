@@ -0,0 +1,79 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+function hrtimeNs() {
+  var t = process.hrtime();
+  return t[0] * 1e9 + t[1];
+}
+
+describe("Clock", function() {
+
+  describe("#createClockCorrelator", function() {
+
+    it("should map device timestamps of a command into its host time span", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var clock = cl.createClockCorrelator(device, { queue: cq });
+          for (var i = 0; i < 4; i++) {
+            clock.sample();
+          }
+          assert.lengthOf(clock.samples, 4);
+          assert.isBelow(Math.abs(clock.drift), 0.01);
+
+          var buffer = cl.createBuffer(ctx, 0, 1 << 20, null);
+          var before = hrtimeNs();
+          var event = cl.enqueueWriteBuffer(cq, buffer, true, 0, 1 << 20, new Uint8Array(1 << 20), [], true);
+          var after = hrtimeNs();
+          var times = new Float64Array(4);
+          cl.getEventsProfiling([event], times);
+
+          // a margin for the error of the fit and of the device clock
+          var margin = 1e6;
+          assert.isAtLeast(clock.toHost(times[0]), before - margin);
+          assert.isAtMost(clock.toHost(times[3]), after + margin);
+
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should sample in the background until stopped", function (done) {
+      U.withAsyncContext(function (ctx, device, platform, ctxDone) {
+        var cq = cl.createProfilingQueue(ctx, device);
+        var clock = cl.createClockCorrelator(device, { queue: cq, interval: 10 }).start();
+        setTimeout(function () {
+          clock.stop();
+          assert.isAbove(clock.samples.length, 1);
+          cl.releaseCommandQueue(cq);
+          ctxDone();
+          done();
+        }, 50);
+      });
+    });
+
+    it("should put recorded commands on the host time base", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var clock = cl.createClockCorrelator(device, { queue: cq });
+          clock.sample();
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.startRecording(cq);
+          var before = hrtimeNs();
+          cl.enqueueWriteBuffer(cq, buffer, true, 0, 64, new Uint8Array(64));
+          cl.finish(cq);
+          cl.stopRecording(cq);
+
+          var events = cl.toTraceEvents(U.waitForRecords(cq).records, { clock: clock });
+          assert.lengthOf(events, 1);
+          assert.isAtLeast(events[0].ts, (before - 1e6) / 1000);
+          assert.equal(events[0].pid, process.pid);
+
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+});
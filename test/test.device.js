@@ -317,6 +317,36 @@ describe("Device", function() {
         }
       })
     })
+
+    describe("#getDeviceAndHostTimer() for "+device_vendor+" "+device_name,function() {
+
+      function getTimer(fn) {
+        try {
+          return fn();
+        } catch (error) {
+          // OpenCL < 2.1 platforms, or devices without timer
+          if (error.message === cl.INVALID_OPERATION.message) {
+            return null;
+          }
+          throw error;
+        }
+      }
+
+      it("should return increasing device and host timestamps", function () {
+        if (!cl.getDeviceAndHostTimer) {
+          this.skip();
+        }
+        var first = getTimer(function () { return cl.getDeviceAndHostTimer(device); });
+        if (!first) {
+          this.skip();
+        }
+        var host = cl.getHostTimer(device);
+        var second = cl.getDeviceAndHostTimer(device);
+        assert.isAtMost(first[1], host);
+        assert.isAtMost(host, second[1]);
+        assert.isAtMost(first[0], second[0]);
+      });
+    });
   }
 
   testDevice(global.MAIN_DEVICE_ID);
@@ -135,6 +135,96 @@ describe("Event", function() {
 
   });
 
+  describe("#getEventStatuses", function() {
+    skip().vendor("nVidia").it("should fill the status of every event", function () {
+      U.withContext(function (ctx) {
+        var events = [cl.createUserEvent(ctx), cl.createUserEvent(ctx), cl.createUserEvent(ctx)];
+        cl.setUserEventStatus(events[1], cl.COMPLETE);
+        var out = new Int32Array(3);
+        assert.strictEqual(cl.getEventStatuses(events, out), 1);
+        assert.deepEqual(Array.from(out), [cl.SUBMITTED, cl.COMPLETE, cl.SUBMITTED]);
+        assert.strictEqual(cl.firstCompleted(events), 1);
+        cl.setUserEventStatus(events[0], cl.COMPLETE);
+        cl.setUserEventStatus(events[2], cl.COMPLETE);
+        assert.strictEqual(cl.getEventStatuses(events, out), 3);
+        assert.strictEqual(cl.firstCompleted(events), 0);
+        events.forEach(cl.releaseEvent);
+      });
+    });
+
+    skip().vendor("nVidia").it("should return -1 from firstCompleted while nothing is complete", function () {
+      U.withContext(function (ctx) {
+        var event = cl.createUserEvent(ctx);
+        assert.strictEqual(cl.firstCompleted([event]), -1);
+        cl.setUserEventStatus(event, cl.COMPLETE);
+        cl.releaseEvent(event);
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE when out is too short", function () {
+      U.withContext(function (ctx) {
+        var event = cl.createUserEvent(ctx);
+        U.bind(cl.getEventStatuses, [event, event], new Int32Array(1))
+          .should.throw(cl.INVALID_VALUE.message);
+        cl.setUserEventStatus(event, cl.COMPLETE);
+        cl.releaseEvent(event);
+      });
+    });
+  });
+
+  describe("#getEventsProfiling", function() {
+    function withProfiledEvents(n, fn) {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          var events = [];
+          for (var i = 0; i < n; i++) {
+            events.push(cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, new Uint8Array(64), [], true));
+          }
+          cl.finish(cq);
+          fn(events);
+          events.forEach(cl.releaseEvent);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    }
+
+    it("should fill the four timestamps of every event", function () {
+      withProfiledEvents(3, function (events) {
+        var out = new Float64Array(4 * events.length);
+        assert.equal(cl.getEventsProfiling(events, out), 3);
+        for (var i = 0; i < events.length; i++) {
+          assert.isAbove(out[4 * i + 3], 0);
+          assert.isAtMost(out[4 * i], out[4 * i + 1]);
+          assert.isAtMost(out[4 * i + 1], out[4 * i + 2]);
+          assert.isAtMost(out[4 * i + 2], out[4 * i + 3]);
+        }
+      });
+    });
+
+    it("should fill a BigUint64Array and match getEventProfilingInfo", function () {
+      if (typeof BigUint64Array === "undefined") {
+        this.skip();
+      }
+      withProfiledEvents(2, function (events) {
+        var out = new BigUint64Array(4 * events.length);
+        cl.getEventsProfiling(events, out);
+        var end = cl.getEventProfilingInfo(events[1], cl.PROFILING_COMMAND_END, true);
+        assert.equal(typeof end, "bigint");
+        assert.equal(out[7], end);
+        var hilo = cl.getEventProfilingInfo(events[1], cl.PROFILING_COMMAND_END);
+        assert.equal((BigInt(hilo[0]) << BigInt(32)) | BigInt(hilo[1]), end);
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE when out is too short", function () {
+      withProfiledEvents(2, function (events) {
+        U.bind(cl.getEventsProfiling, events, new Float64Array(7))
+          .should.throw(cl.INVALID_VALUE.message);
+      });
+    });
+  });
+
   describe("#setEventCallback",function() {
     skip().vendor("nVidia").it("callback should be called",function(done){
       U.withAsyncContext(function (ctx, device, platform, ctxDone) {
@@ -150,4 +240,46 @@ describe("Event", function() {
       })
     });
   });
+
+  describe("#setCompletionMode",function() {
+    afterEach(function () {
+      cl.setCompletionMode("callback");
+    });
+
+    skip().vendor("nVidia").it("should call back polled events", function (done) {
+      U.withAsyncContext(function (ctx, device, platform, ctxDone) {
+        cl.setCompletionMode("poll");
+        var mEvent = cl.createUserEvent(ctx);
+        cl.setEventCallback(mEvent, cl.COMPLETE, function (userData, status, event) {
+          assert.strictEqual(status, cl.COMPLETE);
+          assert.strictEqual(event, mEvent);
+          cl.releaseEvent(mEvent);
+          ctxDone();
+          userData.done();
+        }, { done: done });
+        cl.setUserEventStatus(mEvent, cl.COMPLETE);
+      });
+    });
+
+    skip().vendor("nVidia").it("should fall back to driver callbacks after the spin time", function (done) {
+      U.withAsyncContext(function (ctx, device, platform, ctxDone) {
+        cl.setCompletionMode("poll", 0);
+        var mEvent = cl.createUserEvent(ctx);
+        cl.setEventCallback(mEvent, cl.COMPLETE, function (userData, status) {
+          assert.strictEqual(status, cl.COMPLETE);
+          cl.releaseEvent(mEvent);
+          ctxDone();
+          userData.done();
+        }, { done: done });
+        setTimeout(function () {
+          cl.setUserEventStatus(mEvent, cl.COMPLETE);
+        }, 10);
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE for an unknown mode", function () {
+      U.bind(cl.setCompletionMode, "busy")
+        .should.throw(cl.INVALID_VALUE.message);
+    });
+  });
 });
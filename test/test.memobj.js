@@ -74,6 +74,33 @@ describe("MemObj", function() {
       });
     });
 
+    it("should copy memory when passed a DataView", function () {
+      U.withContext(function (context, device, platform) {
+        var view = new DataView(new ArrayBuffer(32), 8, 16);
+        view.setInt32(0, 42, true);
+        var buffer = f(context, cl.MEM_COPY_HOST_PTR, 16, view);
+        U.withCQ(context, device, function (cq) {
+          var out = new Int32Array(4);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, out);
+          assert.strictEqual(out[0], 42);
+        });
+        cl.releaseMemObject(buffer);
+      });
+    });
+
+    it("should use a SharedArrayBuffer and its views as host memory", function () {
+      if (typeof SharedArrayBuffer === "undefined") {
+        return this.skip();
+      }
+      U.withContext(function (context, device, platform) {
+        var shared = new SharedArrayBuffer(32);
+        var buffer = f(context, cl.MEM_USE_HOST_PTR, 32, shared);
+        cl.releaseMemObject(buffer);
+        buffer = f(context, cl.MEM_COPY_HOST_PTR, 16, new Float32Array(shared, 16));
+        cl.releaseMemObject(buffer);
+      });
+    });
+
     it("should throw cl.INVALID_MEM_OBJECT when passed neither a Buffer nor a TypedArray", function () {
       U.withContext(function (context, device, platform) {
         f.bind(f, context, cl.MEM_COPY_HOST_PTR, 8, String("this won't do !")).should.throw("Unsupported type of buffer. Use node's Buffer or JS' ArrayBuffer"/*cl.INVALID_MEM_OBJECT.message*/);
@@ -86,7 +113,184 @@ describe("MemObj", function() {
       });
     });
 
+    it("should accept a BigInt size", function () {
+      if (typeof BigInt === "undefined") {
+        return this.skip();
+      }
+      U.withContext(function (context, device, platform) {
+        var buffer = f(context, 0, BigInt(64), null);
+        assert.strictEqual(cl.getMemObjectInfo(buffer, cl.MEM_SIZE), 64);
+        cl.releaseMemObject(buffer);
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE for a negative, fractional or unsafe size", function () {
+      U.withContext(function (context, device, platform) {
+        [-1, 1.5, Math.pow(2, 53)].forEach(function (size) {
+          f.bind(f, context, 0, size, null).should.throw(cl.INVALID_VALUE.message);
+        });
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE for a negative or oversized BigInt size", function () {
+      if (typeof BigInt === "undefined") {
+        return this.skip();
+      }
+      U.withContext(function (context, device, platform) {
+        f.bind(f, context, 0, BigInt(-1), null).should.throw(cl.INVALID_VALUE.message);
+        f.bind(f, context, 0, BigInt("18446744073709551616"), null).should.throw(cl.INVALID_VALUE.message);
+      });
+    });
+
+    it("should create buffers larger than 4GiB when the device allows it", function () {
+      var size = Math.pow(2, 32) + 4096;
+      var maxAlloc = cl.getDeviceInfo(global.MAIN_DEVICE_ID, cl.DEVICE_MAX_MEM_ALLOC_SIZE);
+      if (maxAlloc[0] * Math.pow(2, 32) + maxAlloc[1] < size) {
+        return this.skip();
+      }
+      U.withContext(function (context, device, platform) {
+        var buffer = f(context, 0, size, null);
+        assert.strictEqual(cl.getMemObjectInfo(buffer, cl.MEM_SIZE), size);
+        cl.releaseMemObject(buffer);
+      });
+    });
+
+  });
+  describe("#allocHostBuffer", function() {
+
+    it("should return an ArrayBuffer of the requested size", function () {
+      var buf = cl.allocHostBuffer(100);
+      assert.instanceOf(buf, ArrayBuffer);
+      assert.equal(buf.byteLength, 100);
+    });
+
+    it("should throw cl.INVALID_VALUE if align is not a power of 2", function () {
+      U.bind(cl.allocHostBuffer, 64, { align: 96 }).should.throw(cl.INVALID_VALUE.message);
+    });
+
+    it("should accept huge pages", function () {
+      var buf = cl.allocHostBuffer(4096, { hugePages: true });
+      assert.equal(buf.byteLength, 4096);
+    });
+
+    it("should be used in place by createBuffer", function () {
+      U.withContext(function (context, device) {
+        U.withCQ(context, device, function (cq) {
+          var host = cl.allocHostBuffer(64);
+          new Uint8Array(host).fill(5);
+          var buffer = cl.createBuffer(context, cl.MEM_READ_WRITE, 64, host);
+          assert.ok(cl.getMemObjectInfo(buffer, cl.MEM_FLAGS) & cl.MEM_USE_HOST_PTR);
+
+          var out = new Uint8Array(64);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 64, out);
+          assert.equal(out[63], 5);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should keep an explicit MEM_COPY_HOST_PTR", function () {
+      U.withContext(function (context) {
+        var host = cl.allocHostBuffer(64);
+        var buffer = cl.createBuffer(context, cl.MEM_COPY_HOST_PTR, 64, host);
+        assert.notOk(cl.getMemObjectInfo(buffer, cl.MEM_FLAGS) & cl.MEM_USE_HOST_PTR);
+        cl.releaseMemObject(buffer);
+      });
+    });
+  });
+
+  describe("# files", function() {
+
+    var fs = require('fs');
+    var os = require('os');
+    var path = require('path');
+
+    var tmpFile = function (content) {
+      var file = path.join(os.tmpdir(), 'nocl-' + process.pid + '-' + Math.random().toString(36).slice(2));
+      if (content) {
+        fs.writeFileSync(file, content);
+      }
+      return file;
+    };
+
+    var pattern = function (size) {
+      var buf = Buffer.alloc(size);
+      for (var i = 0; i < size; i++) {
+        buf[i] = i % 251;
+      }
+      return buf;
+    };
+
+    it("createBufferFromFile should create a buffer with the file content", function () {
+      U.withContext(function (context, device) {
+        U.withCQ(context, device, function (cq) {
+          var src = pattern(10000);
+          var file = tmpFile(src);
+          var buffer = cl.createBufferFromFile(context, file, cl.MEM_READ_WRITE);
+          assert.equal(cl.getMemObjectInfo(buffer, cl.MEM_SIZE), 10000);
+
+          var out = Buffer.alloc(10000);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 10000, out);
+          assert.isTrue(out.equals(src));
+
+          // the file itself is never written
+          cl.enqueueWriteBuffer(cq, buffer, true, 0, 4, Buffer.from([1, 2, 3, 4]));
+          assert.isTrue(fs.readFileSync(file).equals(src));
+
+          cl.releaseMemObject(buffer);
+          fs.unlinkSync(file);
+        });
+      });
+    });
+
+    it("createBufferFromFile should throw if the file does not exist", function () {
+      U.withContext(function (context) {
+        U.bind(cl.createBufferFromFile, context, tmpFile(), 0).should.throw(/ENOENT|Cannot map/);
+      });
+    });
+
+    it("enqueueWriteBufferFromFile should write a region of the file", function () {
+      U.withContext(function (context, device) {
+        U.withCQ(context, device, function (cq) {
+          var src = pattern(10000);
+          var file = tmpFile(src);
+          var buffer = cl.createBuffer(context, 0, 2000, null);
+          var event = cl.enqueueWriteBufferFromFile(cq, buffer, file, 5000, 1000, 1000, [], true);
+          cl.waitForEvents([event]);
+
+          var out = Buffer.alloc(1000);
+          cl.enqueueReadBuffer(cq, buffer, true, 1000, 1000, out);
+          assert.isTrue(out.equals(src.slice(5000, 6000)));
+
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buffer);
+          fs.unlinkSync(file);
+        });
+      });
+    });
+
+    it("enqueueReadBufferToFile should create the file with the buffer content", function () {
+      U.withContext(function (context, device) {
+        U.withCQ(context, device, function (cq) {
+          var src = pattern(3000);
+          var file = tmpFile();
+          var buffer = cl.createBuffer(context, cl.MEM_COPY_HOST_PTR, 3000, src);
+          var event = cl.enqueueReadBufferToFile(cq, buffer, file, 100, 0, 0, [], true);
+          cl.waitForEvents([event]);
+          cl.finish(cq);
+
+          var content = fs.readFileSync(file);
+          assert.equal(content.length, 3100);
+          assert.isTrue(content.slice(100).equals(src));
+
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buffer);
+          fs.unlinkSync(file);
+        });
+      });
+    });
   });
+
   describe("#createSubBuffer", function() {
 
     var f = cl.createSubBuffer;
@@ -313,6 +313,25 @@ describe("CommandQueue", function() {
       });
     });
 
+    it("should upload from shared memory and read into a DataView", function () {
+      if (typeof SharedArrayBuffer === "undefined") {
+        return this.skip();
+      }
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 16, null);
+          var shared = new Int32Array(new SharedArrayBuffer(32), 4, 4);
+          shared.set([1, 2, 3, 4]);
+          cl.enqueueWriteBuffer(cq, buffer, true, 0, 16, shared);
+
+          var view = new DataView(new ArrayBuffer(24), 8);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, view);
+          assert.strictEqual(view.getInt32(12, true), 4);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
     it("should fail if buffer is null", function () {
       U.withContext(function (ctx, device) {
         U.withCQ(ctx, device, function (cq) {
@@ -453,6 +472,241 @@ describe("CommandQueue", function() {
     });
   });
 
+  describe("#enqueueReadBufferRegions", function() {
+
+    var content = function (size) {
+      var buf = Buffer.alloc(size);
+      for (var i = 0; i < size; i++) {
+        buf[i] = i % 256;
+      }
+      return buf;
+    };
+
+    it("should gather disjoint regions with a single event", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var src = content(1024);
+          var buffer = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 1024, src);
+          var out = Buffer.alloc(64);
+          // two adjacent regions, a strided run of 4 and a lone one
+          var regions = new Uint32Array([
+            0, 0, 4,      4, 4, 4,
+            100, 8, 8,    200, 16, 8,   300, 24, 8,   400, 32, 8,
+            1000, 40, 24
+          ]);
+          var event = cl.enqueueReadBufferRegions(cq, buffer, false, regions, out, [], true);
+          cl.waitForEvents([event]);
+          assert.isTrue(out.slice(0, 8).equals(src.slice(0, 8)));
+          for (var i = 0; i < 4; i++) {
+            assert.isTrue(out.slice(8 + 8 * i, 16 + 8 * i).equals(src.slice(100 * (i + 1), 100 * (i + 1) + 8)));
+          }
+          assert.isTrue(out.slice(40).equals(src.slice(1000)));
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should accept a JS Array and unsorted regions", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var src = content(256);
+          var buffer = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 256, src);
+          var out = Buffer.alloc(4);
+          cl.enqueueReadBufferRegions(cq, buffer, true, [200, 2, 2, 10, 0, 2], out);
+          assert.deepEqual(Array.from(out), [10, 11, 200, 201]);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE if a region exceeds the host buffer", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 256, null);
+          U.bind(cl.enqueueReadBufferRegions, cq, buffer, true, [0, 0, 16], Buffer.alloc(8))
+            .should.throw(cl.INVALID_VALUE.message);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should throw if regions are not triples", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 256, null);
+          U.bind(cl.enqueueReadBufferRegions, cq, buffer, true, [0, 0], Buffer.alloc(8))
+            .should.throw(TypeError);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+
+  describe("#enqueueWriteBufferRegions", function() {
+
+    it("should scatter regions into the buffer", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 64, Buffer.alloc(64));
+          var src = Buffer.from([1, 2, 3, 4, 5, 6, 7, 8]);
+          var regions = new Float64Array([0, 0, 2, 16, 2, 2, 32, 4, 2, 48, 6, 2]);
+          cl.enqueueWriteBufferRegions(cq, buffer, true, regions, src);
+
+          var out = Buffer.alloc(64);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 64, out);
+          assert.deepEqual([out[0], out[1], out[16], out[17], out[32], out[33], out[48], out[49]],
+            [1, 2, 3, 4, 5, 6, 7, 8]);
+          assert.equal(out[2], 0);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+
+  describe("# converted transfers", function() {
+
+    it("should narrow doubles to floats on upload", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 16, null);
+          var src = new Float64Array([1.5, -2.25, 1e10, 0.1]);
+          cl.enqueueWriteBufferConverted(cq, buffer, true, 0, src, null, "float");
+          var out = new Float32Array(4);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, out);
+          assert.deepEqual(Array.from(out), Array.from(new Float32Array(src)));
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should store halves as 16-bit floats and read them back", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 8, null);
+          var src = new Float32Array([1, -2, 0.5, 65504]);
+          cl.enqueueWriteBufferConverted(cq, buffer, true, 0, src, "float", "half");
+
+          var raw = new Uint16Array(4);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 8, raw);
+          assert.deepEqual(Array.from(raw), [0x3c00, 0xc000, 0x3800, 0x7bff]);
+
+          var back = new Float32Array(4);
+          var event = cl.enqueueReadBufferConverted(cq, buffer, false, 0, back, "float", "half", [], true);
+          cl.waitForEvents([event]);
+          assert.deepEqual(Array.from(back), Array.from(src));
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should pad packed float3 to the device layout", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 32, null);
+          var src = new Float32Array([1, 2, 3, 4, 5, 6]);
+          cl.enqueueWriteBufferConverted(cq, buffer, true, 0, src, "float3", "float3");
+          var out = new Float32Array(8);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 32, out);
+          assert.deepEqual(Array.from(out), [1, 2, 3, 0, 4, 5, 6, 0]);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should widen integers on download", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 4, new Int8Array([-1, 2, -3, 4]));
+          var out = new Int32Array(4);
+          cl.enqueueReadBufferConverted(cq, buffer, true, 0, out, null, "char");
+          assert.deepEqual(Array.from(out), [-1, 2, -3, 4]);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should throw on mismatched vector sizes", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 32, null);
+          U.bind(cl.enqueueWriteBufferConverted, cq, buffer, true, 0, new Float32Array(8), "float4", "float2")
+            .should.throw(TypeError);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+
+  describe("# JS Array transfers", function() {
+
+    it("should write and read back an Array of floats", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 16, null);
+          cl.enqueueWriteBuffer(cq, buffer, true, 0, 16, [1.5, -2, 3, 0.1], [], false, "float");
+          var out = new Float32Array(4);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, out);
+          assert.deepEqual(Array.from(out), Array.from(new Float32Array([1.5, -2, 3, 0.1])));
+
+          var values = [];
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, values, [], false, "float");
+          assert.deepEqual(values, Array.from(out));
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should pad vectors and complete non-blocking writes", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 16, null);
+          var event = cl.enqueueWriteBuffer(cq, buffer, false, 0, 16, [1, 2, 3, 4, 5, 6], [], true, "ushort3");
+          cl.waitForEvents([event]);
+          cl.releaseEvent(event);
+          var out = new Uint16Array(8);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 16, out);
+          assert.deepEqual(Array.from(out), [1, 2, 3, 0, 4, 5, 6, 0]);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE if the Array is too short", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 16, null);
+          U.bind(cl.enqueueWriteBuffer, cq, buffer, true, 0, 16, [1, 2], [], false, "int")
+            .should.throw(cl.INVALID_VALUE.message);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE on non-number elements", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 8, null);
+          U.bind(cl.enqueueWriteBuffer, cq, buffer, true, 0, 8, [1, "2"], [], false, "int")
+            .should.throw(cl.INVALID_VALUE.message);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should still throw without an element type", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 8, null);
+          U.bind(cl.enqueueWriteBuffer, cq, buffer, true, 0, 8, [1, 2])
+            .should.throw(TypeError);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+  });
+
   describe("#enqueueCopyBuffer", function() {
     it("should work with read only buffers", function () {
       U.withContext(function (ctx, device) {
@@ -1434,6 +1688,233 @@ describe("CommandQueue", function() {
         });
       });
     });
+
+    it("should detach the mapped ArrayBuffer and its views", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buf = cl.createBuffer(ctx, 0, 8, null);
+          var ret = cl.enqueueMapBuffer(cq, buf, true, cl.MAP_WRITE, 0, 8, [], false);
+          var u8s = new Uint8Array(ret);
+          cl.enqueueUnmapMemObject(cq, buf, ret);
+          assert.equal(ret.byteLength, 0);
+          assert.equal(u8s.length, 0);
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
+
+    it("should unmap through a view of the mapped ArrayBuffer", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buf = cl.createBuffer(ctx, 0, 8, null);
+          var ret = cl.enqueueMapBuffer(cq, buf, true, cl.MAP_WRITE, 0, 8, [], false);
+          var u8s = new Uint8Array(ret, 4, 4);
+          var res = cl.enqueueUnmapMemObject(cq, buf, u8s);
+          assert.equal(res, cl.SUCCESS);
+          assert.equal(ret.byteLength, 0);
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
+
+    it("should throw when unmapping twice", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buf = cl.createBuffer(ctx, 0, 8, null);
+          var ret = cl.enqueueMapBuffer(cq, buf, true, cl.MAP_READ, 0, 8, [], false);
+          cl.enqueueUnmapMemObject(cq, buf, ret);
+          U.bind(cl.enqueueUnmapMemObject, cq, buf, ret).should.throw();
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
+  });
+
+  describe("# mapAsync", function() {
+    it("should resolve with the mapped content", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          var buf = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 8, new Buffer([1,2,3,4,5,6,7,8]));
+          cl.mapAsync(cq, buf, cl.MAP_READ, 2, 4).then(function (mapped) {
+            var u8s = new Uint8Array(mapped);
+            assert.isUndefined(mapped.event);
+            assert.deepEqual(Array.prototype.slice.call(u8s), [3,4,5,6]);
+            cl.enqueueUnmapMemObject(cq, buf, mapped);
+            assert.equal(mapped.byteLength, 0);
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          }).catch(done);
+        });
+      });
+    });
+  });
+
+  describe("# staging pool", function() {
+    var size = 10 * 1024 * 1024 + 3; // three chunks, the last one partial
+
+    afterEach(function () {
+      cl.setStagingThreshold(0);
+      cl.releaseStagingPools();
+    });
+
+    it("should round trip blocking transfers through staging buffers", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          cl.setStagingThreshold(1024);
+          assert.equal(cl.getStagingThreshold(), 1024);
+
+          var src = new Uint8Array(size);
+          for (var i = 0; i < size; i++) { src[i] = i % 251; }
+          var dst = new Uint8Array(size);
+          var buf = cl.createBuffer(ctx, 0, size, null);
+
+          cl.enqueueWriteBuffer(cq, buf, true, 0, size, src);
+          cl.enqueueReadBuffer(cq, buf, true, 0, size, dst);
+          assert.deepEqual(dst, src);
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
+
+    it("should complete the event of non-blocking staged transfers", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          cl.setStagingThreshold(1024);
+          var src = new Uint8Array(size).fill(9);
+          var dst = new Uint8Array(size);
+          var buf = cl.createBuffer(ctx, 0, size, null);
+
+          var wev = cl.enqueueWriteBuffer(cq, buf, false, 0, size, src, [], true);
+          var rev = cl.enqueueReadBuffer(cq, buf, false, 0, size, dst, [wev], true);
+          cl.setEventCallback(rev, cl.COMPLETE, function (_, status) {
+            assert.equal(status, cl.COMPLETE);
+            assert.equal(dst[size - 1], 9);
+            cl.releaseEvent(wev);
+            cl.releaseEvent(rev);
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          }, {});
+        });
+      });
+    });
+
+    it("should give staged transfers events with profiling info", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          cl.setStagingThreshold(1024);
+          var buf = cl.createBuffer(ctx, 0, size, null);
+          cl.startRecording(cq);
+          var event = cl.enqueueWriteBuffer(cq, buf, false, 0, size, new Uint8Array(size), [], true);
+          cl.waitForEvents([event]);
+          var times = new Float64Array(4);
+          assert.equal(cl.getEventsProfiling([event], times), 1);
+          assert.isAtMost(times[0], times[3]);
+          cl.stopRecording(cq);
+
+          var records = U.waitForRecords(cq).records;
+          assert.lengthOf(records, 1);
+          assert.equal(records[0].command, cl.COMMAND_WRITE_BUFFER);
+          assert.equal(records[0].bytes, size);
+          cl.releaseEvent(event);
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
+
+    it("should leave the libuv thread pool free while staged transfers wait", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          cl.setStagingThreshold(1024);
+          var gate = cl.createUserEvent(ctx);
+          var buf = cl.createBuffer(ctx, 0, size, null);
+          // more transfers than threads in the default pool
+          var events = [0, 1, 2, 3, 4].map(function () {
+            return cl.enqueueWriteBuffer(cq, buf, false, 0, size, new Uint8Array(size), [gate], true);
+          });
+          fs.stat(__filename, function (err) {
+            assert.isNull(err);
+            cl.setUserEventStatus(gate, cl.COMPLETE);
+            cl.setEventCallback(events[4], cl.COMPLETE, function (_, status) {
+              assert.equal(status, cl.COMPLETE);
+              events.forEach(cl.releaseEvent);
+              cl.releaseEvent(gate);
+              cl.releaseMemObject(buf);
+              cqDone();
+              ctxDone();
+              done();
+            }, {});
+          });
+        });
+      });
+    });
+
+    it("should allocate pinned ArrayBuffers", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var pinned = cl.allocPinnedBuffer(ctx, cq, 64);
+          assert.instanceOf(pinned, ArrayBuffer);
+          assert.equal(pinned.byteLength, 64);
+          new Uint8Array(pinned).fill(1);
+          cl.releasePinnedBuffer(pinned);
+          assert.equal(pinned.byteLength, 0);
+        });
+      });
+    });
+  });
+
+  describe("# createPersistentMapping", function() {
+    [true, false].forEach(function (coherent) {
+      it("should round trip host data (coherent: " + coherent + ")", function () {
+        U.withContext(function (ctx, device) {
+          U.withCQ(ctx, device, function (cq) {
+            var buf = cl.createBuffer(ctx, cl.MEM_ALLOC_HOST_PTR, 16, null);
+            var copy = cl.createBuffer(ctx, 0, 16, null);
+            var threes = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, 16, new Buffer(16).fill(3));
+            var mapping = cl.createPersistentMapping(cq, buf, { coherent: coherent });
+            assert.equal(mapping.coherent, coherent);
+            assert.equal(mapping.buffer.byteLength, 16);
+
+            new Uint8Array(mapping.buffer).fill(7);
+            var ev = mapping.flushToDevice();
+            if (ev) {
+              cl.releaseEvent(ev);
+            }
+            cl.enqueueCopyBuffer(cq, buf, copy, 0, 0, 16);
+            cl.enqueueCopyBuffer(cq, threes, buf, 0, 0, 16);
+
+            var view = new Uint8Array(mapping.invalidateFromDevice());
+            assert.equal(view[15], 3);
+
+            var out = new Uint8Array(16);
+            cl.enqueueReadBuffer(cq, copy, true, 0, 16, out);
+            assert.equal(out[0], 7);
+
+            mapping.release();
+            cl.releaseMemObject(threes);
+            cl.releaseMemObject(copy);
+            cl.releaseMemObject(buf);
+          });
+        });
+      });
+    });
+
+    it("should detect coherency of ALLOC_HOST_PTR buffers on CPU devices", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          var buf = cl.createBuffer(ctx, cl.MEM_ALLOC_HOST_PTR, 16, null);
+          var mapping = cl.createPersistentMapping(cq, buf);
+          if (cl.getDeviceInfo(device, cl.DEVICE_TYPE) & cl.DEVICE_TYPE_CPU) {
+            assert.isTrue(mapping.coherent);
+          }
+          mapping.release();
+          cl.releaseMemObject(buf);
+        });
+      });
+    });
   });
 
   versions(["1.2","2.0"]).describe("#enqueueMigrateMemObjects", function() {
@@ -0,0 +1,175 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+describe("Recorder", function() {
+
+  describe("#startRecording", function() {
+
+    it("should throw cl.INVALID_QUEUE_PROPERTIES without profiling", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          U.bind(cl.startRecording, cq).should.throw(cl.INVALID_QUEUE_PROPERTIES.message);
+        });
+      });
+    });
+
+    it("should record transfers without events asked for", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.startRecording(cq);
+          cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, new Uint8Array(64));
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 32, new Uint8Array(32));
+          cl.finish(cq);
+          cl.stopRecording(cq);
+
+          var result = U.waitForRecords(cq);
+          assert.lengthOf(result.records, 2);
+          assert.equal(result.records[0].command, cl.COMMAND_WRITE_BUFFER);
+          assert.equal(result.records[0].bytes, 64);
+          assert.equal(result.records[1].command, cl.COMMAND_READ_BUFFER);
+          assert.equal(result.records[1].bytes, 32);
+          result.records.forEach(function (r) {
+            assert.isAtMost(r.queued, r.submit);
+            assert.isAtMost(r.submit, r.start);
+            assert.isAtMost(r.start, r.end);
+          });
+          assert.lengthOf(cl.getRecords(cq).records, 0);
+
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should link wait lists to the ids of recorded commands only", function () {
+      U.withContext(function (ctx, device) {
+        U.withProfilingQueue(ctx, device, function (cq) {
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          var user = cl.createUserEvent(ctx);
+          cl.setUserEventStatus(user, cl.COMPLETE);
+          cl.startRecording(cq);
+          var write = cl.enqueueWriteBuffer(cq, buffer, false, 0, 64, new Uint8Array(64), [], true);
+          cl.enqueueReadBuffer(cq, buffer, true, 0, 64, new Uint8Array(64), [write, user]);
+          cl.stopRecording(cq);
+
+          var records = U.waitForRecords(cq).records;
+          assert.lengthOf(records, 2);
+          assert.notEqual(records[0].id, records[1].id);
+          assert.deepEqual(records[0].waitFor, []);
+          // the user event was never recorded
+          assert.deepEqual(records[1].waitFor, [records[0].id]);
+
+          cl.releaseEvent(write);
+          cl.releaseEvent(user);
+          cl.releaseMemObject(buffer);
+        });
+      });
+    });
+
+    it("should sample every Nth command and name kernels", function () {
+      U.withContext(function (ctx, device) {
+        U.withProgram(ctx, "__kernel void noop(__global uint *a) { a[get_global_id(0)] = 1; }", function (prg) {
+          var kernel = cl.createKernel(prg, "noop");
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.setKernelArg(kernel, 0, "uint*", buffer);
+          U.withProfilingQueue(ctx, device, function (cq) {
+            cl.startRecording(cq, 3);
+            for (var i = 0; i < 7; i++) {
+              cl.enqueueNDRangeKernel(cq, kernel, 1, null, [16], null);
+            }
+            cl.finish(cq);
+            cl.stopRecording(cq);
+
+            var records = U.waitForRecords(cq).records;
+            assert.lengthOf(records, 3);
+            assert.equal(records[0].name, "noop");
+            assert.equal(records[0].command, cl.COMMAND_NDRANGE_KERNEL);
+
+            var trace = cl.toChromeTrace(records, { queueName: "compute" });
+            assert.lengthOf(trace.traceEvents, 4);
+            assert.equal(trace.traceEvents[1].name, "noop");
+            assert.equal(trace.traceEvents[1].ph, "X");
+            assert.equal(trace.traceEvents[1].ts, (records[0].start - records[0].queued) / 1000);
+          });
+
+          cl.releaseMemObject(buffer);
+          cl.releaseKernel(kernel);
+        });
+      });
+    });
+  });
+
+  describe("#getStats", function() {
+
+    it("should throw cl.INVALID_QUEUE_PROPERTIES without profiling", function () {
+      U.withContext(function (ctx, device) {
+        U.withCQ(ctx, device, function (cq) {
+          U.bind(cl.enableStats, cq).should.throw(cl.INVALID_QUEUE_PROPERTIES.message);
+        });
+      });
+    });
+
+    it("should keep latency percentiles per kernel and command type", function () {
+      U.withContext(function (ctx, device) {
+        U.withProgram(ctx, "__kernel void noop(__global uint *a) { a[get_global_id(0)] = 1; }", function (prg) {
+          var kernel = cl.createKernel(prg, "noop");
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.setKernelArg(kernel, 0, "uint*", buffer);
+          U.withProfilingQueue(ctx, device, function (cq) {
+            cl.enableStats(cq);
+            for (var i = 0; i < 10; i++) {
+              cl.enqueueNDRangeKernel(cq, kernel, 1, null, [16], null);
+            }
+            cl.enqueueReadBuffer(cq, buffer, true, 0, 64, new Uint8Array(64));
+            cl.finish(cq);
+            // the statistics are in once no command is pending
+            U.waitForRecords(cq);
+
+            var stats = cl.getStats(cq, [50, 99], true);
+            assert.lengthOf(stats, 2);
+            var noop = stats.filter(function (s) { return s.name === "noop"; })[0];
+            assert.equal(noop.command, cl.COMMAND_NDRANGE_KERNEL);
+            assert.equal(noop.execution.count, 10);
+            assert.isAtMost(noop.execution.min, noop.execution.p50);
+            assert.isAtMost(noop.execution.p50, noop.execution.p99);
+            assert.isAtMost(noop.execution.p99, noop.execution.max);
+            assert.equal(noop.queueToStart.count, 10);
+            assert.equal(noop.endToCallback.count, 10);
+            var read = stats.filter(function (s) { return s.command === cl.COMMAND_READ_BUFFER; })[0];
+            assert.equal(read.execution.count, 1);
+
+            // reset by the previous call
+            assert.lengthOf(cl.getStats(cq), 0);
+            cl.enableStats(cq, false);
+          });
+
+          cl.releaseMemObject(buffer);
+          cl.releaseKernel(kernel);
+        });
+      });
+    });
+
+    it("should drop the statistics of a released queue", function () {
+      U.withContext(function (ctx, device) {
+        U.withProgram(ctx, "__kernel void released(__global uint *a) { a[get_global_id(0)] = 1; }", function (prg) {
+          var kernel = cl.createKernel(prg, "released");
+          var buffer = cl.createBuffer(ctx, 0, 64, null);
+          cl.setKernelArg(kernel, 0, "uint*", buffer);
+          var cq = cl.createProfilingQueue(ctx, device);
+          cl.enableStats(cq);
+          cl.enqueueNDRangeKernel(cq, kernel, 1, null, [16], null);
+          cl.finish(cq);
+          cl.releaseCommandQueue(cq);
+
+          var stats = cl.getStats(null).filter(function (s) { return s.name === "released"; });
+          assert.lengthOf(stats, 0);
+
+          cl.releaseMemObject(buffer);
+          cl.releaseKernel(kernel);
+        });
+      });
+    });
+  });
+});
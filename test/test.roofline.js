@@ -0,0 +1,72 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+describe("Roofline", function() {
+
+  describe("#setKernelCost", function() {
+
+    it("should estimate the bytes moved from the bound buffers", function () {
+      U.withContext(function (ctx, device) {
+        U.withProgram(ctx, "__kernel void add(__global float *a, __global float *b, uint n) { a[get_global_id(0)] += b[get_global_id(0)]; }", function (prg) {
+          var kernel = cl.createKernel(prg, "add");
+          var a = cl.createBuffer(ctx, 0, 1024, null);
+          var b = cl.createBuffer(ctx, 0, 4096, null);
+          cl.setKernelArg(kernel, 0, "float*", a);
+          cl.setKernelArg(kernel, 1, "float*", b);
+          cl.setKernelArg(kernel, 2, "uint", 256);
+
+          cl.setKernelCost(kernel);
+          var cost = cl.getKernelCost("add");
+          assert.equal(cost.bytes, 5120);
+          assert.isTrue(cost.estimated);
+
+          cl.setKernelCost("add", { bytes: 3 * 1024, flops: 256 });
+          assert.equal(cl.getKernelCost(kernel).flops, 256);
+
+          cl.releaseMemObject(a);
+          cl.releaseMemObject(b);
+          cl.releaseKernel(kernel);
+        });
+      });
+    });
+  });
+
+  describe("#getDevicePeaks", function() {
+
+    it("should derive compute peaks and measure the bandwidth", function () {
+      U.withContext(function (ctx, device) {
+        var peaks = cl.getDevicePeaks(ctx, device, { size: 1 << 20, iterations: 2 });
+        assert.isAbove(peaks.computeUnits, 0);
+        assert.isAbove(peaks.gflops, 0);
+        assert.isAbove(peaks.bandwidth, 0);
+      });
+    });
+  });
+
+  describe("#kernelReport", function() {
+
+    it("should put each costed kernel against the roofline", function () {
+      cl.setKernelCost("stream", { bytes: 8e6 });
+      cl.setKernelCost("dense", { bytes: 1e6, flops: 1e8 });
+      var stats = [
+        { name: "stream", execution: { count: 1, mean: 1e5 } },
+        { name: "dense", execution: { count: 10, mean: 2e5 } },
+        { name: "unknown", execution: { count: 5, mean: 10 } }
+      ];
+      var rows = cl.kernelReport(stats, { gflops: 1000, bandwidth: 100, globalMemCacheSize: 1 << 20 });
+
+      assert.lengthOf(rows, 2);
+      assert.equal(rows[0].name, "dense");
+      assert.equal(rows[0].bound, "compute");
+      assert.equal(rows[0].gflopPerS, 500);
+      assert.equal(rows[0].efficiency, 50);
+      assert.isTrue(rows[0].cacheResident);
+      assert.equal(rows[1].name, "stream");
+      assert.equal(rows[1].bound, "memory");
+      assert.equal(rows[1].gbPerS, 80);
+      assert.equal(rows[1].bandwidthPct, 80);
+    });
+  });
+});
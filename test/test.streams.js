@@ -0,0 +1,120 @@
+var cl = require('../lib/opencl');
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+describe("Streams", function() {
+
+  var pattern = function (size) {
+    var buf = Buffer.alloc(size);
+    for (var i = 0; i < size; i++) {
+      buf[i] = (i * 7) % 256;
+    }
+    return buf;
+  };
+
+  describe("#createWriteStream", function() {
+
+    it("should fill the buffer through the chunk ring", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          var size = 10000;
+          var src = pattern(size);
+          var buf = cl.createBuffer(ctx, 0, size + 16, null);
+          var ws = cl.createWriteStream(cq, buf, { offset: 16, chunkSize: 1024, depth: 2 });
+
+          ws.on('finish', function () {
+            assert.isDefined(ws.event);
+            var out = Buffer.alloc(size);
+            cl.enqueueReadBuffer(cq, buf, true, 16, size, out);
+            assert.isTrue(out.equals(src));
+            cl.releaseEvent(ws.event);
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          });
+          ws.on('error', done);
+
+          // uneven writes, across chunk boundaries
+          for (var pos = 0; pos < size; pos += 333) {
+            ws.write(src.slice(pos, Math.min(pos + 333, size)));
+          }
+          ws.end();
+        });
+      });
+    });
+
+    it("should apply backpressure when the ring is full", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          var buf = cl.createBuffer(ctx, 0, 4096, null);
+          var ws = cl.createWriteStream(cq, buf, { chunkSize: 1024, depth: 1 });
+          assert.isFalse(ws.write(Buffer.alloc(4096)));
+          ws.end(function () {
+            cl.releaseEvent(ws.event);
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  describe("#createReadStream", function() {
+
+    it("should emit the requested range in order", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          var size = 10000;
+          var src = pattern(size);
+          var buf = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, size, src);
+          var rs = cl.createReadStream(cq, buf, { offset: 100, length: 5000, chunkSize: 1024, depth: 2 });
+          var chunks = [];
+
+          rs.on('data', function (chunk) {
+            assert.isAtMost(chunk.length, 1024);
+            chunks.push(chunk);
+          });
+          rs.on('end', function () {
+            assert.isTrue(Buffer.concat(chunks).equals(src.slice(100, 5100)));
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          });
+          rs.on('error', done);
+        });
+      });
+    });
+
+    it("should read up to the end of the buffer by default", function (done) {
+      U.withAsyncContext(function (ctx, device, _, ctxDone) {
+        U.withAsyncCQ(ctx, device, function (cq, cqDone) {
+          var size = 3000;
+          var src = pattern(size);
+          var buf = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, size, src);
+          var rs = cl.createReadStream(cq, buf, { offset: 1000, chunkSize: 512 });
+          var ws = cl.createWriteStream(cq, cl.createBuffer(ctx, 0, 2000, null), { chunkSize: 700 });
+          var total = 0;
+
+          rs.on('data', function (chunk) { total += chunk.length; });
+          rs.pipe(ws);
+          ws.on('finish', function () {
+            assert.strictEqual(total, 2000);
+            var out = Buffer.alloc(2000);
+            cl.enqueueReadBuffer(cq, ws.mem, true, 0, 2000, out);
+            assert.isTrue(out.equals(src.slice(1000)));
+            cl.releaseEvent(ws.event);
+            cl.releaseMemObject(ws.mem);
+            cl.releaseMemObject(buf);
+            cqDone();
+            ctxDone();
+            done();
+          });
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,131 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+describe("Tensor", function() {
+
+  // 4x5x6 tensor of uint, element (i, j, k) = 100 * i + 10 * j + k
+  var D = [4, 5, 6];
+  var full = new Uint32Array(D[0] * D[1] * D[2]);
+  for (var i = 0; i < D[0]; i++) {
+    for (var j = 0; j < D[1]; j++) {
+      for (var k = 0; k < D[2]; k++) {
+        full[(i * D[1] + j) * D[2] + k] = 100 * i + 10 * j + k;
+      }
+    }
+  }
+  var fullStrides = [D[1] * D[2], D[2], 1];
+
+  var withTensor = function (exec) {
+    U.withContext(function (ctx, device) {
+      U.withCQ(ctx, device, function (cq) {
+        var buffer = cl.createBuffer(ctx, cl.MEM_COPY_HOST_PTR, full.byteLength, full);
+        exec(ctx, cq, buffer);
+        cl.releaseMemObject(buffer);
+      });
+    });
+  };
+
+  describe("#readTensor", function() {
+
+    it("should read a 3-D slice with rects", function () {
+      withTensor(function (ctx, cq, buffer) {
+        var out = new Uint32Array(2 * 3 * 4);
+        // [1:3, 2:5, 1:5]
+        cl.readTensor(cq, buffer, out, [2, 3, 4], {
+          bufferOffset: 1 * fullStrides[0] + 2 * fullStrides[1] + 1,
+          bufferStrides: fullStrides
+        });
+        var n = 0;
+        for (var i = 1; i < 3; i++) {
+          for (var j = 2; j < 5; j++) {
+            for (var k = 1; k < 5; k++) {
+              assert.equal(out[n++], 100 * i + 10 * j + k);
+            }
+          }
+        }
+      });
+    });
+
+    it("should read a transposition through the copy kernel", function () {
+      withTensor(function (ctx, cq, buffer) {
+        // (k, j, i) view of the tensor
+        var out = new Uint32Array(full.length);
+        var event = cl.readTensor(cq, buffer, out, [D[2], D[1], D[0]], {
+          bufferStrides: [1, D[2], D[1] * D[2]],
+          maxTransfers: 1,
+          event: true
+        });
+        assert.isObject(event);
+        cl.releaseEvent(event);
+        assert.equal(out[0], 0);
+        assert.equal(out[1], 100);
+        assert.equal(out[D[0]], 10);
+        assert.equal(out[D[0] * D[1]], 1);
+      });
+    });
+
+    it("should read into a transposed host view with a single host copy", function () {
+      withTensor(function (ctx, cq, buffer) {
+        // out[k][j][i] = tensor[i][j][k], with the view in tensor order
+        var out = new Uint32Array(full.length);
+        cl.getBindingStats(true);
+        cl.readTensor(cq, buffer, out, D, {
+          hostStrides: [1, D[0], D[0] * D[1]],
+          maxTransfers: 1
+        });
+        var stats = cl.getBindingStats(true);
+        assert.equal(stats.enqueueReadBufferRect.calls, 1);
+        assert.equal(stats.enqueueNDRangeKernel.calls, 1);
+        for (var i = 0; i < D[0]; i++) {
+          for (var j = 0; j < D[1]; j++) {
+            for (var k = 0; k < D[2]; k++) {
+              assert.equal(out[(k * D[1] + j) * D[0] + i], 100 * i + 10 * j + k);
+            }
+          }
+        }
+      });
+    });
+  });
+
+  describe("#writeTensor", function() {
+
+    it("should write a strided host view", function () {
+      withTensor(function (ctx, cq, buffer) {
+        // every other element of host
+        var host = new Uint32Array([7, 0, 8, 0, 9, 0]);
+        cl.writeTensor(cq, buffer, host, [3], { bufferOffset: 6, hostStrides: [2] });
+        var out = new Uint32Array(full.length);
+        cl.enqueueReadBuffer(cq, buffer, true, 0, full.byteLength, out);
+        assert.deepEqual(Array.from(out.slice(5, 10)), [5, 7, 8, 9, 13]);
+      });
+    });
+  });
+
+  describe("#copyTensor", function() {
+
+    it("should transpose between buffers", function () {
+      withTensor(function (ctx, cq, buffer) {
+        var dst = cl.createBuffer(ctx, 0, 5 * 6 * 4, null);
+        // dst[k][j] = src[0][j][k]
+        cl.copyTensor(cq, buffer, dst, [D[1], D[2]], {
+          srcStrides: [D[2], 1],
+          dstStrides: [1, D[1]],
+          blocking: true
+        });
+        var out = new Uint32Array(5 * 6);
+        cl.enqueueReadBuffer(cq, dst, true, 0, out.byteLength, out);
+        assert.equal(out[0 * D[1] + 3], 30);
+        assert.equal(out[4 * D[1] + 2], 24);
+        cl.releaseMemObject(dst);
+      });
+    });
+
+    it("should throw on negative strides", function () {
+      withTensor(function (ctx, cq, buffer) {
+        U.bind(cl.copyTensor, cq, buffer, buffer, [2], { srcStrides: [-1] }).should.throw(RangeError);
+      });
+    });
+  });
+});
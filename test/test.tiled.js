@@ -0,0 +1,126 @@
+var cl = require('../lib/opencl');
+var fs = require('fs');
+var stream = require('stream');
+var assert = require('chai').assert;
+var U = require("./utils/utils");
+
+describe("Tiled", function() {
+
+  var N = 1000;
+  var input = new Uint32Array(N);
+  for (var i = 0; i < N; i++) {
+    input[i] = i;
+  }
+
+  var withKernel = function (name, exec) {
+    U.withAsyncContext(function (ctx, device, _, ctxDone) {
+      var prg = cl.createProgramWithSource(ctx,
+        fs.readFileSync(__dirname + "/kernels/stencil.cl").toString());
+      cl.buildProgram(prg);
+      var kern = cl.createKernel(prg, name);
+      exec(ctx, device, kern, function () {
+        cl.releaseKernel(kern);
+        cl.releaseProgram(prg);
+        ctxDone();
+      });
+    });
+  };
+
+  describe("#runTiled", function() {
+
+    it("should process every tile into an array sink", function (done) {
+      withKernel("scale", function (ctx, device, kern, kernDone) {
+        var output = new Uint32Array(N);
+        cl.runTiled(ctx, device, kern, { source: input, sink: output, tileSize: 128 })
+          .then(function (res) {
+            assert.equal(res.tileSize, 128);
+            assert.equal(res.tiles, Math.ceil(N / 128));
+            for (var i = 0; i < N; i++) {
+              assert.equal(output[i], 2 * i);
+            }
+            kernDone();
+            done();
+          })
+          .catch(function (err) {
+            kernDone();
+            done(err);
+          });
+      });
+    });
+
+    it("should pass the halo of each tile to the kernel", function (done) {
+      withKernel("sum3", function (ctx, device, kern, kernDone) {
+        var output = new Uint32Array(N);
+        cl.runTiled(ctx, device, kern, {
+          source: input,
+          sink: output,
+          tileSize: 100,
+          halo: 1,
+          setArgs: function (k, inMem, outMem, tile) {
+            cl.setKernelArg(k, 0, "uint*", inMem);
+            cl.setKernelArg(k, 1, "uint*", outMem);
+            cl.setKernelArg(k, 2, "uint", tile.length);
+            cl.setKernelArg(k, 3, "uint", tile.haloBefore);
+            cl.setKernelArg(k, 4, "uint", tile.haloAfter);
+          }
+        }).then(function () {
+          for (var i = 0; i < N; i++) {
+            var expected = (i > 0 ? i - 1 : 0) + i + (i + 1 < N ? i + 1 : 0);
+            assert.equal(output[i], expected);
+          }
+          kernDone();
+          done();
+        }).catch(function (err) {
+          kernDone();
+          done(err);
+        });
+      });
+    });
+
+    it("should shrink tiles to the memory budget", function (done) {
+      withKernel("scale", function (ctx, device, kern, kernDone) {
+        var output = new Uint32Array(N);
+        cl.runTiled(ctx, device, kern, { source: input, sink: output, memoryBudget: 3 * 8 * 64 })
+          .then(function (res) {
+            assert.equal(res.tileSize, 64);
+            assert.equal(output[N - 1], 2 * (N - 1));
+            kernDone();
+            done();
+          })
+          .catch(function (err) {
+            kernDone();
+            done(err);
+          });
+      });
+    });
+
+    it("should stream from a Readable to a callback, in order", function (done) {
+      withKernel("scale", function (ctx, device, kern, kernDone) {
+        var readable = new stream.PassThrough();
+        var bytes = Buffer.from(input.buffer);
+        for (var pos = 0; pos < bytes.length; pos += 300) {
+          readable.write(bytes.slice(pos, pos + 300));
+        }
+        readable.end();
+
+        var next = 0;
+        cl.runTiled(ctx, device, kern, {
+          source: readable,
+          tileSize: 200,
+          sink: function (chunk, offset) {
+            assert.equal(offset, next);
+            next += chunk.length;
+          }
+        }).then(function (res) {
+          assert.equal(next, N * 4);
+          assert.equal(res.tiles, 5);
+          kernDone();
+          done();
+        }).catch(function (err) {
+          kernDone();
+          done(err);
+        });
+      });
+    });
+  });
+});
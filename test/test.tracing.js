@@ -0,0 +1,62 @@
+var should = require('chai').should();
+var assert = require('chai').assert;
+var childProcess = require('child_process');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var nodeMajor = parseInt(process.versions.node.split(".")[0], 10);
+
+// Runs script in a child process recording the node-opencl category, and
+// returns the events of that category
+function traceScript(script) {
+  var dir = fs.mkdtempSync(path.join(os.tmpdir(), "node-opencl-trace-"));
+  var file = path.join(dir, "trace.json");
+  childProcess.execFileSync(process.execPath, [
+    "--trace-event-categories", "node-opencl",
+    "--trace-event-file-pattern", file,
+    "-e", script
+  ], { cwd: path.join(__dirname, ".."), stdio: "inherit" });
+  var events = JSON.parse(fs.readFileSync(file, "utf8")).traceEvents;
+  fs.unlinkSync(file);
+  fs.rmdirSync(dir);
+  return events.filter(function (e) { return e.cat === "node-opencl"; });
+}
+
+describe("Tracing", function() {
+
+  it("should emit spans for creations, enqueues and command completions", function () {
+    if (nodeMajor < 12) {
+      this.skip();
+    }
+    this.timeout(30000);
+    var events = traceScript([
+      "var cl = require('./lib/opencl');",
+      "var platform = cl.getPlatformIDs()[0];",
+      "var device = cl.getDeviceIDs(platform, cl.DEVICE_TYPE_ALL)[0];",
+      "var ctx = cl.createContext([cl.CONTEXT_PLATFORM, platform], [device], null, null);",
+      "var cq = cl.createCommandQueueWithProperties ?",
+      "  cl.createCommandQueueWithProperties(ctx, device, []) : cl.createCommandQueue(ctx, device, 0);",
+      "var buffer = cl.createBuffer(ctx, 0, 64, null);",
+      "cl.enqueueWriteBuffer(cq, buffer, true, 0, 64, new Uint8Array(64));",
+      "cl.finish(cq);",
+      "cl.releaseMemObject(buffer);",
+      "cl.releaseCommandQueue(cq);",
+      "cl.releaseContext(ctx);"
+    ].join("\n"));
+
+    var names = events.map(function (e) { return e.name; });
+    assert.include(names, "createBuffer");
+    assert.include(names, "enqueueWriteBuffer");
+    // and getPlatformIDs, a query, is not traced
+    assert.notInclude(names, "getPlatformIDs");
+
+    var begin = events.filter(function (e) { return e.name === "WRITE_BUFFER" && e.ph === "b"; })[0];
+    var end = events.filter(function (e) { return e.name === "WRITE_BUFFER" && e.ph === "e"; })[0];
+    assert.isDefined(begin);
+    assert.isDefined(end);
+    assert.equal(begin.id, end.id);
+    assert.equal(begin.args.bytes, 64);
+    assert.isAtMost(begin.ts, end.ts);
+  });
+});
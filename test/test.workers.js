@@ -0,0 +1,157 @@
+var cl = require('../lib/opencl');
+var should = require('chai').should();
+var assert = require('chai').assert;
+var path = require('path');
+var U = require("./utils/utils");
+
+var workerThreads = null;
+try { workerThreads = require('worker_threads'); } catch (e) { /* node < 10.5 */ }
+
+describe("Workers", function() {
+
+  describe("#exportHandle", function() {
+
+    it("should give a handle which imports to a working object", function () {
+      U.withContext(function (ctx, device) {
+        var buffer = cl.createBuffer(ctx, 0, 16, null);
+        var handle = cl.exportHandle(buffer);
+        assert.isString(handle);
+        assert.match(handle, /^CLMem:/);
+
+        var imported = cl.importHandle(handle);
+        assert.equal(cl.getMemObjectInfo(imported, cl.MEM_SIZE), 16);
+        cl.releaseMemObject(imported);
+        cl.releaseMemObject(buffer);
+      });
+    });
+
+    it("should throw if the value is not an OpenCL object", function () {
+      U.bind(cl.exportHandle, new ArrayBuffer(8)).should.throw(TypeError);
+      U.bind(cl.exportHandle, {}).should.throw(TypeError);
+    });
+
+    it("should throw cl.INVALID_VALUE on malformed handles", function () {
+      U.bind(cl.importHandle, "CLMem:").should.throw(cl.INVALID_VALUE.message);
+      U.bind(cl.importHandle, "CLNothing:1234").should.throw(cl.INVALID_VALUE.message);
+    });
+
+    it("should throw cl.INVALID_VALUE on forged handles", function () {
+      U.withContext(function (ctx) {
+        var buffer = cl.createBuffer(ctx, 0, 16, null);
+        var handle = cl.exportHandle(buffer);
+        // same serial, other type
+        U.bind(cl.importHandle, handle.replace(/^CLMem/, "CLContext")).should.throw(cl.INVALID_VALUE.message);
+        U.bind(cl.importHandle, "CLMem:7f0000001000").should.throw(cl.INVALID_VALUE.message);
+        cl.releaseMemObject(cl.importHandle(handle));
+        cl.releaseMemObject(buffer);
+      });
+    });
+
+    it("should throw cl.INVALID_VALUE when a handle is imported twice", function () {
+      U.withContext(function (ctx) {
+        var buffer = cl.createBuffer(ctx, 0, 16, null);
+        var handle = cl.exportHandle(buffer);
+        var imported = cl.importHandle(handle);
+        U.bind(cl.importHandle, handle).should.throw(cl.INVALID_VALUE.message);
+        cl.releaseMemObject(imported);
+        cl.releaseMemObject(buffer);
+      });
+    });
+  });
+
+  describe("# worker threads", function() {
+
+    it("should share a context and a buffer with a worker owning its queue", function (done) {
+      if (!workerThreads) {
+        return this.skip();
+      }
+      var ctx = U.newContext();
+      var device = global.MAIN_DEVICE_ID;
+      var buffer = cl.createBuffer(ctx, 0, 16, null);
+      U.withCQ(ctx, device, function (cq) {
+        cl.enqueueWriteBuffer(cq, buffer, true, 0, 16, new Int32Array([1, 2, 3, 4]));
+      });
+
+      var worker = new workerThreads.Worker(`
+        var { parentPort, workerData } = require('worker_threads');
+        var cl = require(workerData.lib);
+        var ctx = cl.importHandle(workerData.context);
+        var device = cl.importHandle(workerData.device);
+        var buffer = cl.importHandle(workerData.buffer);
+        var cq = cl.createCommandQueueWithProperties ?
+          cl.createCommandQueueWithProperties(ctx, device, []) :
+          cl.createCommandQueue(ctx, device, 0);
+        var out = new Int32Array(4);
+        cl.enqueueReadBuffer(cq, buffer, true, 0, 16, out);
+        cl.releaseCommandQueue(cq);
+        cl.releaseMemObject(buffer);
+        cl.releaseContext(ctx);
+        parentPort.postMessage(Array.from(out));
+      `, {
+        eval: true,
+        workerData: {
+          lib: path.join(__dirname, '../lib/opencl'),
+          context: cl.exportHandle(ctx),
+          device: cl.exportHandle(device),
+          buffer: cl.exportHandle(buffer)
+        }
+      });
+
+      var result = null, failure = null;
+      worker.on('message', function (values) { result = values; });
+      worker.on('error', function (err) { failure = err; });
+      worker.on('exit', function () {
+        cl.releaseMemObject(buffer);
+        cl.releaseContext(ctx);
+        if (failure) {
+          return done(failure);
+        }
+        try {
+          assert.deepEqual(result, [1, 2, 3, 4]);
+          done();
+        } catch (e) { done(e); }
+      });
+    });
+
+    it("should drop the event callbacks of a terminated worker", function (done) {
+      if (!workerThreads) {
+        return this.skip();
+      }
+      var ctx = U.newContext();
+      var event = cl.createUserEvent(ctx);
+
+      var worker = new workerThreads.Worker(`
+        var { parentPort, workerData } = require('worker_threads');
+        var cl = require(workerData.lib);
+        var event = cl.importHandle(workerData.event);
+        cl.setEventCallback(event, cl.COMPLETE, function () {
+          parentPort.postMessage("called");
+        });
+        parentPort.postMessage("ready");
+      `, {
+        eval: true,
+        workerData: {
+          lib: path.join(__dirname, '../lib/opencl'),
+          event: cl.exportHandle(event)
+        }
+      });
+
+      var failure = null;
+      worker.on('error', function (err) { failure = err; });
+      worker.on('message', function (message) {
+        if (message === "ready") {
+          worker.terminate();
+        }
+      });
+      worker.on('exit', function () {
+        // the driver callback now finds its environment gone
+        cl.setUserEventStatus(event, cl.COMPLETE);
+        setTimeout(function () {
+          cl.releaseEvent(event);
+          cl.releaseContext(ctx);
+          done(failure);
+        }, 50);
+      });
+    });
+  });
+});
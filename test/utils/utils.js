@@ -91,6 +91,30 @@ var Utils = {
     } catch (e) { cl.releaseCommandQueue(cq); }
   },
 
+  withProfilingQueue: function (ctx, device, exec) {
+    var cq = cl.createProfilingQueue(ctx, device);
+    try { exec(cq); }
+    finally { cl.releaseCommandQueue(cq); }
+  },
+
+  // Completion callbacks may still be running when clFinish returns: reads
+  // the records of a queue until none of its commands is pending
+  waitForRecords: function (cq, timeout = 10000) {
+    var deadline = Date.now() + timeout;
+    var records = [];
+    for (;;) {
+      var result = cl.getRecords(cq);
+      records = records.concat(result.records);
+      if (!result.pending) {
+        result.records = records;
+        return result;
+      }
+      if (Date.now() > deadline) {
+        throw new Error(result.pending + " recorded commands still pending");
+      }
+    }
+  },
+
   bind : function(/*...*/) {
     var args = Array.prototype.slice.call(arguments);
     var fct = args.shift();